@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <ctime>
+#include <memory>
+
+#include "BenchTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+
+using namespace TasksLib;
+
+namespace {
+
+	constexpr unsigned NUM_WORKERS = 4;
+	constexpr unsigned NUM_TASKS = 2000;
+
+	struct Strategy {
+		const char* name;
+		TasksQueue::IdleStrategy idle;
+	};
+
+	void WaitFor(const std::chrono::microseconds gap) {
+		// Sleeping is too coarse for the short gaps
+		const auto until = std::chrono::steady_clock::now() + gap;
+		while (std::chrono::steady_clock::now() < until) {
+			std::this_thread::yield();
+		}
+	}
+
+	/* Adds a task every gap, prints the latency from adding a task until it starts and the CPU time of the process */
+	void Run(const Strategy& strategy, const std::chrono::microseconds gap) {
+		TasksQueue::Configuration config{ NUM_WORKERS, 0, 1 };
+		config.blockingIdle = strategy.idle;
+		TasksQueue queue(config);
+
+		std::vector<std::chrono::nanoseconds> latencies(NUM_TASKS);
+		std::atomic<unsigned> executed{ 0 };
+
+		const std::clock_t cpuStart = std::clock();
+		for (unsigned i = 0; i < NUM_TASKS; i++) {
+			const auto added = std::chrono::steady_clock::now();
+			queue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&latencies, &executed, added, i](TasksQueue*, const TaskPtr&) -> void {
+					latencies[i] = std::chrono::steady_clock::now() - added;
+					++executed;
+				}
+			));
+			WaitFor(gap);
+		}
+		while (executed < NUM_TASKS) {
+			std::this_thread::yield();
+		}
+		const double cpuMs = 1000.0 * static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+		queue.Cleanup();
+
+		std::sort(latencies.begin(), latencies.end());
+		std::printf("%-24s %8lld us gap %10.2f us p50 %10.2f us p99 %10.1f ms CPU\n",
+			strategy.name,
+			static_cast<long long>(gap.count()),
+			static_cast<double>(latencies[NUM_TASKS / 2].count()) / 1000.0,
+			static_cast<double>(latencies[NUM_TASKS * 99 / 100].count()) / 1000.0,
+			cpuMs
+		);
+	}
+
+}
+
+int main() {
+	const Strategy strategies[] = {
+		{ "park", TasksQueue::IdleStrategy() },
+		{ "spin 50us + yield 50us", TasksQueue::IdleStrategy(std::chrono::microseconds(50), std::chrono::microseconds(50), false) },
+		{ "adaptive 50us + 50us", TasksQueue::IdleStrategy(std::chrono::microseconds(50), std::chrono::microseconds(50), true) },
+	};
+	const std::chrono::microseconds gaps[] = { std::chrono::microseconds(5), std::chrono::microseconds(50), std::chrono::microseconds(500) };
+
+	std::printf("Task start latency by idle strategy, %u workers, %u tasks\n", NUM_WORKERS, NUM_TASKS);
+	for (const auto gap : gaps) {
+		for (const Strategy& strategy : strategies) {
+			Run(strategy, gap);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include <memory>
+
+#include "BenchTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+
+using namespace TasksLib;
+
+namespace {
+
+	constexpr unsigned NUM_WORKERS = 4;
+	constexpr unsigned NUM_PRODUCERS = 4;
+	constexpr uint64_t NUM_ITEMS = 200000;
+
+	void WaitForItems(const std::atomic<uint64_t>& executed) {
+		while (executed.load() < NUM_ITEMS) {
+			std::this_thread::yield();
+		}
+	}
+
+	/* Submits NUM_ITEMS one-shot callables from numProducers threads with submit(queue, executed) */
+	template <typename Submit> void Run(const char* name, const unsigned numProducers, Submit submit) {
+		TasksQueue queue{ { NUM_WORKERS, 0, 1 } };
+		std::atomic<uint64_t> executed{ 0 };
+
+		auto start = std::chrono::steady_clock::now();
+		RunContended(numProducers, [&](unsigned) {
+			for (uint64_t i = 0; i < NUM_ITEMS / numProducers; i++) {
+				submit(queue, executed);
+			}
+		});
+		WaitForItems(executed);
+		PrintResult(name, std::chrono::steady_clock::now() - start, NUM_ITEMS);
+	}
+
+}
+
+int main() {
+	std::printf("One-shot callables, %u workers, %llu items\n", NUM_WORKERS, static_cast<unsigned long long>(NUM_ITEMS));
+
+	auto addTask = [](TasksQueue& queue, std::atomic<uint64_t>& executed) {
+		queue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&executed](TasksQueue*, const TaskPtr&) -> void {
+				++executed;
+			}
+		));
+	};
+	auto post = [](TasksQueue& queue, std::atomic<uint64_t>& executed) {
+		queue.Post([&executed](TasksQueue*) -> void {
+			++executed;
+		});
+	};
+
+	Run("AddTask(make_shared<Task>), 1 producer", 1, addTask);
+	Run("Post(), 1 producer", 1, post);
+	Run("AddTask(make_shared<Task>), 4 producers", NUM_PRODUCERS, addTask);
+	Run("Post(), 4 producers", NUM_PRODUCERS, post);
+	return 0;
+}
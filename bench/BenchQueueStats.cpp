@@ -0,0 +1,121 @@
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+
+#include "BenchTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+
+using namespace TasksLib;
+
+namespace {
+
+	constexpr uint64_t TASKS_PER_THREAD = 200000;
+	constexpr unsigned NUM_SHARDS = 64;
+
+	// The bookkeeping every task does on its way through the queue - in 1.0, all of it on counters the threads share
+	template <class Counters>
+	void CountTask(Counters& counters, std::atomic<int64_t>& total) {
+		++counters.added;
+		++total;
+		++counters.completed;
+		--total;
+	}
+
+	// The 1.0 layout - one set of counters for all threads, next to the queue's hot flags
+	struct SharedStats {
+		std::atomic<bool> isShuttingDown{ false };
+		std::atomic<uint32_t> runningPriority{ 0 };
+		TasksQueuePerformanceStats<std::atomic<std::int32_t>> stats;
+		std::atomic<int64_t> total{ 0 };
+	};
+
+	// The current layout - a padded shard per thread. Only a queue with a capacity shares the depth and the bytes,
+	// see TasksQueue::ReserveCapacity()
+	struct ShardedStats {
+		struct alignas(CACHE_LINE_SIZE) Shard {
+			TasksQueuePerformanceStats<std::atomic<std::int64_t>> counters;
+		};
+		Shard shards[NUM_SHARDS];
+		alignas(CACHE_LINE_SIZE) std::atomic<int64_t> total{ 0 };
+		std::atomic<int64_t> bytes{ 0 };
+	};
+
+	// With maxTasks and maxBytes - the limits need exact shared counters
+	void CountLimitedTask(ShardedStats& sharded, TasksQueuePerformanceStats<std::atomic<std::int64_t>>& counters) {
+		constexpr int64_t TASK_BYTES = sizeof(Task);
+
+		int64_t total = sharded.total.load();
+		while (!sharded.total.compare_exchange_weak(total, total + 1)) {}
+		sharded.bytes.fetch_add(TASK_BYTES);
+		++counters.added;
+
+		++counters.completed;
+		sharded.bytes -= TASK_BYTES;
+		--sharded.total;
+	}
+	// Without limits - the depth is only a stat, it goes to the shard as well
+	void CountUnlimitedTask(TasksQueuePerformanceStats<std::atomic<std::int64_t>>& counters) {
+		++counters.total;
+		++counters.added;
+
+		++counters.completed;
+		--counters.total;
+	}
+
+}
+
+/* BenchQueueStats [threads] - one producer thread per core by default. On a single core the layouts differ only
+   by the atomic operations they do per task, the contention between the threads shows with more cores. */
+int main(int argc, char** argv) {
+	const unsigned numCores = std::max(std::thread::hardware_concurrency(), 1u);
+	const unsigned numThreads = (argc > 1) ? std::max(std::atoi(argv[1]), 1) : numCores;
+	const uint64_t operations = numThreads * TASKS_PER_THREAD;
+
+	std::printf("Per-task stats updates, %u threads x %llu tasks, %u cores\n", numThreads, static_cast<unsigned long long>(TASKS_PER_THREAD), numCores);
+	if (numCores < 2) {
+		std::printf("A single core doesn't show the contention between the threads, the results say little\n");
+	}
+
+	auto shared = std::make_unique<SharedStats>();
+	auto elapsed = RunContended(numThreads, [&shared](unsigned) {
+		for (uint64_t i = 0; i < TASKS_PER_THREAD; i++) {
+			CountTask(shared->stats, shared->total);
+		}
+	});
+	PrintResult("shared counters", elapsed, operations);
+
+	auto sharded = std::make_unique<ShardedStats>();
+	elapsed = RunContended(numThreads, [&sharded](unsigned thread) {
+		auto& counters = sharded->shards[thread % NUM_SHARDS].counters;
+		for (uint64_t i = 0; i < TASKS_PER_THREAD; i++) {
+			CountLimitedTask(*sharded, counters);
+		}
+	});
+	PrintResult("shards, with capacity", elapsed, operations);
+
+	elapsed = RunContended(numThreads, [&sharded](unsigned thread) {
+		auto& counters = sharded->shards[thread % NUM_SHARDS].counters;
+		for (uint64_t i = 0; i < TASKS_PER_THREAD; i++) {
+			CountUnlimitedTask(counters);
+		}
+	});
+	PrintResult("shards, no capacity", elapsed, operations);
+
+	// The whole queue, with the counters as they are now
+	constexpr uint64_t QUEUE_TASKS = 20000;
+	std::printf("\nTasksQueue with %u workers, %llu empty tasks\n", numThreads, static_cast<unsigned long long>(QUEUE_TASKS));
+
+	TasksQueue queue{ { static_cast<uint16_t>(numThreads), 0, 1 } };
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < QUEUE_TASKS; i++) {
+		queue.AddTask(std::make_shared<Task>((TaskExecutable)[](TasksQueue*, const TaskPtr&) -> void {}));
+	}
+	while (queue.GetPerformanceStats().total > 0) {
+		std::this_thread::yield();
+	}
+	PrintResult("add + execute", std::chrono::steady_clock::now() - start, QUEUE_TASKS);
+
+	const TasksQueuePerformanceStats<std::uint64_t> stats = queue.GetPerformanceStats();
+	return ((shared->stats.completed == static_cast<int32_t>(operations)) && (stats.completed == QUEUE_TASKS)) ? 0 : 1;
+}
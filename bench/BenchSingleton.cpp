@@ -0,0 +1,59 @@
+#include <memory>
+
+#include "BenchTools.h"
+#include "taskslib/ResourcePool.h"
+
+using namespace TasksLib;
+
+namespace {
+
+	struct Config {
+		uint64_t value = 1;
+	};
+
+	constexpr unsigned NUM_THREADS = 32;
+	constexpr uint64_t CALLS_PER_THREAD = 200000;
+
+	// The pre-1.1 implementation, only safe here because the instance is created before the threads start
+	std::weak_ptr<Config> unsynchronizedInstance;
+
+}
+
+int main() {
+	const uint64_t operations = NUM_THREADS * CALLS_PER_THREAD;
+	std::atomic<uint64_t> sink{ 0 };
+	auto keepAlive = Singleton<Config>::getInstance();
+	unsynchronizedInstance = keepAlive;
+
+	std::printf("Singleton<T> lookups, %u threads x %llu calls\n", NUM_THREADS, static_cast<unsigned long long>(CALLS_PER_THREAD));
+
+	auto elapsed = RunContended(NUM_THREADS, [&sink](unsigned) {
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i < CALLS_PER_THREAD; i++) {
+			sum += unsynchronizedInstance.lock()->value;
+		}
+		sink += sum;
+	});
+	PrintResult("weak_ptr::lock() (unsynchronized)", elapsed, operations);
+
+	elapsed = RunContended(NUM_THREADS, [&sink](unsigned) {
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i < CALLS_PER_THREAD; i++) {
+			sum += Singleton<Config>::getInstance()->value;
+		}
+		sink += sum;
+	});
+	PrintResult("getInstance()", elapsed, operations);
+
+	elapsed = RunContended(NUM_THREADS, [&sink](unsigned) {
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i < CALLS_PER_THREAD; i++) {
+			sum += Singleton<Config>::getCachedInstance()->value;
+		}
+		sink += sum;
+		Singleton<Config>::releaseCachedInstance();
+	});
+	PrintResult("getCachedInstance()", elapsed, operations);
+
+	return (sink.load() == 3 * operations) ? 0 : 1;
+}
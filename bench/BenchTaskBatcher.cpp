@@ -0,0 +1,76 @@
+#include <memory>
+#include <vector>
+
+#include "BenchTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TaskBatcher.h"
+
+using namespace TasksLib;
+
+namespace {
+
+	constexpr unsigned NUM_WORKERS = 4;
+	constexpr uint64_t NUM_ITEMS = 200000;
+
+	// A few dozen nanoseconds of work
+	void Work(std::atomic<uint64_t>& sum, const uint64_t item) {
+		sum.fetch_add(item * 2654435761u % 97, std::memory_order_relaxed);
+	}
+
+	void WaitForItems(const std::atomic<uint64_t>& executed) {
+		while (executed.load() < NUM_ITEMS) {
+			std::this_thread::yield();
+		}
+	}
+
+}
+
+int main() {
+	std::printf("Tiny tasks, %u workers, %llu items\n", NUM_WORKERS, static_cast<unsigned long long>(NUM_ITEMS));
+
+	{
+		TasksQueue queue{ { NUM_WORKERS, 0, 1 } };
+		std::atomic<uint64_t> sum{ 0 };
+		std::atomic<uint64_t> executed{ 0 };
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < NUM_ITEMS; i++) {
+			queue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&sum, &executed, i](TasksQueue*, const TaskPtr&) -> void {
+					Work(sum, i);
+					++executed;
+				}
+			));
+		}
+		WaitForItems(executed);
+		PrintResult("task per item", std::chrono::steady_clock::now() - start, NUM_ITEMS);
+	}
+
+	const TaskDelay windows[] = { TaskDelay{ 0 }, TaskDelay{ 1 } };
+	for (const TaskDelay window : windows) {
+		TasksQueue queue{ { NUM_WORKERS, 0, 1 } };
+		std::atomic<uint64_t> sum{ 0 };
+		std::atomic<uint64_t> executed{ 0 };
+		std::atomic<uint64_t> batches{ 0 };
+		TaskBatcher<uint64_t> batcher(&queue, [&sum, &executed, &batches](TasksQueue*, std::vector<uint64_t>& items) -> void {
+			for (const uint64_t item : items) {
+				Work(sum, item);
+			}
+			executed += items.size();
+			++batches;
+		}, window, 1024);
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < NUM_ITEMS; i++) {
+			batcher.Add(i);
+		}
+		WaitForItems(executed);
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "batcher %lldms window, %llu tasks", static_cast<long long>(window.count()), static_cast<unsigned long long>(batches.load()));
+		PrintResult(name, elapsed, NUM_ITEMS);
+	}
+	return 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/* Runs body(threadIndex) on numThreads threads released at the same moment,
+   returns the wall time from the release until the last thread finishes */
+inline std::chrono::nanoseconds RunContended(const unsigned numThreads, const std::function<void(unsigned)>& body) {
+	std::atomic<unsigned> ready{ 0 };
+	std::atomic<bool> go{ false };
+	std::vector<std::thread> threads;
+
+	for (unsigned i = 0; i < numThreads; i++) {
+		threads.emplace_back([&, i]() {
+			++ready;
+			while (!go.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+			body(i);
+		});
+	}
+	while (ready.load() < numThreads) {
+		std::this_thread::yield();
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	return std::chrono::steady_clock::now() - start;
+}
+
+inline void PrintResult(const char* name, const std::chrono::nanoseconds elapsed, const uint64_t operations) {
+	std::printf("%-40s %12.2f ns/op %14.0f ops/s\n",
+		name,
+		static_cast<double>(elapsed.count()) / static_cast<double>(operations),
+		static_cast<double>(operations) * 1e9 / static_cast<double>(elapsed.count())
+	);
+}
@@ -1,17 +1,36 @@
-#include <mutex>
-
 #include "taskslib/Task.h"
+#include "taskslib/TaskGroup.h"
+#include "taskslib/TasksTracer.h"
+#include "taskslib/TasksObserver.h"
 
 namespace TasksLib {
 
 	Task::Task() 
 		: _status(TASK_INIT)
 		, _doReschedule(false)
+		, _isCancelled(false)
+		, _parkState(PARK_NONE)
+		, _parkResult(0)
+		, _ownerQueue(nullptr)
+		, _isScheduled(false)
+		, _scheduleIt()
+		, _scheduleNode()
+		, _periodDue(scheduleTimePoint::min())
+		, _isRateHeld(false)
+		, _hasRateToken(false)
+		, _rateHeldIt()
+		, _indexedTag(0)
+		, _indexedTagIt()
+		, _indexedDedupKey(0)
+		, _isDedupAdding(false)
+		, _isDedupReplaced(false)
+		, _lastWorker(0)
+		, _queuedBytes(0)
 	{}
 	Task::~Task() = default;
 
     [[maybe_unused]] TaskStatus Task::GetStatus() const {
-		return _status;
+		return _status.load(std::memory_order_acquire);
 	}
 	TaskOptions const& Task::GetOptions() const {
 		return _options;
@@ -20,46 +39,74 @@ namespace TasksLib {
 		return _rescheduleOptions;
 	}
     [[maybe_unused]] bool Task::WillReschedule() const {
-		return _doReschedule;
+		return _doReschedule.load(std::memory_order_acquire);
 	}
 
     template <> void Task::Reschedule() {
-        _doReschedule = true;
+        _doReschedule.store(true, std::memory_order_release);
     }
-
-	std::mutex& Task::GetTaskMutex_() {
-		return _taskMutex;
+    [[maybe_unused]] void Task::Park() {
+		_parkState.store(PARK_REQUESTED, std::memory_order_release);
+	}
+    [[maybe_unused]] uint32_t Task::GetParkResult() const {
+		return _parkResult.load(std::memory_order_acquire);
 	}
+
 	void Task::Execute(TasksQueue* queue, const TaskPtr& task) {
 		// Here *task == *this, but it is a shared_ptr supplied by the queue and holds a stake 
 		// at the point of creation of the task, which ensures that even if everything gets released,
 		// the task will still exist until it finishes
 
-		{
-			std::unique_lock<std::mutex> lock(_taskMutex);
-			if (_options.executable) {
-                _status = TASK_WORKING;
-				ResetReschedule_();
-                // Unlock the task while executing
-                lock.unlock();
+		// The queue has moved the task to TASK_WORKING and moves it on afterwards in TasksQueue::RescheduleTask()
+		if (_options.executable && !_isCancelled.load(std::memory_order_acquire)) {
+			// A periodic task keeps to the schedule its first run has set
+			if ((_options.period.interval > TaskDelay{ 0 }) && (_periodDue == scheduleTimePoint::min())) {
+				_periodDue = scheduleClock::now();
+			}
+			ResetReschedule_();
+
+			TasksObserver::OnExecuteBegin(queue, *this);
+			{
+				TasksTracer::Span span(TRACE_EXECUTE, this);
 				_options.executable(queue, task);
 			}
+			TasksObserver::OnExecuteEnd(queue, *this);
 		}
+	}
 
-		{
-			std::lock_guard<std::mutex> lock(_taskMutex);
-			if (!_doReschedule) {
-                _status = TASK_FINISHED;
+	/* Moves the task to TASK_WORKING from whatever state it is in, unless it has been cancelled */
+	bool Task::Start_() {
+		TaskStatus status = _status.load(std::memory_order_acquire);
+		do {
+			if (status == TASK_CANCELLED) {
+				return false;
 			}
-		}
+		} while (!_status.compare_exchange_weak(status, TASK_WORKING, std::memory_order_acq_rel, std::memory_order_acquire));
+		return true;
+	}
+	bool Task::Transition_(TaskStatus from, const TaskStatus to) {
+		return _status.compare_exchange_strong(from, to, std::memory_order_acq_rel, std::memory_order_acquire);
 	}
 	
 	void Task::ResetReschedule_() {
-        _doReschedule = false;
+        _doReschedule.store(false, std::memory_order_relaxed);
         _rescheduleOptions = _options;
 	}
-	/* This is called by the queue to copy the reschedule options to the task, locking handled from outside */
+	/* This is called by the queue to copy the reschedule options to the task, after it has seen _doReschedule */
 	void Task::ApplyReschedule_() {
         _options = _rescheduleOptions;
+        _periodDue = scheduleTimePoint::min();			// Rescheduling by hand starts the period over
+	}
+	/* Drops the callbacks and whatever they captured, by whoever has made the transition to TASK_CANCELLED */
+	void Task::ReleaseExecutables_() {
+		_options.executable = nullptr;
+		_rescheduleOptions.executable = nullptr;
+	}
+	/* Counts the task as finished for its TaskGroup, by whoever has made the final transition */
+	void Task::LeaveGroup_() {
+		if (std::shared_ptr<TaskGroupState> group = std::move(_group)) {
+			_group = nullptr;
+			group->Release();
+		}
 	}
 }
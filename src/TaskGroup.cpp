@@ -0,0 +1,62 @@
+#include <algorithm>
+
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TaskGroup.h"
+
+namespace TasksLib {
+
+	// ===== TaskGroupState =============================================================
+	TaskGroupState::TaskGroupState()
+		: _pending(0)
+		, _wakeups(0)
+	{}
+
+	void TaskGroupState::Acquire() {
+		_pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	void TaskGroupState::Release() {
+		if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			// The lock makes sure a waiter is either asleep already or hasn't checked the counter yet
+			std::lock_guard<std::mutex> lock(_waitMutex);
+			_waitCondition.notify_all();
+		}
+	}
+
+	// ===== TaskGroup ==================================================================
+	TaskGroup::TaskGroup(TasksQueue* queue)
+		: _queue(queue)
+		, _state(std::make_shared<TaskGroupState>())
+	{}
+	TaskGroup::~TaskGroup() = default;
+
+    [[maybe_unused]] bool TaskGroup::AddTask(const TaskPtr& task) {
+		if (!_queue) {
+			return false;
+		}
+
+		// The queue attaches the group once it has accepted the task, a task it refuses - one that is in flight, or in
+		// another group - is left alone
+		const TaskAddResult result = _queue->TryAddTask(task, _state);
+		return (result == ADD_OK) || (result == ADD_MERGED);
+	}
+    [[maybe_unused]] uint32_t TaskGroup::GetPending() const {
+		return _state->_pending.load(std::memory_order_acquire);
+	}
+
+    [[maybe_unused]] void TaskGroup::Wait() {
+		WaitUntil(scheduleTimePoint::max());
+	}
+    [[maybe_unused]] bool TaskGroup::WaitFor(const std::chrono::milliseconds timeout) {
+		return WaitUntil(scheduleClock::now() + timeout);
+	}
+
+	bool TaskGroup::WaitUntil(const scheduleTimePoint deadline) {
+		if (!_queue) {
+			return GetPending() == 0;
+		}
+
+		return _queue->WaitForGroup(*_state, deadline);
+	}
+
+}
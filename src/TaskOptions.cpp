@@ -8,6 +8,13 @@ namespace TasksLib {
 		, isMainThread(false)
 		, executable(nullptr)
 		, suspendTime(0)
+		, cancelTag()
+		, deadline(TaskDeadline::max())
+		, affinity(AFFINITY_NONE)
+		, period()
+		, rateClass()
+		, footprint()
+		, dedupKey()
 	{
 	}
 	TaskOptions::TaskOptions(const TaskOptions& other) noexcept = default;
@@ -24,6 +31,13 @@ namespace TasksLib {
 		isMainThread	= other.isMainThread;
 		executable		= std::move(other.executable);
 		suspendTime		= other.suspendTime;
+		cancelTag		= other.cancelTag;
+		deadline		= other.deadline;
+		affinity		= other.affinity;
+		period			= other.period;
+		rateClass		= other.rateClass;
+		footprint		= other.footprint;
+		dedupKey		= other.dedupKey;
 
 		return *this;
 	}
@@ -36,6 +50,13 @@ namespace TasksLib {
 			&& ((bool)executable == (bool)other.executable)
 			&& (executable.target_type() == other.executable.target_type())
 			&& (suspendTime == other.suspendTime)
+			&& (cancelTag == other.cancelTag)
+			&& (deadline == other.deadline)
+			&& (affinity == other.affinity)
+			&& (period == other.period)
+			&& (rateClass == other.rateClass)
+			&& (footprint == other.footprint)
+			&& (dedupKey == other.dedupKey)
         );
 	}
 	bool TaskOptions::operator!=(const TaskOptions& other) const {
@@ -66,5 +87,26 @@ namespace TasksLib {
     [[maybe_unused]] void TaskOptions::SetOption_(const TaskDelay& _ms) {
 		suspendTime = _ms;
 	}
+    [[maybe_unused]] void TaskOptions::SetOption_(const TaskCancelTag& _tag) {
+		cancelTag = _tag;
+	}
+    [[maybe_unused]] void TaskOptions::SetOption_(const TaskDeadline& _deadline) {
+		deadline = _deadline;
+	}
+    [[maybe_unused]] void TaskOptions::SetOption_(const TaskAffinity& _affinity) {
+		affinity = _affinity;
+	}
+    [[maybe_unused]] void TaskOptions::SetOption_(const TaskPeriod& _period) {
+		period = _period;
+	}
+    [[maybe_unused]] void TaskOptions::SetOption_(const TaskRateClass& _rateClass) {
+		rateClass = _rateClass;
+	}
+    [[maybe_unused]] void TaskOptions::SetOption_(const TaskFootprint& _footprint) {
+		footprint = _footprint;
+	}
+    [[maybe_unused]] void TaskOptions::SetOption_(const TaskDedupKey& _dedupKey) {
+		dedupKey = _dedupKey;
+	}
 
 }
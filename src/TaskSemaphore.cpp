@@ -0,0 +1,85 @@
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TaskSemaphore.h"
+
+namespace TasksLib {
+
+	// ===== TaskSemaphore ==============================================================
+	TaskSemaphore::TaskSemaphore(const uint32_t permits)
+		: _available(permits)
+	{}
+
+    [[maybe_unused]] bool TaskSemaphore::Acquire(TasksQueue* queue, const TaskPtr& task) {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_available > 0) {
+			--_available;
+			return true;
+		}
+
+		// Parked under the lock, so that Release() can't hand the permit over before the task is parked
+		task->Park();
+		_waiters.push_back(Waiter{ queue, task });
+		return false;
+	}
+    [[maybe_unused]] bool TaskSemaphore::TryAcquire() {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_available == 0) {
+			return false;
+		}
+		--_available;
+		return true;
+	}
+    [[maybe_unused]] void TaskSemaphore::Release() {
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		while (!_waiters.empty()) {
+			Waiter waiter = std::move(_waiters.front());
+			_waiters.pop_front();
+
+			// The permit goes with the task, nobody can take it meanwhile
+			lock.unlock();
+			const bool isWoken = waiter.queue->Unpark(waiter.task);
+			lock.lock();
+			if (isWoken) {
+				return;
+			}
+		}
+		++_available;
+	}
+
+    [[maybe_unused]] uint32_t TaskSemaphore::GetAvailable() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _available;
+	}
+    [[maybe_unused]] size_t TaskSemaphore::GetWaiting() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _waiters.size();
+	}
+
+	// ===== TaskMutex ==================================================================
+	TaskMutex::TaskMutex()
+		: _semaphore(1)
+	{}
+
+    [[maybe_unused]] bool TaskMutex::Lock(TasksQueue* queue, const TaskPtr& task) {
+		return _semaphore.Acquire(queue, task);
+	}
+    [[maybe_unused]] bool TaskMutex::TryLock() {
+		return _semaphore.TryAcquire();
+	}
+    [[maybe_unused]] void TaskMutex::Unlock() {
+		_semaphore.Release();
+	}
+
+    [[maybe_unused]] bool TaskMutex::IsLocked() const {
+		return _semaphore.GetAvailable() == 0;
+	}
+    [[maybe_unused]] size_t TaskMutex::GetWaiting() const {
+		return _semaphore.GetWaiting();
+	}
+
+}
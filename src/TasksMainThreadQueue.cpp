@@ -0,0 +1,72 @@
+#include "taskslib/Task.h"
+#include "taskslib/TasksMainThreadQueue.h"
+
+namespace TasksLib {
+
+	TasksMainThreadQueue::Node::Node()
+		: next(nullptr)
+		, isLinked(false)
+		, isAllocated(false)
+	{}
+
+	TasksMainThreadQueue::TasksMainThreadQueue()
+		: _head(&_stub)
+		, _tail(&_stub)
+	{}
+	TasksMainThreadQueue::~TasksMainThreadQueue() {
+		// The queued tasks reference themselves through their nodes
+		while (Pop()) {}
+	}
+
+	void TasksMainThreadQueue::Push(const TaskPtr& task) {
+		Node* node = &task->_mainThreadNode;
+		if (node->isLinked.exchange(true, std::memory_order_acquire)) {
+			node = new Node();
+			node->isAllocated = true;
+		}
+		node->task = task;
+		PushNode(node);
+	}
+	void TasksMainThreadQueue::PushNode(Node* node) {
+		node->next.store(nullptr, std::memory_order_relaxed);
+		Node* prev = _head.exchange(node, std::memory_order_acq_rel);
+		// Between the exchange and this store the list is broken, Pop() sees a node without next and waits for it
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	TaskPtr TasksMainThreadQueue::Pop() {
+		Node* tail = _tail;
+		Node* next = tail->next.load(std::memory_order_acquire);
+
+		if (tail == &_stub) {
+			if (!next) {
+				return nullptr;
+			}
+			_tail = next;
+			tail = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+
+		if (!next) {
+			if (tail != _head.load(std::memory_order_acquire)) {
+				return nullptr;		// A producer is in the middle of pushing after it
+			}
+			// The last node can't be taken out while it is the head, the stub goes in behind it
+			PushNode(&_stub);
+			next = tail->next.load(std::memory_order_acquire);
+			if (!next) {
+				return nullptr;
+			}
+		}
+
+		_tail = next;
+		TaskPtr task = std::move(tail->task);
+		if (tail->isAllocated) {
+			delete tail;
+		} else {
+			tail->isLinked.store(false, std::memory_order_release);
+		}
+		return task;
+	}
+
+}
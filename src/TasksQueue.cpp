@@ -1,32 +1,147 @@
 #include <tuple>
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
 
 #include "taskslib/TasksThread.h"
 #include "taskslib/Task.h"
 #include "taskslib/TasksQueue.h"
+#include "taskslib/TaskGroup.h"
+#include "taskslib/TasksWorkerPool.h"
+#include "taskslib/TasksTracer.h"
+#include "taskslib/TasksObserver.h"
 
 #define DEFAULT_TQUEUE_BLOCKING		6
 #define DEFAULT_TQUEUE_NONBLOCKING	2
 #define DEFAULT_TQUEUE_SCHEDULING	1
+#define DEFAULT_TQUEUE_AGING_MS		100
+#define DEFAULT_TQUEUE_OVERFLOW_MS	100
+#define MAX_LOCAL_RUNS				32		// Rescheduled tasks a worker keeps in a row before one has to go through the queue
+#define STATS_SHARDS				64		// Threads whose ids differ by less than this count into different shards
+#define IDLE_SPIN_PAUSES			32		// CPU pauses between two looks at the clock while spinning
+#define IDLE_GAP_WEIGHT				8		// Adaptive idle strategies follow the gaps between tasks with a moving average of this weight
+#define IDLE_GAP_MARGIN				2		// and poll for this many times the average gap
+
+namespace {
+
+	// What the worker thread is executing, so that a task rescheduling itself can stay on the same thread
+	struct WorkerContext {
+		TasksLib::TasksQueue* queue = nullptr;
+		const TasksLib::Task* current = nullptr;
+		TasksLib::TaskPtr next;					// The worker's run-next slot
+		uint32_t localRuns = 0;
+		bool ignoreBlocking = false;
+	};
+
+	thread_local WorkerContext t_worker;
+	std::atomic<uint32_t> s_lastWorkerId{ 0 };
+	thread_local const uint32_t t_workerId = ++s_lastWorkerId;
+
+	inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+		_mm_pause();
+#elif defined(__aarch64__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	uint64_t CollectCounter(std::atomic<int64_t>& counter, const bool reset) {
+		const int64_t value = reset ? counter.exchange(0, std::memory_order_relaxed) : counter.load(std::memory_order_relaxed);
+		return static_cast<uint64_t>(value);
+	}
+
+}
 
 namespace TasksLib {
 
+	// ===== TasksQueue::Capacity =======================================================
+	TasksQueue::Capacity::Capacity()
+		: maxTasks(0)
+		, maxBytes(0)
+		, overflowPolicy(OVERFLOW_REJECT)
+		, overflowTimeout(DEFAULT_TQUEUE_OVERFLOW_MS) {}
+
+	// ===== TasksQueue::IdleStrategy ===================================================
+	TasksQueue::IdleStrategy::IdleStrategy()
+		: IdleStrategy(std::chrono::microseconds(0), std::chrono::microseconds(0)) {}
+	TasksQueue::IdleStrategy::IdleStrategy(std::chrono::microseconds spinTime, std::chrono::microseconds yieldTime, bool adaptive)
+		: spin(spinTime)
+		, yield(yieldTime)
+		, isAdaptive(adaptive) {}
+
+	// ===== TasksQueue::IdleState ======================================================
+	struct TasksQueue::IdleState {
+		explicit IdleState(const IdleStrategy& idleStrategy)
+			: strategy(idleStrategy)
+			, averageGap((idleStrategy.spin + idleStrategy.yield) / IDLE_GAP_MARGIN)		// The first wait polls for the whole budget
+			, idleSince(scheduleTimePoint::min())
+		{}
+
+		/* How long to poll for the next task before sleeping - the spin and yield budget, or with an adaptive strategy
+		   a margin over the average gap between tasks, within the budget. Nothing if the gap is longer than the budget,
+		   the next task usually comes after the polling would end. */
+		[[nodiscard]] scheduleDuration GetPollTime() const {
+			const scheduleDuration budget = strategy.spin + strategy.yield;
+			if (!strategy.isAdaptive) {
+				return budget;
+			}
+			if (averageGap > budget) {
+				return scheduleDuration(0);
+			}
+			return std::min<scheduleDuration>(averageGap * IDLE_GAP_MARGIN, budget);
+		}
+		void Begin() {
+			if (strategy.isAdaptive && ((strategy.spin.count() > 0) || (strategy.yield.count() > 0))) {
+				idleSince = scheduleClock::now();
+			}
+		}
+		void End() {
+			if (idleSince != scheduleTimePoint::min()) {
+				averageGap += (scheduleClock::now() - idleSince - averageGap) / IDLE_GAP_WEIGHT;
+				idleSince = scheduleTimePoint::min();
+			}
+		}
+
+		const IdleStrategy strategy;
+		scheduleDuration averageGap;			// Between running out of tasks and getting the next one
+		scheduleTimePoint idleSince;
+	};
+
 	// ===== TasksQueue::Configuration ==================================================
 	TasksQueue::Configuration::Configuration()
 		: Configuration(DEFAULT_TQUEUE_BLOCKING, DEFAULT_TQUEUE_NONBLOCKING, DEFAULT_TQUEUE_SCHEDULING) {}
 	TasksQueue::Configuration::Configuration(uint16_t numBlockingThreads, uint16_t numNonBlockingThreads, uint16_t numSchedulingThreads)
 		: blockingThreads(numBlockingThreads)
 		, nonBlockingThreads(numNonBlockingThreads)
-		, schedulingThreads(numSchedulingThreads) {}
+		, schedulingThreads(numSchedulingThreads)
+		, policy(POLICY_PRIORITY)
+		, deadlineMissPolicy(DEADLINE_MISS_RUN)
+		, priorityAgingTime(DEFAULT_TQUEUE_AGING_MS)
+		, capacity()
+		, blockingIdle()
+		, nonBlockingIdle() {}
 
 	// ===== TasksQueue =================================================================
 	TasksQueue::TasksQueue()
 		: _isInitialized(false)
 		, _isShuttingDown(false)
-		, _runningPriority(0)
 		, _numNonBlockingThreads(0)
-		, _scheduleEarliest(scheduleTimePoint::min())
+		, _pool(nullptr)
+		, _runningPriority(0)
+		, _statsShards(new StatsShard[STATS_SHARDS])
+		, _total(0)
+		, _bytes(0)
+		, _scheduleEarliest(scheduleTimePoint::max())		// Nothing is due, the first timer notifies whoever waits for it
+		, _isWorkerTimers(false)
+		, _hasTimerLeader(false)
+		, _tasksPushed(0)
+		, _numGroupWaiters(0)
+		, _capacity()
+		, _capacityWaiters(0)
 	{}
 	TasksQueue::TasksQueue(const Configuration& configuration)
 		: TasksQueue()
@@ -57,23 +172,39 @@ namespace TasksLib {
 		return static_cast<uint16_t>(_schedulingThreads.size());
 	}
 
-	TasksQueuePerformanceStats<std::uint32_t> TasksQueue::GetPerformanceStats(const bool reset) {
-		TasksQueuePerformanceStats<std::uint32_t> stats;
+	TasksQueuePerformanceStats<std::uint64_t> TasksQueue::GetPerformanceStats(const bool reset) {
+		TasksQueuePerformanceStats<std::uint64_t> stats;
+
+		// Shard by shard, so the sums are not a snapshot of a single moment - a task may be counted as added
+		// and not yet as completed, or the other way around
+		int64_t waiting = 0;
+		int64_t total = 0;
+		for (size_t i = 0; i < STATS_SHARDS; ++i) {
+			StatsCounters& counters = _statsShards[i].counters;
 
-        if (reset) {
-            stats.added = _stats.added.exchange(0);
-            stats.completed = _stats.completed.exchange(0);
-            stats.suspended = _stats.suspended.exchange(0);
-            stats.resumed = _stats.resumed.exchange(0);
-        } else {
-            stats.added = _stats.added.load();
-            stats.completed = _stats.completed.load();
-            stats.suspended = _stats.suspended.load();
-            stats.resumed = _stats.resumed.load();
-        }
+			stats.added += CollectCounter(counters.added, reset);
+			stats.completed += CollectCounter(counters.completed, reset);
+			stats.suspended += CollectCounter(counters.suspended, reset);
+			stats.resumed += CollectCounter(counters.resumed, reset);
+			stats.cancelled += CollectCounter(counters.cancelled, reset);
+			stats.deadlineMissed += CollectCounter(counters.deadlineMissed, reset);
+			stats.deadlineDropped += CollectCounter(counters.deadlineDropped, reset);
+			stats.executedLocal += CollectCounter(counters.executedLocal, reset);
+			stats.executedMigrated += CollectCounter(counters.executedMigrated, reset);
+			stats.periodsSkipped += CollectCounter(counters.periodsSkipped, reset);
+			stats.throttled += CollectCounter(counters.throttled, reset);
+			stats.overflowRejected += CollectCounter(counters.overflowRejected, reset);
+			stats.overflowDropped += CollectCounter(counters.overflowDropped, reset);
+			stats.deduplicated += CollectCounter(counters.deduplicated, reset);
 
-		stats.waiting = _stats.waiting.load();
-		stats.total = _stats.total.load();
+			// A task may be suspended by one thread and resumed by another, only the sum is the gauge
+			waiting += counters.waiting.load(std::memory_order_relaxed);
+			total += counters.total.load(std::memory_order_relaxed);
+		}
+
+		stats.waiting = static_cast<uint64_t>(std::max<int64_t>(waiting, 0));
+		stats.total = static_cast<uint64_t>(std::max<int64_t>(total + _total.load(), 0));
+		stats.bytes = static_cast<uint64_t>(std::max<int64_t>(_bytes.load(), 0));
 
 		return stats;
 	}
@@ -88,6 +219,14 @@ namespace TasksLib {
 			return;
 		}
 
+		{
+			std::lock_guard<std::mutex> lockTasks(_tasksMutex);
+			_tasks.SetPolicy(configuration.policy, configuration.deadlineMissPolicy, configuration.priorityAgingTime);
+		}
+
+		_capacity = configuration.capacity;
+		_idleStrategies[0] = configuration.blockingIdle;
+		_idleStrategies[1] = configuration.nonBlockingIdle;
 		CreateThreads(configuration);
         _isInitialized = true;
 	}
@@ -96,10 +235,20 @@ namespace TasksLib {
 			return;
 		}
 
-        _isShuttingDown = true;
+		{
+			// Taking the locks makes sure no thread is between checking its predicate and going to sleep
+			std::lock_guard<std::mutex> lockSched(_schedulerMutex);
+			std::lock_guard<std::mutex> lockTasks(_tasksMutex);
+			_isShuttingDown = true;
+		}
 
 		_tasksCondition.notify_all();
+		_timerCondition.notify_all();
 		_scheduleCondition.notify_all();
+		{
+			std::lock_guard<std::mutex> lockCapacity(_capacityMutex);
+		}
+		_capacityCondition.notify_all();
 		for (const std::shared_ptr<TasksThread>& thread : _workerThreads) {
 			thread->join();
 		}
@@ -112,49 +261,256 @@ namespace TasksLib {
 			_workerThreads.clear();
 			_schedulingThreads.clear();
             _numNonBlockingThreads = 0;
+            _isWorkerTimers = false;
+            _pool = nullptr;
             _isInitialized = false;
             _isShuttingDown = false;
 		}
 	}
 
     [[maybe_unused]] bool TasksQueue::AddTask(const TaskPtr& task) {
+		const TaskAddResult result = TryAddTask(task);
+		return (result == ADD_OK) || (result == ADD_MERGED);
+	}
+    [[maybe_unused]] TaskAddResult TasksQueue::TryAddTask(const TaskPtr& task) {
+		return TryAddTask(task, nullptr);
+	}
+	TaskAddResult TasksQueue::TryAddTask(const TaskPtr& task, const std::shared_ptr<TaskGroupState>& group) {
 		if (!_isInitialized || _isShuttingDown) {
-			return false;
+			return ADD_NOT_RUNNING;
 		}
 
-		++_stats.added;
-		std::unique_lock<std::mutex> lock(task->GetTaskMutex_());
-		return AddTask(task, std::move(lock));
+		if (!task) {
+			return ADD_INVALID;
+		}
+		// Only a task that isn't on a queue right now - a new one or one that has finished - may be added. A task that is
+		// working, waiting or queued belongs to the queue that has it, it would run twice or lose its run.
+		const TaskStatus status = task->_status.load(std::memory_order_acquire);
+		if (task->_isCancelled || ((status != TASK_INIT) && (status != TASK_FINISHED))) {
+			return ADD_INVALID;
+		}
+		if (group && task->_group) {
+			return ADD_INVALID;
+		}
+		task->_ownerQueue.store(this, std::memory_order_relaxed);		// Published by the status transition that follows
+
+		const bool isDeduplicated = (task->_options.dedupKey.value != 0);
+		if (isDeduplicated) {
+			const TaskAddResult merged = MergeDuplicate(task, status);
+			if (merged != ADD_OK) {
+				return merged;
+			}
+		}
+
+		TaskAddResult result = ReserveCapacity(task);
+		if (result == ADD_FULL) {
+			result = Overflow(task);
+		}
+		if (result != ADD_OK) {
+			if (result != ADD_NOT_RUNNING) {
+				++Stats().overflowRejected;
+			}
+			UnindexDedupKey(task.get());
+			if (isDeduplicated) {
+				EndDedupAdd(task);
+			}
+			return result;
+		}
+
+		++Stats().added;
+		TasksTracer::Record(TRACE_ADD, task.get());
+		if (group) {
+			// Nobody else touches the task until its status changes, then whoever finishes it leaves the group
+			task->_group = group;
+			group->Acquire();
+		}
+		if (!AddTask(task, status)) {
+			if (group) {
+				task->LeaveGroup_();
+			}
+			UnindexDedupKey(task.get());
+			if (isDeduplicated) {
+				EndDedupAdd(task);
+			}
+			ReleaseCapacity(task.get());
+			return ADD_INVALID;
+		}
+		if (isDeduplicated) {
+			EndDedupAdd(task);
+		}
+		return ADD_OK;
 	}
-	void TasksQueue::Update() {
-		if (!_isInitialized || _isShuttingDown) {
-			return;
+    [[maybe_unused]] bool TasksQueue::Cancel(const TaskPtr& task) {
+		if (!task) {
+			return false;
 		}
 
-		if (_scheduleEarliest.load() <= scheduleClock::now()) {
-			_scheduleCondition.notify_one();
+		// Whoever moves the task out of its current status owns it, Cancel() competes with the worker, the main thread and the timer.
+		// Only the queue that has the task may cancel it, another queue's bookkeeping isn't ours to touch.
+		TaskStatus status = task->_status.load(std::memory_order_acquire);
+		do {
+			if (task->_ownerQueue.load(std::memory_order_relaxed) != this) {
+				return false;
+			}
+			switch (status) {
+				case TASK_SUSPENDED:
+				case TASK_IN_QUEUE:
+				case TASK_IN_QUEUE_MAIN_THREAD:
+				case TASK_WORKING:
+					break;
+				default:
+					return false;
+			}
+		} while (!task->_status.compare_exchange_weak(status, TASK_CANCELLED, std::memory_order_acq_rel, std::memory_order_acquire));
+		task->_isCancelled = true;
+		TasksTracer::Record(TRACE_CANCEL, task.get());
+
+		switch (status) {
+			case TASK_SUSPENDED: {
+				std::lock_guard<std::mutex> lockSched(_schedulerMutex);
+				// If it isn't there, the scheduling thread has just taken it out and will drop it instead of resuming it
+				if (task->_isScheduled) {
+					_scheduledTasks.erase(task->_scheduleIt);
+					task->_isScheduled = false;
+					--Stats().waiting;
+				} else if (task->_isRateHeld) {
+					_rateLimits[task->_options.rateClass.value].held.erase(task->_rateHeldIt);
+					task->_isRateHeld = false;
+					--Stats().waiting;
+				} else if (task->_parkState.exchange(PARK_NONE, std::memory_order_acq_rel) == PARK_PARKED) {
+					--Stats().waiting;		// Unpark() won't find it anymore
+				}
+				break;
+			}
+			case TASK_WORKING:
+				// The thread executing it finishes the job in RescheduleTask()
+				return true;
+			default:
+				// Stays where it is, whoever gets to it drops it
+				if (task->_options.priority > 0) {
+					_runningPriority = 0;
+				}
+				break;
 		}
 
-		std::vector<TaskPtr> runTasks;
-		std::vector<TaskPtr> ignoreTasks;
+		task->ReleaseExecutables_();
+		UnindexCancelTag(task.get());
+		UnindexDedupKey(task.get());
 
+		ReleaseCapacity(task.get());
+		++Stats().cancelled;
+		TasksObserver::OnCancel(this, *task);
+		task->LeaveGroup_();
+		return true;
+	}
+    [[maybe_unused]] size_t TasksQueue::CancelTag(const TaskCancelTag tag) {
+		if (tag.value == 0) {
+			return 0;
+		}
+
+		std::vector<TaskPtr> tasks;
 		{
-			std::lock_guard<std::mutex> lockTasks(_mtTasksMutex);
+			std::lock_guard<std::mutex> lock(_cancelMutex);
 
-			for (const auto& task : _mtTasks) {
-				if (task) {
-					std::lock_guard<std::mutex> lockTask(task->GetTaskMutex_());
+			auto tagIt = _cancelTags.find(tag.value);
+			if (tagIt == _cancelTags.end()) {
+				return 0;
+			}
+			for (const TaskWeakPtr& weakTask : tagIt->second) {
+				if (TaskPtr task = weakTask.lock()) {
+					tasks.push_back(std::move(task));
+				}
+			}
+		}
 
-					if (task->GetOptions().priority >= _runningPriority) {
-						runTasks.push_back(task);
-					}
-					else {
-						ignoreTasks.push_back(task);
-					}
+		size_t cancelled = 0;
+		for (const TaskPtr& task : tasks) {
+			if (Cancel(task)) {
+				++cancelled;
+			}
+		}
+
+		return cancelled;
+	}
+    [[maybe_unused]] bool TasksQueue::Unpark(const TaskPtr& task, const uint32_t result) {
+		if (!task) {
+			return false;
+		}
+
+		uint8_t state = task->_parkState.load(std::memory_order_acquire);
+		do {
+			if ((state != PARK_REQUESTED) && (state != PARK_PARKED)) {
+				return false;
+			}
+			task->_parkResult.store(result, std::memory_order_relaxed);
+		} while (!task->_parkState.compare_exchange_weak(state, (state == PARK_PARKED) ? PARK_NONE : PARK_WOKEN, std::memory_order_acq_rel, std::memory_order_acquire));
+
+		if (state == PARK_REQUESTED) {
+			return true;			// Still executing, ParkTask() sees it woken and doesn't park it
+		}
+		ResumeParkedTask(task);
+		return true;
+	}
+    [[maybe_unused]] bool TasksQueue::SetRateLimit(const TaskRateClass rateClass, const double tokensPerSecond, const uint32_t burst) {
+		if ((rateClass.value == 0) || !(tokensPerSecond >= 0.0) || ((tokensPerSecond > 0.0) && (burst == 0))) {
+			return false;
+		}
+
+		rateHeldList released;
+		bool isEarliest = false;
+		{
+			std::lock_guard<std::mutex> lockSched(_schedulerMutex);
+			const scheduleTimePoint now = scheduleClock::now();
+
+			auto limitIt = _rateLimits.find(rateClass.value);
+			if (tokensPerSecond == 0.0) {
+				if (limitIt == _rateLimits.end()) {
+					return true;
 				}
+				released.swap(limitIt->second.held);
+				_rateLimits.erase(limitIt);
+			} else if (limitIt == _rateLimits.end()) {
+				_rateLimits.emplace(rateClass.value, RateLimit{ tokensPerSecond, static_cast<double>(burst), static_cast<double>(burst), now, {} });
+			} else {
+				RateLimit& limit = limitIt->second;
+				limit.Refill(now);
+				limit.tokensPerSecond = tokensPerSecond;
+				limit.burst = burst;
+				limit.tokens = std::min(limit.tokens, limit.burst);
+				if (!limit.held.empty()) {
+					isEarliest = AdvanceScheduleEarliest(limit.NextToken());
+				}
+			}
+
+			for (const TaskPtr& task : released) {
+				task->_isRateHeld = false;
+				task->_hasRateToken = true;
+				--Stats().waiting;
 			}
+		}
+
+		if (isEarliest) {
+			NotifySchedule();
+		}
+		for (const TaskPtr& task : released) {
+			AddTask(task, TASK_SUSPENDED);
+		}
+		return true;
+	}
+	void TasksQueue::Update() {
+		if (!_isInitialized || _isShuttingDown) {
+			return;
+		}
+		TasksTracer::Span span(TRACE_UPDATE, this);
 
-            _mtTasks = std::move(ignoreTasks);
+		if (!_pool && (_scheduleEarliest.load() <= scheduleClock::now())) {
+			NotifySchedule();			// In case the timer's thread is late, it shouldn't be
+		}
+
+		// The ones left behind by the running priority are older than anything in the lane
+		_mtBatch.swap(_mtDeferred);
+		while (TaskPtr task = _mtTasks.Pop()) {
+			_mtBatch.push_back(std::move(task));
 		}
 
 		// TODO: Don't execute all tasks at once, instead examine stats and come up with a smaller number, but staying ahead of newly added ones.
@@ -162,15 +518,64 @@ namespace TasksLib {
 		//			1. One per Update() (risks falling behind)
 		//			2. All per Update() (risks delaying the main thread)
 		//			3. Auto (passive/eager) (less predictable)
-		while (!runTasks.empty()) {
-			TaskPtr task = runTasks.back();
+		for (const TaskPtr& task : _mtBatch) {
+			// Options don't change while the task is queued, the lane's push has published them
+			if (task->_isCancelled) {
+				continue;
+			}
+			if (task->GetOptions().priority < _runningPriority) {
+				_mtDeferred.push_back(task);
+				continue;
+			}
+
+			if (!task->Start_()) {
+				continue;			// Cancel() got to it first
+			}
+
+			TasksObserver::OnDequeue(this, *task);
 			task->Execute(this, task);
 			RescheduleTask(task);
-			runTasks.pop_back();
 		}
+		_mtBatch.clear();
+	}
+
+	bool TasksQueue::PostExecutable(PostedExecutable&& executable, const TaskOptions& options) {
+		if (!_isInitialized || _isShuttingDown || !executable) {
+			return false;
+		}
+
+		// Only the options the ready queue orders by, everything else needs a task to keep track of
+		if (options.isMainThread || (options.suspendTime > TaskDelay{ 0 }) || (options.cancelTag.value != 0)
+			|| (options.deadline != TaskDeadline::max()) || (options.period.interval > TaskDelay{ 0 })
+			|| (options.rateClass.value != 0) || (options.dedupKey.value != 0)
+			|| (_capacity.maxTasks > 0) || (_capacity.maxBytes > 0)
+			)
+		{
+			return AddTask(std::make_shared<Task>(
+				options,
+				(TaskExecutable)[executable = std::move(executable)](TasksQueue* queue, const TaskPtr&) -> void {
+					executable(queue);
+				}
+			));
+		}
+
+		++Stats().total;
+		++Stats().added;
+		{
+			std::lock_guard<std::mutex> lock(_tasksMutex);
+			_tasks.Push(std::move(executable), options);
+			_tasksPushed.fetch_add(1, std::memory_order_relaxed);
+		}
+		NotifyTasks();
+
+		if ((options.priority > _runningPriority) && (_tasks.GetPolicy() == POLICY_PRIORITY)) {
+			_runningPriority = options.priority;
+		}
+		return true;
 	}
 
 	void TasksQueue::CreateThreads(const Configuration& i_config) {
+		_isWorkerTimers = (i_config.schedulingThreads == 0);		// Before the workers start reading it
 		for (int i = 0; i < i_config.blockingThreads; ++i) {
 			auto thread = std::make_shared<TasksThread>(false, &TasksQueue::ThreadExecuteTasks, this, false);
 			_workerThreads.push_back(thread);
@@ -185,135 +590,919 @@ namespace TasksLib {
 			_schedulingThreads.push_back(thread);
 		}
 	}
-	bool TasksQueue::AddTask(const TaskPtr& task, [[maybe_unused]] const std::unique_lock<std::mutex> lockTask, const bool updateTotal) {
-		if (!task || _isShuttingDown) {
+	void TasksQueue::AttachToPool(TasksWorkerPool* pool, const Capacity& capacity) {
+		std::lock_guard<std::mutex> guard(_initMutex);
+
+		if (_isInitialized || _isShuttingDown) {
+			return;
+		}
+
+		_pool = pool;
+		_capacity = capacity;
+		_isInitialized = true;
+	}
+	bool TasksQueue::AddTask(const TaskPtr& task, const TaskStatus from, scheduleTimePoint wakeTime) {
+		if (!task || _isShuttingDown || task->_isCancelled) {
 			return false;
 		}
 
-		if (task->_options.suspendTime > std::chrono::milliseconds(0)) {
+		// Until the status changes nobody else touches the task, afterwards it may be executing or cancelled already
+		if (from != TASK_SUSPENDED) {
+			IndexCancelTag(task);			// A resumed task keeps its tag, and Cancel() may be unindexing it right now
+		}
+		const TaskPriority priority = task->_options.priority;
+
+		if ((task->_options.suspendTime > std::chrono::milliseconds(0)) || (wakeTime != scheduleTimePoint::min())) {
+			if (wakeTime == scheduleTimePoint::min()) {
+				wakeTime = scheduleClock::now() + task->_options.suspendTime;
+			}
+
+			bool isEarliest;
 			{
 				std::lock_guard<std::mutex> lockSched(_schedulerMutex);
-				_scheduledTasks.insert(schedulePair(scheduleClock::now() + task->_options.suspendTime, task));
-				++_stats.suspended;
-				++_stats.waiting;
-				task->_status = TaskStatus::TASK_SUSPENDED;
+				if (!task->Transition_(from, TASK_SUSPENDED)) {
+					return false;
+				}
+				if (task->_scheduleNode) {
+					// Relinks the node the task woke up with last time, so a ticker costs no allocation per period
+					task->_scheduleNode.key() = wakeTime;
+					task->_scheduleNode.mapped() = task;
+					task->_scheduleIt = _scheduledTasks.insert(std::move(task->_scheduleNode));
+				} else {
+					task->_scheduleIt = _scheduledTasks.insert(schedulePair(wakeTime, task));
+				}
+				task->_isScheduled = true;
+				TasksTracer::Record(TRACE_SUSPEND, task.get());
+				++Stats().suspended;
+				++Stats().waiting;
+				isEarliest = AdvanceScheduleEarliest(wakeTime);
 			}
 
-            _scheduleEarliest = scheduleTimePoint::min();
-			_scheduleCondition.notify_one();
+			TasksObserver::OnSuspend(this, *task);
+			if (isEarliest) {
+				NotifySchedule();
+			}
 		} else {
-			if (!task->GetOptions().isMainThread) {
+			bool isHeld = false;
+			if ((task->_options.rateClass.value != 0) && !HoldForRate(task, from, isHeld)) {
+				return false;
+			}
+			if (isHeld) {
+				return true;
+			}
+
+			if (!task->_options.isMainThread) {
 				{
 					std::lock_guard<std::mutex> lock(_tasksMutex);
-					_tasks.push_back(task);
-					task->_status = TaskStatus::TASK_IN_QUEUE;
+					if (!task->Transition_(from, TASK_IN_QUEUE)) {
+						return false;
+					}
+					_tasks.Push(task, task->_options);
+					_tasksPushed.fetch_add(1, std::memory_order_relaxed);
 				}
 
-				_tasksCondition.notify_all();
+				TasksObserver::OnEnqueue(this, *task);
+				NotifyTasks();
 			} else {
-				std::lock_guard<std::mutex> lock(_mtTasksMutex);
-				_mtTasks.push_back(task);
-				task->_status = TaskStatus::TASK_IN_QUEUE_MAIN_THREAD;
+				if (!task->Transition_(from, TASK_IN_QUEUE_MAIN_THREAD)) {
+					return false;
+				}
+				_mtTasks.Push(task);
+				TasksObserver::OnEnqueue(this, *task);
 			}
 
-			if (task->GetOptions().priority > _runningPriority) {
-                _runningPriority = task->GetOptions().priority;
+			if ((priority > _runningPriority) && (_tasks.GetPolicy() == POLICY_PRIORITY)) {
+                _runningPriority = priority;
 			}
 		}
 
-		if (updateTotal) {
-			++_stats.total;
+		return true;
+	}
+
+	TaskAddResult TasksQueue::ReserveCapacity(const TaskPtr& task) {
+		// Without a limit the depth is only a stat, the calling thread's shard counts it
+		if (_capacity.maxTasks == 0) {
+			++Stats().total;
+		} else {
+			int64_t total = _total.load();
+			do {
+				if (static_cast<uint32_t>(total) >= _capacity.maxTasks) {
+					return ADD_FULL;
+				}
+			} while (!_total.compare_exchange_weak(total, total + 1));
+		}
+
+		task->_queuedBytes = 0;
+		if (_capacity.maxBytes == 0) {
+			return ADD_OK;
 		}
+
+		// The bytes are approximate anyway, adds racing for the last of them may overshoot by a task each.
+		// A task bigger than the whole capacity still gets into an empty queue.
+		const size_t bytes = sizeof(Task) + task->_options.footprint.bytes;
+		const int64_t queuedBytes = _bytes.fetch_add(static_cast<int64_t>(bytes));
+		if ((queuedBytes > 0) && (static_cast<size_t>(queuedBytes) + bytes > _capacity.maxBytes)) {
+			_bytes -= static_cast<int64_t>(bytes);
+			if (_capacity.maxTasks == 0) {
+				--Stats().total;
+			} else {
+				--_total;
+			}
+			return ADD_FULL;
+		}
+
+		task->_queuedBytes = bytes;
+		return ADD_OK;
+	}
+	TaskAddResult TasksQueue::Overflow(const TaskPtr& task) {
+		switch (_capacity.overflowPolicy) {
+			case OVERFLOW_DROP_OLDEST:
+				while (DropOldestTask()) {
+					if (ReserveCapacity(task) == ADD_OK) {
+						return ADD_OK;
+					}
+				}
+				return ADD_FULL;
+
+			case OVERFLOW_BLOCK: {
+				if (t_worker.queue == this) {
+					return ADD_FULL;
+				}
+
+				TaskAddResult result;
+				const auto until = scheduleClock::now() + _capacity.overflowTimeout;
+				++_capacityWaiters;
+				{
+					std::unique_lock<std::mutex> lockCapacity(_capacityMutex);
+					for (;;) {
+						result = ReserveCapacity(task);
+						if (result == ADD_OK) {
+							break;
+						}
+						if (_isShuttingDown) {
+							result = ADD_NOT_RUNNING;
+							break;
+						}
+						if (_capacityCondition.wait_until(lockCapacity, until) == std::cv_status::timeout) {
+							result = (ReserveCapacity(task) == ADD_OK) ? ADD_OK : ADD_TIMED_OUT;
+							break;
+						}
+					}
+				}
+				--_capacityWaiters;
+				return result;
+			}
+
+			default:
+				return ADD_FULL;
+		}
+	}
+	void TasksQueue::ReleaseCapacity(Task* task) {
+		if (task->_queuedBytes > 0) {
+			_bytes -= static_cast<int64_t>(task->_queuedBytes);
+		}
+		if (_capacity.maxTasks == 0) {
+			--Stats().total;
+		} else {
+			--_total;
+		}
+
+		if (_capacityWaiters.load() > 0) {
+			{
+				std::lock_guard<std::mutex> lockCapacity(_capacityMutex);
+			}
+			_capacityCondition.notify_all();
+		}
+	}
+	bool TasksQueue::DropOldestTask() {
+		TaskPtr task;
+		{
+			std::lock_guard<std::mutex> lockTasks(_tasksMutex);
+			task = _tasks.TakeOldest();
+		}
+		if (!task) {
+			return false;
+		}
+
+		DropTask(task, Stats().overflowDropped);
+		return true;
+	}
+
+	bool TasksQueue::AddLocalTask(const TaskPtr& task) {
+		WorkerContext& worker = t_worker;
+		const TaskOptions& options = task->_options;
+
+		if ((worker.queue != this) || (worker.current != task.get()) || worker.next || _isShuttingDown) {
+			return false;
+		}
+		if ((options.affinity == AFFINITY_NONE) || (worker.localRuns >= MAX_LOCAL_RUNS)) {
+			return false;
+		}
+		if ((options.suspendTime > std::chrono::milliseconds(0)) || options.isMainThread || (options.isBlocking && worker.ignoreBlocking)) {
+			return false;
+		}
+		if (options.rateClass.value != 0) {
+			return false;			// It needs a token like any other
+		}
+		if ((options.affinity == AFFINITY_AUTO) && !_tasks.IsEmpty()) {
+			return false;			// Others are waiting for a worker, it shouldn't jump ahead of them
+		}
+		if ((_tasks.GetPolicy() == POLICY_PRIORITY) && (options.priority < _runningPriority)) {
+			return false;
+		}
+
+		IndexCancelTag(task);
+		if (!task->Transition_(TASK_WORKING, TASK_IN_QUEUE)) {
+			return false;
+		}
+		if ((options.priority > _runningPriority) && (_tasks.GetPolicy() == POLICY_PRIORITY)) {
+			_runningPriority = options.priority;
+		}
+
+		worker.next = task;
+		++worker.localRuns;
+		TasksObserver::OnEnqueue(this, *task);
 		return true;
 	}
 
+	void TasksQueue::NotifyTasks() {
+		// The task was pushed under tasksMutex - a waiter that has registered before it looked for a task and
+		// missed this one is seen here
+		if (_numGroupWaiters.load(std::memory_order_acquire) > 0) {
+			WakeGroupWaiters();
+		}
+
+		if (_pool) {
+			_pool->NotifyTasks(this);
+		} else {
+			_tasksCondition.notify_all();
+			if (_isWorkerTimers) {
+				_timerCondition.notify_one();		// The leader is idle as well
+			}
+		}
+	}
+	void TasksQueue::WakeGroupWaiters() {
+		std::lock_guard<std::mutex> lock(_groupWaitersMutex);
+
+		for (TaskGroupState* state : _groupWaiters) {
+			std::lock_guard<std::mutex> lockWait(state->_waitMutex);
+			state->_wakeups.fetch_add(1, std::memory_order_relaxed);
+			state->_waitCondition.notify_all();
+		}
+	}
+	bool TasksQueue::HoldForRate(const TaskPtr& task, const TaskStatus from, bool& isHeld) {
+		isHeld = false;
+		if (task->_hasRateToken) {
+			task->_hasRateToken = false;		// Released by the rate limit with a token already taken for it
+			return true;
+		}
+
+		bool isEarliest;
+		{
+			std::lock_guard<std::mutex> lockSched(_schedulerMutex);
+
+			auto limitIt = _rateLimits.find(task->_options.rateClass.value);
+			if (limitIt == _rateLimits.end()) {
+				return true;
+			}
+			RateLimit& limit = limitIt->second;
+
+			// Tasks already waiting for a token get the next ones
+			limit.Refill(scheduleClock::now());
+			if (limit.held.empty() && (limit.tokens >= 1.0)) {
+				limit.tokens -= 1.0;
+				return true;
+			}
+
+			if (!task->Transition_(from, TASK_SUSPENDED)) {
+				return false;
+			}
+			task->_rateHeldIt = limit.held.insert(limit.held.end(), task);
+			task->_isRateHeld = true;
+			TasksTracer::Record(TRACE_SUSPEND, task.get());
+			++Stats().throttled;
+			++Stats().waiting;
+			isEarliest = AdvanceScheduleEarliest(limit.NextToken());
+		}
+
+		TasksObserver::OnSuspend(this, *task);
+		if (isEarliest) {
+			NotifySchedule();
+		}
+		isHeld = true;
+		return true;
+	}
+	bool TasksQueue::AdvanceScheduleEarliest(const scheduleTimePoint wakeTime) {
+		// The scheduling thread only needs to hear about it if it is due before whatever it is waiting for
+		if (wakeTime >= _scheduleEarliest.load()) {
+			return false;
+		}
+		_scheduleEarliest = wakeTime;
+		return true;
+	}
+	void TasksQueue::NotifySchedule() {
+		if (_pool) {
+			_pool->NotifySchedule();
+		} else if (_isWorkerTimers) {
+			{
+				// The leader reads the earliest time under the lock, so it either sees the new one or is asleep already
+				std::lock_guard<std::mutex> lockTasks(_tasksMutex);
+			}
+			_timerCondition.notify_one();
+		} else {
+			_scheduleCondition.notify_one();
+		}
+	}
+
+	TasksQueue::StatsCounters& TasksQueue::Stats() {
+		return _statsShards[t_workerId % STATS_SHARDS].counters;
+	}
+
 	void TasksQueue::ThreadExecuteTasks(const bool ignoreBlocking) {
+		IdleState idle(_idleStrategies[ignoreBlocking]);
+
 		for (;;) {
 			TaskPtr task = nullptr;
+			TasksReadyQueue::PostedCall posted;
 			{
 				std::unique_lock<std::mutex> lockTasks(_tasksMutex);
 
-                _tasksCondition.wait(lockTasks, [this]{ return (_isShuttingDown || (!_tasks.empty())); });
+				if (WaitForWork(lockTasks, idle)) {
+					lockTasks.unlock();
+					ExpireScheduledTasks();			// The resumed tasks are ready by the time this thread looks for one
+					continue;
+				}
 				if (_isShuttingDown) {
 					break;
 				}
 
-				for (auto it = _tasks.begin(); it < _tasks.end(); ++it) {
-					task = *it;
-					if (task) {
-						std::lock_guard<std::mutex> lockTask(task->GetTaskMutex_());
-						if ((task->GetOptions().isBlocking && ignoreBlocking)
-							|| (task->GetOptions().priority < _runningPriority)
-							)
-						{
-							task = nullptr;
-						}
-						else {
-							_tasks.erase(it);
-							break;
-						}
-					}
-				}
+				idle.End();
+				task = TakeTask(ignoreBlocking, posted);
 			}
 
 			if (task) {
-				task->Execute(this, task);
-				RescheduleTask(task);
+				RunWorkerTask(std::move(task), ignoreBlocking);
+			} else if (posted.executable) {
+				RunPostedCall(posted, ignoreBlocking);
 			}
 		}
 	}
+	bool TasksQueue::WaitForWork(std::unique_lock<std::mutex>& lockTasks, IdleState& idle) {
+		if (!_isShuttingDown && _tasks.IsEmpty()) {
+			if (idle.idleSince == scheduleTimePoint::min()) {
+				idle.Begin();
+			}
+			SpinForWork(lockTasks, idle);
+		}
+
+		while (!_isShuttingDown && _tasks.IsEmpty()) {
+			if (!_isWorkerTimers || _hasTimerLeader) {
+				_tasksCondition.wait(lockTasks);
+				continue;
+			}
+
+			const scheduleTimePoint earliest = _scheduleEarliest.load();
+			if (earliest <= scheduleClock::now()) {
+				return true;
+			}
+
+			_hasTimerLeader = true;
+			if (earliest == scheduleTimePoint::max()) {
+				_timerCondition.wait(lockTasks);
+			} else {
+				_timerCondition.wait_until(lockTasks, earliest);
+			}
+			_hasTimerLeader = false;
+
+			// Off to execute a task, whoever is idle next takes over the timers
+			if (!_tasks.IsEmpty()) {
+				_tasksCondition.notify_one();
+			}
+		}
+		return false;
+	}
 	void TasksQueue::ThreadExecuteScheduledTasks() {
 		for (;;) {
-			std::vector<TaskPtr> runTasks;
-
 			{
 				std::unique_lock<std::mutex> lockSched(_schedulerMutex);
 
-                _scheduleCondition.wait(lockSched, [this]{
-                    return _isShuttingDown || (scheduleClock::now() >= _scheduleEarliest.load());
-                });
+				// Wakes up for the earliest timer on its own, a new earlier one notifies
+				auto isDue = [this]{
+					return _isShuttingDown || (scheduleClock::now() >= _scheduleEarliest.load());
+				};
+				while (!isDue()) {
+					const scheduleTimePoint earliest = _scheduleEarliest.load();
+					if (earliest == scheduleTimePoint::max()) {
+						_scheduleCondition.wait(lockSched);
+					} else {
+						_scheduleCondition.wait_until(lockSched, earliest);
+					}
+				}
 				if (_isShuttingDown) {
 					break;
 				}
+			}
+
+			ExpireScheduledTasks();
+		}
+	}
+
+	void TasksQueue::SpinForWork(std::unique_lock<std::mutex>& lockTasks, IdleState& idle) {
+		const scheduleDuration pollTime = idle.GetPollTime();
+		if (pollTime.count() == 0) {
+			return;
+		}
 
-				auto now = scheduleClock::now();
-				auto it = _scheduledTasks.begin();
-				while ((it != _scheduledTasks.end()) && (it->first < now)) {
-					auto task = it->second;
-					std::unique_lock<std::mutex> lockTask(task->GetTaskMutex_());
-					task->_options.suspendTime = TaskDelay{0 };
-					runTasks.push_back(task);
-					it = _scheduledTasks.erase(it);
+		// Tasks are pushed under the lock, so whatever comes after this changes the count
+		const uint64_t pushed = _tasksPushed.load(std::memory_order_relaxed);
+		lockTasks.unlock();
+
+		// Spinning first, as much of the poll time as the strategy's spin takes
+		const scheduleTimePoint start = scheduleClock::now();
+		const scheduleTimePoint spinUntil = start + std::min<scheduleDuration>(pollTime, idle.strategy.spin);
+		const scheduleTimePoint yieldUntil = start + pollTime;
+		for (scheduleTimePoint now = start; now < yieldUntil; now = scheduleClock::now()) {
+			if ((_tasksPushed.load(std::memory_order_relaxed) != pushed) || _isShuttingDown) {
+				break;
+			}
+			if (_isWorkerTimers && (_scheduleEarliest.load() <= now)) {
+				break;
+			}
+
+			if (now < spinUntil) {
+				for (int i = 0; i < IDLE_SPIN_PAUSES; ++i) {
+					CpuRelax();
 				}
+			} else {
+				std::this_thread::yield();
+			}
+		}
+
+		lockTasks.lock();
+	}
+
+	TaskPtr TasksQueue::TakeTask(const bool ignoreBlocking, TasksReadyQueue::PostedCall& posted) {
+		std::vector<TaskPtr> dropped;
+		bool missedDeadline;
+
+		for (;;) {
+			TaskPtr task = _tasks.Take(ignoreBlocking, _runningPriority, dropped, missedDeadline, posted);
+
+			for (const TaskPtr& droppedTask : dropped) {
+				DropTask(droppedTask, Stats().deadlineDropped);
+			}
+			dropped.clear();
+
+			if (!task) {
+				return nullptr;
+			}
+
+			if (!task->Start_()) {
+				continue;			// Cancel() got to it first
+			}
+
+			if (missedDeadline) {
+				++Stats().deadlineMissed;
+			}
+			return task;
+		}
+	}
+	void TasksQueue::DropTask(const TaskPtr& task, std::atomic<std::int64_t>& reason) {
+		if (!task->Transition_(TASK_IN_QUEUE, TASK_CANCELLED)) {
+			return;					// Cancel() got to it first
+		}
+
+		task->_isCancelled = true;
+		task->ReleaseExecutables_();
+		UnindexCancelTag(task.get());
+		UnindexDedupKey(task.get());
+
+		ReleaseCapacity(task.get());
+		++reason;
+		TasksObserver::OnCancel(this, *task);
+		task->LeaveGroup_();
+	}
+	bool TasksQueue::ExecuteTask(const bool ignoreBlocking) {
+		TaskPtr task = nullptr;
+		TasksReadyQueue::PostedCall posted;
+		{
+			std::lock_guard<std::mutex> lockTasks(_tasksMutex);
+			if (_isShuttingDown) {
+				return false;
+			}
+
+			task = TakeTask(ignoreBlocking, posted);
+		}
+
+		if (task) {
+			RunWorkerTask(std::move(task), ignoreBlocking);
+		} else if (posted.executable) {
+			RunPostedCall(posted, ignoreBlocking);
+		} else {
+			return false;
+		}
+		return true;
+	}
+	bool TasksQueue::WaitForGroup(TaskGroupState& state, const scheduleTimePoint deadline) {
+		// Executes what the calling thread would - inside a task on a non-blocking worker that is no blocking tasks
+		const bool ignoreBlocking = t_worker.ignoreBlocking;
+		{
+			std::lock_guard<std::mutex> lock(_groupWaitersMutex);
+			_groupWaiters.push_back(&state);
+			_numGroupWaiters.fetch_add(1, std::memory_order_release);
+		}
+
+		while (state._pending.load(std::memory_order_acquire) > 0) {
+			// Read before looking for a task, a task queued after that bumps it
+			const uint64_t wakeups = state._wakeups.load(std::memory_order_acquire);
+			if (ExecuteTask(ignoreBlocking)) {
+				continue;
+			}
+
+			// Nothing to help with - sleep until the group finishes or a task comes
+			std::unique_lock<std::mutex> lock(state._waitMutex);
+			auto wakeUp = [&state, wakeups] {
+				return (state._pending.load(std::memory_order_acquire) == 0) || (state._wakeups.load(std::memory_order_relaxed) != wakeups);
+			};
+			if (deadline == scheduleTimePoint::max()) {
+				state._waitCondition.wait(lock, wakeUp);
+			} else if (!state._waitCondition.wait_until(lock, deadline, wakeUp)) {
+				break;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_groupWaitersMutex);
+			_groupWaiters.erase(std::find(_groupWaiters.begin(), _groupWaiters.end(), &state));
+			_numGroupWaiters.fetch_sub(1, std::memory_order_relaxed);
+		}
+		return state._pending.load(std::memory_order_acquire) == 0;
+	}
+	scheduleTimePoint TasksQueue::ExpireScheduledTasks() {
+		std::vector<TaskPtr> runTasks;
+		std::vector<TaskPtr> releasedTasks;
+		scheduleTimePoint earliest;
+
+		{
+			std::lock_guard<std::mutex> lockSched(_schedulerMutex);
+
+			auto now = scheduleClock::now();
+			auto it = _scheduledTasks.begin();
+			while ((it != _scheduledTasks.end()) && (it->first < now)) {
+				scheduleMap::node_type node = _scheduledTasks.extract(it++);
+				Task* task = node.mapped().get();
+				task->_isScheduled = false;
+				runTasks.push_back(std::move(node.mapped()));
+				task->_scheduleNode = std::move(node);			// Without the pointer to the task, it would keep itself alive
+				--Stats().waiting;
+			}
+
+			earliest = (it != _scheduledTasks.end()) ? it->first : scheduleTimePoint::max();
 
-                _scheduleEarliest = (it != _scheduledTasks.end()) ? it->first : scheduleTimePoint::max();
+			for (auto& [rateClass, limit] : _rateLimits) {
+				if (limit.held.empty()) {
+					continue;
+				}
+				limit.Refill(now);
+				while (!limit.held.empty() && (limit.tokens >= 1.0)) {
+					limit.tokens -= 1.0;
+					TaskPtr task = std::move(limit.held.front());
+					limit.held.pop_front();
+					task->_isRateHeld = false;
+					task->_hasRateToken = true;
+					releasedTasks.push_back(std::move(task));
+					--Stats().waiting;
+				}
+				if (!limit.held.empty()) {
+					earliest = std::min(earliest, limit.NextToken());
+				}
 			}
+            _scheduleEarliest = earliest;
+		}
 
-			while (!runTasks.empty()) {
-				auto task = runTasks.back();
-				++_stats.resumed;
-				--_stats.waiting;
-				
-				std::unique_lock<std::mutex> lock(task->GetTaskMutex_());
-				AddTask(task, std::move(lock), false);
+		// Cancel() may have taken a task before it is resumed, then it's just dropped here
+		for (const TaskPtr& task : runTasks) {
+			if (task->_isCancelled) {
+				continue;
+			}
 
-				runTasks.pop_back();
+			++Stats().resumed;
+			TasksTracer::Record(TRACE_RESUME, task.get());
+			TasksObserver::OnResume(this, *task);
+			task->_options.suspendTime = TaskDelay{0 };
+			if (!AddTask(task, TASK_SUSPENDED)) {
+				--Stats().resumed;
 			}
 		}
+		for (const TaskPtr& task : releasedTasks) {
+			TasksTracer::Record(TRACE_RESUME, task.get());
+			TasksObserver::OnResume(this, *task);
+			AddTask(task, TASK_SUSPENDED);
+		}
+
+		return earliest;
 	}
 	
+	void TasksQueue::RunWorkerTask(TaskPtr task, const bool ignoreBlocking) {
+		// A task may run another queue's tasks (or this one's) from inside, the outer context comes back afterwards
+		WorkerContext outer = std::move(t_worker);
+		t_worker = WorkerContext{};
+		t_worker.queue = this;
+		t_worker.ignoreBlocking = ignoreBlocking;
+
+		bool isLocal = false;
+		while (task) {
+			if (isLocal) {
+				++Stats().executedLocal;
+			} else if ((task->_lastWorker != 0) && (task->_lastWorker != t_workerId)) {
+				++Stats().executedMigrated;
+			}
+			task->_lastWorker = t_workerId;
+
+			t_worker.current = task.get();
+			TasksObserver::OnDequeue(this, *task);
+			task->Execute(this, task);
+			RescheduleTask(task);
+			t_worker.current = nullptr;
+
+			// Cancel() may have taken it out of the slot, then it has also accounted for it
+			task = std::move(t_worker.next);
+			t_worker.next = nullptr;
+			if (task && !task->Start_()) {
+				task = nullptr;
+			}
+			isLocal = true;
+		}
+
+		t_worker = std::move(outer);
+	}
+	void TasksQueue::RunPostedCall(TasksReadyQueue::PostedCall& posted, const bool ignoreBlocking) {
+		WorkerContext outer = std::move(t_worker);
+		t_worker = WorkerContext{};
+		t_worker.queue = this;
+		t_worker.ignoreBlocking = ignoreBlocking;
+
+		posted.executable(this);
+		posted.executable = nullptr;			// Whatever it captured goes before it counts as completed
+		t_worker = std::move(outer);
+
+		++Stats().completed;
+		if (posted.priority > 0) {
+			_runningPriority = 0;
+			if (_pool) {
+				_pool->NotifyTasks(this);
+			}
+		}
+		--Stats().total;
+	}
 	void TasksQueue::RescheduleTask(const std::shared_ptr<Task>& task) {
-		std::unique_lock<std::mutex> lockTaskData(task->GetTaskMutex_());
-		if (task->_doReschedule) {
+		const bool doPark = (task->_parkState.load(std::memory_order_acquire) != PARK_NONE);
+
+		// Acquiring _doReschedule makes the options written by Task::Reschedule() visible
+		if (task->_doReschedule.load(std::memory_order_acquire) && !task->_isCancelled) {
+			TasksTracer::Record(TRACE_RESCHEDULE, task.get());
 			task->ApplyReschedule_();
-			AddTask(task, std::move(lockTaskData), false);
+			TasksObserver::OnReschedule(this, *task);
+			if (doPark ? ParkTask(task) : (AddLocalTask(task) || AddTask(task, TASK_WORKING))) {
+				return;
+			}
+		} else if (doPark && !task->_isCancelled) {
+			if (ParkTask(task)) {
+				return;
+			}
+		} else if ((task->_options.period.interval > TaskDelay{ 0 }) && !task->_isCancelled) {
+			TasksTracer::Record(TRACE_RESCHEDULE, task.get());
+			TasksObserver::OnReschedule(this, *task);
+			if (RearmTask(task)) {
+				return;
+			}
+		}
+
+		// Finished, unless Cancel() has moved it on while it was executing. The group is taken before the task is
+		// TASK_FINISHED, as it may be added again - to another group as well - right after.
+		task->_parkState.store(PARK_NONE, std::memory_order_relaxed);
+		const std::shared_ptr<TaskGroupState> group = std::move(task->_group);
+		task->_group = nullptr;
+		const bool finished = task->Transition_(TASK_WORKING, TASK_FINISHED);
+		UnindexCancelTag(task.get());
+		UnindexDedupKey(task.get());
+		if (!finished) {
+			task->_isCancelled = true;
+			task->ReleaseExecutables_();
+			++Stats().cancelled;
+			TasksObserver::OnCancel(this, *task);
 		} else {
-			if (task->_options.priority > 0) {
-                _runningPriority = 0;
+			++Stats().completed;
+			TasksObserver::OnComplete(this, *task);
+		}
+
+		if (task->_options.priority > 0) {
+			_runningPriority = 0;
+			if (_pool) {
+				// Tasks that were ignored because of the priority are eligible again
+				_pool->NotifyTasks(this);
 			}
-			--_stats.total;
-			++_stats.completed;
 		}
+		ReleaseCapacity(task.get());
+		if (group) {
+			group->Release();
+		}
+	}
+
+	bool TasksQueue::ParkTask(const TaskPtr& task) {
+		if (!task->Transition_(TASK_WORKING, TASK_SUSPENDED)) {
+			return false;			// Cancel() got to it while it was executing
+		}
+		TasksTracer::Record(TRACE_SUSPEND, task.get());
+		++Stats().suspended;
+		++Stats().waiting;
+		TasksObserver::OnSuspend(this, *task);
+
+		// From here on Unpark() or Cancel() may take it
+		uint8_t requested = PARK_REQUESTED;
+		if (task->_parkState.compare_exchange_strong(requested, PARK_PARKED, std::memory_order_acq_rel, std::memory_order_acquire)) {
+			return true;
+		}
+		task->_parkState.store(PARK_NONE, std::memory_order_relaxed);
+		ResumeParkedTask(task);
+		return true;
+	}
+	void TasksQueue::ResumeParkedTask(const TaskPtr& task) {
+		--Stats().waiting;
+		++Stats().resumed;
+		TasksTracer::Record(TRACE_RESUME, task.get());
+		TasksObserver::OnResume(this, *task);
+		task->_options.suspendTime = TaskDelay{ 0 };		// Waiting for Unpark() was the delay
+		if (!AddTask(task, TASK_SUSPENDED)) {
+			--Stats().resumed;			// Cancel() has taken it and done the rest
+		}
+	}
+	bool TasksQueue::RearmTask(const TaskPtr& task) {
+		const TaskPeriod& period = task->_options.period;
+		const scheduleTimePoint now = scheduleClock::now();
+
+		// Fixed rate counts from when the run was due rather than when it ran, so neither the execution nor the timer's
+		// latency add up over the periods
+		scheduleTimePoint due;
+		if (period.mode == PERIOD_FIXED_DELAY) {
+			due = now + period.interval;
+		} else {
+			due = task->_periodDue + period.interval;
+			if ((due <= now) && (period.overrun == OVERRUN_SKIP)) {
+				const auto missed = (now - due) / period.interval + 1;
+				due += period.interval * missed;
+				Stats().periodsSkipped += static_cast<int64_t>(missed);
+			}
+		}
+		task->_periodDue = due;
+
+		if (due <= now) {
+			// Behind schedule, the next run is due already
+			return AddLocalTask(task) || AddTask(task, TASK_WORKING);
+		}
+		return AddTask(task, TASK_WORKING, due);
+	}
+
+	void TasksQueue::IndexCancelTag(const TaskPtr& task) {
+		const uint64_t tag = task->_options.cancelTag.value;
+		if (tag == task->_indexedTag) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(_cancelMutex);
+		if (task->_indexedTag != 0) {
+			auto tagIt = _cancelTags.find(task->_indexedTag);
+			tagIt->second.erase(task->_indexedTagIt);
+			if (tagIt->second.empty()) {
+				_cancelTags.erase(tagIt);
+			}
+		}
+		if (tag != 0) {
+			cancelTagList& list = _cancelTags[tag];
+			task->_indexedTagIt = list.insert(list.end(), task);
+		}
+		task->_indexedTag = tag;
+	}
+	void TasksQueue::UnindexCancelTag(Task* task) {
+		if (task->_indexedTag == 0) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(_cancelMutex);
+		auto tagIt = _cancelTags.find(task->_indexedTag);
+		tagIt->second.erase(task->_indexedTagIt);
+		if (tagIt->second.empty()) {
+			_cancelTags.erase(tagIt);
+		}
+		task->_indexedTag = 0;
+	}
+
+	TaskAddResult TasksQueue::MergeDuplicate(const TaskPtr& task, const TaskStatus status) {
+		if (IsPending(status)) {
+			return ADD_INVALID;				// In the queue already, the duplicate of itself
+		}
+
+		const TaskDedupKey key = task->_options.dedupKey;
+		TaskPtr pending;
+		bool isPendingAdding = false;
+		{
+			std::lock_guard<std::mutex> lock(_cancelMutex);
+
+			// A task another thread is still adding counts as pending, it is about to be
+			TaskWeakPtr& indexed = _dedupKeys[key.value];
+			pending = indexed.lock();
+			if (pending) {
+				isPendingAdding = pending->_isDedupAdding;
+				if (!isPendingAdding && !IsPending(pending->_status.load(std::memory_order_acquire))) {
+					pending.reset();			// Executing or done, the new task has to run after it
+				}
+			}
+
+			if (!pending || (key.policy == DEDUP_REPLACE)) {
+				if (TaskPtr previous = indexed.lock()) {
+					previous->_indexedDedupKey.store(0, std::memory_order_relaxed);
+				}
+				const uint64_t previousKey = task->_indexedDedupKey.load(std::memory_order_relaxed);
+				if ((previousKey != 0) && (previousKey != key.value)) {
+					_dedupKeys.erase(previousKey);
+				}
+				indexed = task;
+				task->_indexedDedupKey.store(key.value, std::memory_order_relaxed);
+				task->_isDedupAdding = true;
+				task->_isDedupReplaced = false;
+			}
+			if (isPendingAdding && (key.policy == DEDUP_REPLACE)) {
+				pending->_isDedupReplaced = true;		// Not queued yet, so it can't be cancelled - its adder does it
+			}
+		}
+
+		if (!pending) {
+			return ADD_OK;
+		}
+		if (key.policy == DEDUP_REPLACE) {
+			if (!isPendingAdding && Cancel(pending)) {
+				++Stats().deduplicated;
+			}
+			return ADD_OK;
+		}
+
+		if ((key.policy == DEDUP_DEBOUNCE) && (task->_options.suspendTime > TaskDelay{ 0 })) {
+			// Only ever later, the timer's thread finds nothing due when it wakes up for the old time and goes back to sleep
+			const scheduleTimePoint wakeTime = scheduleClock::now() + task->_options.suspendTime;
+
+			std::lock_guard<std::mutex> lockSched(_schedulerMutex);
+			if (pending->_isScheduled && (pending->_scheduleIt->first < wakeTime)) {
+				scheduleMap::node_type node = _scheduledTasks.extract(pending->_scheduleIt);
+				node.key() = wakeTime;
+				pending->_scheduleIt = _scheduledTasks.insert(std::move(node));
+			}
+		}
+		++Stats().deduplicated;
+		return ADD_MERGED;
+	}
+	void TasksQueue::UnindexDedupKey(Task* task) {
+		if (task->_indexedDedupKey.load(std::memory_order_relaxed) == 0) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(_cancelMutex);
+		const uint64_t key = task->_indexedDedupKey.load(std::memory_order_relaxed);
+		if (key != 0) {
+			_dedupKeys.erase(key);
+			task->_indexedDedupKey.store(0, std::memory_order_relaxed);
+		}
+	}
+	void TasksQueue::EndDedupAdd(const TaskPtr& task) {
+		bool isReplaced;
+		{
+			std::lock_guard<std::mutex> lock(_cancelMutex);
+			task->_isDedupAdding = false;
+			isReplaced = task->_isDedupReplaced;
+			task->_isDedupReplaced = false;
+		}
+
+		// A failed add leaves nothing to cancel
+		if (isReplaced && Cancel(task)) {
+			++Stats().deduplicated;
+		}
+	}
+	bool TasksQueue::IsPending(const TaskStatus status) {
+		return (status == TASK_SUSPENDED) || (status == TASK_IN_QUEUE) || (status == TASK_IN_QUEUE_MAIN_THREAD);
+	}
+
+	// ===== TasksQueue::RateLimit ======================================================
+	void TasksQueue::RateLimit::Refill(const scheduleTimePoint now) {
+		if (now <= refilled) {
+			return;
+		}
+		tokens = std::min(burst, tokens + tokensPerSecond * std::chrono::duration<double>(now - refilled).count());
+		refilled = now;
+	}
+	scheduleTimePoint TasksQueue::RateLimit::NextToken() const {
+		if (tokens >= 1.0) {
+			return refilled;
+		}
+		return refilled + std::chrono::ceil<scheduleDuration>(std::chrono::duration<double>((1.0 - tokens) / tokensPerSecond));
 	}
 
 }
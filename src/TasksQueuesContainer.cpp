@@ -2,40 +2,160 @@
 
 namespace TasksLib {
 
-	TasksQueuesContainer::TasksQueuesContainer() = default;
+	TasksQueuesContainer::Table::Table(const size_t queuesCapacity)
+		: capacity(queuesCapacity)
+		, queues(new std::atomic<TasksQueue*>[queuesCapacity])
+		, names(new std::atomic<const QueueName*>[queuesCapacity * 2])
+	{
+		for (size_t i = 0; i < queuesCapacity; ++i) {
+			queues[i].store(nullptr, std::memory_order_relaxed);
+		}
+		for (size_t i = 0; i < queuesCapacity * 2; ++i) {
+			names[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	TasksQueuesContainer::TasksQueuesContainer()
+		: table_(nullptr)
+		, count_(0)
+	{
+		tables_.push_back(std::make_unique<Table>(INITIAL_TABLE_CAPACITY));
+		table_.store(tables_.back().get(), std::memory_order_release);
+	}
+	TasksQueuesContainer::TasksQueuesContainer(const TasksQueue::Configuration& sharedPoolConfiguration)
+		: TasksQueuesContainer()
+	{
+		pool_ = std::make_unique<TasksWorkerPool>(sharedPoolConfiguration);
+	}
 	TasksQueuesContainer::~TasksQueuesContainer() {
-		for (auto& it : queueMap_) {
-            it.second.Cleanup();
+		// The pool's threads run the lanes' tasks, they have to stop first
+		if (pool_) {
+			pool_->Cleanup();
+		}
+		for (auto& queue : queues_) {
+			queue->Cleanup();
 		}
 	}
 
-	TasksQueue* TasksQueuesContainer::GetQueue(const std::string& queueName) {
-		auto queueIt = queueMap_.find(queueName);
-		if (queueIt == queueMap_.end()) {
+	TasksQueue* TasksQueuesContainer::GetQueue(const std::string& queueName) const {
+		const Table* table = table_.load(std::memory_order_acquire);
+
+		// A name is inserted after its queue's slot, in every table that has it
+		const QueueName* name = FindName(*table, queueName);
+		if (!name) {
+			return nullptr;
+		}
+
+		return table->queues[name->handle].load(std::memory_order_acquire);
+	}
+    [[maybe_unused]] TasksQueue* TasksQueuesContainer::GetQueue(const TasksQueueHandle handle) const {
+		// The count is read first - the table that has the handle's slot was published before the count included it
+		if (handle >= count_.load(std::memory_order_acquire)) {
 			return nullptr;
 		}
 
-		return &(queueIt->second);
+		return table_.load(std::memory_order_acquire)->queues[handle].load(std::memory_order_acquire);
 	}
+    [[maybe_unused]] TasksQueueHandle TasksQueuesContainer::GetQueueHandle(const std::string& queueName) const {
+		const QueueName* name = FindName(*table_.load(std::memory_order_acquire), queueName);
+		if (!name) {
+			return INVALID_QUEUE_HANDLE;
+		}
 
-    [[maybe_unused]] void TasksQueuesContainer::CreateQueue(const std::string& queueName, const TasksQueue::Configuration& configuration) {
-		auto queueIt = queueMap_.find(queueName);
-		if (queueIt != queueMap_.end()) {
-			return;
+		return name->handle;
+	}
+
+    [[maybe_unused]] TasksQueueHandle TasksQueuesContainer::CreateQueue(const std::string& queueName, const TasksQueue::Configuration& configuration) {
+		return AddQueue(queueName, &configuration, nullptr);
+	}
+    [[maybe_unused]] TasksQueueHandle TasksQueuesContainer::CreateLane(const std::string& queueName, const TasksWorkerPool::LaneConfiguration& configuration) {
+		if (!pool_) {
+			return INVALID_QUEUE_HANDLE;
 		}
 
-		auto pair = queueMap_.emplace(std::piecewise_construct, std::forward_as_tuple(queueName), std::forward_as_tuple());
-		queueIt = pair.first;
-		queueIt->second.Initialize(configuration);
+		return AddQueue(queueName, nullptr, &configuration);
+	}
+    [[maybe_unused]] TasksWorkerPool* TasksQueuesContainer::GetSharedPool() const {
+		return pool_.get();
 	}
 
     [[maybe_unused]] size_t TasksQueuesContainer::GetQueuesCount() const {
-		return queueMap_.size();
+		return count_.load(std::memory_order_acquire);
+	}
+
+	TasksQueueHandle TasksQueuesContainer::AddQueue(const std::string& queueName, const TasksQueue::Configuration* configuration,
+													const TasksWorkerPool::LaneConfiguration* laneConfiguration) {
+		std::lock_guard<std::mutex> lock(createMutex_);
+
+		Table* table = tables_.back().get();
+		if (const QueueName* name = FindName(*table, queueName)) {
+			return name->handle;
+		}
+
+		// Initialize before publishing, so nobody gets to see a queue that doesn't accept tasks yet
+		queues_.push_back(std::make_unique<TasksQueue>());
+		TasksQueue* queue = queues_.back().get();
+		if (laneConfiguration) {
+			pool_->AttachQueue(queue, *laneConfiguration);
+		} else {
+			queue->Initialize(*configuration);
+		}
+
+		const size_t count = count_.load(std::memory_order_relaxed);
+		if (count == table->capacity) {
+			auto next = std::make_unique<Table>(table->capacity * 2);
+			for (size_t i = 0; i < count; ++i) {
+				next->queues[i].store(table->queues[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+			for (const auto& name : names_) {
+				InsertName(*next, name.get());
+			}
+
+			tables_.push_back(std::move(next));
+			table = tables_.back().get();
+			table_.store(table, std::memory_order_release);
+		}
+
+		// The slot, then the count, then the name - whoever finds the name finds the queue by its handle as well
+		auto handle = static_cast<TasksQueueHandle>(count);
+		table->queues[count].store(queue, std::memory_order_release);
+		count_.store(count + 1, std::memory_order_release);
+		names_.push_back(std::make_unique<const QueueName>(QueueName{ queueName, handle }));
+		InsertName(*table, names_.back().get());
+
+		return handle;
+	}
+
+	const TasksQueuesContainer::QueueName* TasksQueuesContainer::FindName(const Table& table, const std::string& queueName) {
+		const size_t mask = table.capacity * 2 - 1;
+
+		// Never more than half of the slots are taken, there is always an empty one to stop at
+		for (size_t i = std::hash<std::string>{}(queueName) & mask; ; i = (i + 1) & mask) {
+			const QueueName* name = table.names[i].load(std::memory_order_acquire);
+			if (!name) {
+				return nullptr;
+			}
+			if (name->name == queueName) {
+				return name;
+			}
+		}
+	}
+	void TasksQueuesContainer::InsertName(Table& table, const QueueName* name) {
+		const size_t mask = table.capacity * 2 - 1;
+
+		size_t i = std::hash<std::string>{}(name->name) & mask;
+		while (table.names[i].load(std::memory_order_relaxed)) {
+			i = (i + 1) & mask;
+		}
+		table.names[i].store(name, std::memory_order_release);
 	}
 
     [[maybe_unused]] void TasksQueuesContainer::Update() {
-		for (auto& it : queueMap_) {
-			it.second.Update();
+		const size_t count = count_.load(std::memory_order_acquire);
+		const Table* table = table_.load(std::memory_order_acquire);
+
+		for (size_t i = 0; i < count; ++i) {
+			table->queues[i].load(std::memory_order_acquire)->Update();
 		}
 	}
 }
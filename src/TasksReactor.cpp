@@ -0,0 +1,241 @@
+#include <vector>
+#include <utility>
+#include <algorithm>
+#if defined(__linux__)
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TasksReactor.h"
+
+#define REACTOR_MAX_EVENTS		64		// Events taken from epoll at once
+
+#if defined(__linux__)
+namespace {
+
+	using namespace TasksLib;
+
+	uint32_t ToEpoll(const uint32_t events) {
+		return ((events & IO_READ) ? static_cast<uint32_t>(EPOLLIN) : 0u)
+			| ((events & IO_WRITE) ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+	}
+	uint32_t FromEpoll(const uint32_t events) {
+		return ((events & EPOLLIN) ? static_cast<uint32_t>(IO_READ) : 0u)
+			| ((events & EPOLLOUT) ? static_cast<uint32_t>(IO_WRITE) : 0u)
+			| ((events & EPOLLERR) ? static_cast<uint32_t>(IO_ERROR) : 0u)
+			| ((events & (EPOLLHUP | EPOLLRDHUP)) ? static_cast<uint32_t>(IO_HANGUP) : 0u);
+	}
+
+}
+#endif
+
+namespace TasksLib {
+
+	// ===== TasksReactor ===============================================================
+	TasksReactor::TasksReactor(TasksQueue* queue)
+		: _queue(queue)
+		, _epoll(-1)
+		, _wakeFd(-1)
+		, _isStopping(false)
+	{
+#if defined(__linux__)
+		_epoll = epoll_create1(EPOLL_CLOEXEC);
+		_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if ((_epoll < 0) || (_wakeFd < 0)) {
+			return;
+		}
+
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = _wakeFd;
+		if (epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakeFd, &event) == 0) {
+			_thread = std::thread(&TasksReactor::ThreadReact, this);
+		}
+#endif
+	}
+	TasksReactor::~TasksReactor() {
+		_isStopping = true;
+		if (_thread.joinable()) {
+			Wake();
+			_thread.join();
+		}
+
+		std::unordered_map<int, IoWatch> watches;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			watches.swap(_watches);
+			_timeouts.clear();
+		}
+		for (auto& [fd, watch] : watches) {
+			_queue->Unpark(watch.task, IO_CLOSED);
+		}
+
+#if defined(__linux__)
+		if (_wakeFd >= 0) {
+			close(_wakeFd);
+		}
+		if (_epoll >= 0) {
+			close(_epoll);
+		}
+#endif
+	}
+
+    [[maybe_unused]] bool TasksReactor::Watch(const TaskPtr& task, const int fd, const uint32_t events, const TaskDelay timeout) {
+#if defined(__linux__)
+		if (!task || (fd < 0) || !(events & (IO_READ | IO_WRITE)) || !_thread.joinable()) {
+			return false;
+		}
+
+		bool isEarliest = false;
+		TaskPtr stale;			// Released after the lock, it may be the last reference
+		{
+			// The thread takes the lock before it wakes a task up, so parking the task under it can't come too late
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_isStopping) {
+				return false;
+			}
+
+			auto [watchIt, isAdded] = _watches.try_emplace(fd);
+			if (!isAdded) {
+				// A watch left behind by a task that has been cancelled or has moved on is taken over
+				const TaskPtr& watching = watchIt->second.task;
+				const TaskStatus status = watching->GetStatus();
+				if ((watching != task) && (status != TASK_CANCELLED) && (status != TASK_FINISHED)) {
+					return false;
+				}
+				if (watchIt->second.hasTimeout) {
+					_timeouts.erase(watchIt->second.timeoutIt);
+				}
+				stale = std::move(watchIt->second.task);
+			}
+
+			// Descriptors stay in the epoll set, disabled, after they fire - unless they have been closed meanwhile
+			epoll_event event{};
+			event.events = ToEpoll(events) | EPOLLONESHOT;
+			event.data.fd = fd;
+			if ((epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &event) != 0)
+				&& ((errno != ENOENT) || (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) != 0))) {
+				_watches.erase(watchIt);
+				return false;
+			}
+
+			IoWatch& watch = watchIt->second;
+			watch.task = task;
+			watch.hasTimeout = (timeout > TaskDelay{ 0 });
+			if (watch.hasTimeout) {
+				watch.timeoutIt = _timeouts.emplace(scheduleClock::now() + timeout, fd);
+				isEarliest = (watch.timeoutIt == _timeouts.begin());
+			}
+			task->Park();
+		}
+
+		if (isEarliest) {
+			Wake();
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+    [[maybe_unused]] bool TasksReactor::Unwatch(const int fd) {
+#if defined(__linux__)
+		TaskPtr task;			// Released after the lock, it may be the last reference
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto watchIt = _watches.find(fd);
+			if (watchIt == _watches.end()) {
+				return false;
+			}
+
+			// Out of the set, so that it doesn't fire for a watch that is gone - it fails if the descriptor is closed already
+			epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+			task = std::move(watchIt->second.task);
+			DropWatch(watchIt);
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+    [[maybe_unused]] size_t TasksReactor::GetWatching() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _watches.size();
+	}
+
+	void TasksReactor::ThreadReact() {
+#if defined(__linux__)
+		epoll_event events[REACTOR_MAX_EVENTS];
+		std::vector<std::pair<TaskPtr, uint32_t>> ready;
+
+		while (!_isStopping) {
+			int timeoutMs = -1;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (!_timeouts.empty()) {
+					const auto wait = std::chrono::ceil<std::chrono::milliseconds>(_timeouts.begin()->first - scheduleClock::now());
+					timeoutMs = static_cast<int>(std::max<std::chrono::milliseconds::rep>(wait.count(), 0));
+				}
+			}
+
+			const int numEvents = epoll_wait(_epoll, events, REACTOR_MAX_EVENTS, timeoutMs);
+			if ((numEvents < 0) && (errno != EINTR)) {
+				break;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				for (int i = 0; i < numEvents; ++i) {
+					const int fd = events[i].data.fd;
+					if (fd == _wakeFd) {
+						uint64_t count;
+						[[maybe_unused]] const ssize_t size = read(_wakeFd, &count, sizeof(count));
+						continue;
+					}
+
+					auto watchIt = _watches.find(fd);
+					if (watchIt == _watches.end()) {
+						continue;
+					}
+					ready.emplace_back(std::move(watchIt->second.task), FromEpoll(events[i].events));
+					DropWatch(watchIt);
+				}
+
+				const scheduleTimePoint now = scheduleClock::now();
+				while (!_timeouts.empty() && (_timeouts.begin()->first <= now)) {
+					const int fd = _timeouts.begin()->second;
+					_timeouts.erase(_timeouts.begin());
+
+					// Out of the set, so that it doesn't fire for a watch that is gone
+					epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+					auto watchIt = _watches.find(fd);
+					ready.emplace_back(std::move(watchIt->second.task), IO_TIMEOUT);
+					_watches.erase(watchIt);
+				}
+			}
+
+			for (const auto& [task, result] : ready) {
+				_queue->Unpark(task, result);
+			}
+			ready.clear();
+		}
+#endif
+	}
+	void TasksReactor::DropWatch(const std::unordered_map<int, IoWatch>::iterator watchIt) {
+		if (watchIt->second.hasTimeout) {
+			_timeouts.erase(watchIt->second.timeoutIt);
+		}
+		_watches.erase(watchIt);
+	}
+	void TasksReactor::Wake() {
+#if defined(__linux__)
+		const uint64_t count = 1;
+		[[maybe_unused]] const ssize_t size = write(_wakeFd, &count, sizeof(count));
+#endif
+	}
+
+}
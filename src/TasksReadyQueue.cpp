@@ -0,0 +1,335 @@
+#include <algorithm>
+
+#include "taskslib/Task.h"
+#include "taskslib/TasksReadyQueue.h"
+
+#define LEVEL_STRIDE	(uint64_t{ 1 } << 40)
+
+namespace TasksLib {
+
+	bool TasksReadyQueue::EarlierDeadline::operator()(const Entry& lhs, const Entry& rhs) const {
+		if (lhs.deadline != rhs.deadline) {
+			return lhs.deadline < rhs.deadline;
+		}
+		return lhs.sequence < rhs.sequence;
+	}
+
+	TasksReadyQueue::TasksReadyQueue()
+		: _policy(POLICY_PRIORITY)
+		, _deadlineMissPolicy(DEADLINE_MISS_RUN)
+		, _sequence(0)
+		, _size(0)
+		, _passBase(0)
+		, _agingTime(0)
+	{}
+
+	void TasksReadyQueue::SetPolicy(const TasksQueuePolicy policy, const TaskDeadlineMissPolicy deadlineMissPolicy,
+									const std::chrono::milliseconds agingTime) {
+		std::vector<Entry> entries;
+		if (policy != _policy) {
+			entries = TakeAll();
+		}
+
+		_policy = policy;
+		_deadlineMissPolicy = deadlineMissPolicy;
+		_agingTime = agingTime;
+
+		// Whatever was waiting goes back in, ordered by the new policy
+		for (Entry& entry : entries) {
+			entry.sequence = _sequence++;
+			PushEntry(std::move(entry));
+		}
+	}
+
+    [[maybe_unused]] TasksQueuePolicy TasksReadyQueue::GetPolicy() const {
+		return _policy;
+	}
+
+	bool TasksReadyQueue::IsEmpty() const {
+		return _size.load(std::memory_order_relaxed) == 0;
+	}
+    [[maybe_unused]] size_t TasksReadyQueue::Size() const {
+		return _size;
+	}
+
+	void TasksReadyQueue::Push(const TaskPtr& task, const TaskOptions& options) {
+		PushEntry(Entry{ task, options.priority, options.deadline, _sequence++, options.isBlocking, scheduleTimePoint{}, nullptr });
+	}
+	void TasksReadyQueue::Push(PostedExecutable&& executable, const TaskOptions& options) {
+		PushEntry(Entry{ nullptr, options.priority, TaskDeadline::max(), _sequence++, options.isBlocking, scheduleTimePoint{}, std::move(executable) });
+	}
+	void TasksReadyQueue::PushEntry(Entry&& entry) {
+		if (_policy == POLICY_DEADLINE) {
+			auto it = _deadlineTasks[entry.isBlocking].insert(std::move(entry)).first;
+			if (it->task) {
+				_deadlineOrder.emplace(it->sequence, it);
+			}
+		} else if (_policy == POLICY_WEIGHTED_PRIORITY) {
+			auto levelIt = _levels.find(entry.priority);
+			if (levelIt == _levels.end()) {
+				levelIt = _levels.emplace(entry.priority, PriorityLevel{}).first;
+				levelIt->second.pass = _passBase;
+			}
+
+			entry.added = scheduleClock::now();
+			levelIt->second.tasks[entry.isBlocking].push_back(std::move(entry));
+		} else {
+			_fifo.push_back(std::move(entry));
+		}
+		++_size;
+	}
+
+	TaskPtr TasksReadyQueue::Take(const bool ignoreBlocking, const TaskPriority runningPriority, std::vector<TaskPtr>& dropped, bool& missedDeadline, PostedCall& posted) {
+		missedDeadline = false;
+
+		if (_policy == POLICY_DEADLINE) {
+			return TakeByDeadline(ignoreBlocking, dropped, missedDeadline, posted);
+		}
+		if (_policy == POLICY_WEIGHTED_PRIORITY) {
+			return TakeByWeightedPriority(ignoreBlocking, posted);
+		}
+		return TakeByPriority(ignoreBlocking, runningPriority, posted);
+	}
+
+	TaskPtr TasksReadyQueue::TakeByPriority(const bool ignoreBlocking, const TaskPriority runningPriority, PostedCall& posted) {
+		for (auto it = _fifo.begin(); it != _fifo.end(); ) {
+			if (IsCancelled(*it)) {
+				it = _fifo.erase(it);
+				--_size;
+				continue;
+			}
+			if (!(it->isBlocking && ignoreBlocking) && (it->priority >= runningPriority)) {
+				TaskPtr task = TakeEntry(*it, posted);
+				_fifo.erase(it);
+				--_size;
+				return task;
+			}
+			++it;
+		}
+
+		return nullptr;
+	}
+	TaskPtr TasksReadyQueue::TakeByDeadline(const bool ignoreBlocking, std::vector<TaskPtr>& dropped, bool& missedDeadline, PostedCall& posted) {
+		const auto now = scheduleClock::now();
+
+		for (;;) {
+			// The best candidate is the first non-blocking task, or the first blocking one if we may run blocking tasks
+			DeadlineSet* tasks = nullptr;
+			for (int i = 0; i < (ignoreBlocking ? 1 : 2); i++) {
+				if (!_deadlineTasks[i].empty()
+					&& (!tasks || EarlierDeadline{}(*_deadlineTasks[i].begin(), *tasks->begin()))
+					)
+				{
+					tasks = &_deadlineTasks[i];
+				}
+			}
+
+			if (!tasks) {
+				break;
+			}
+
+			Entry entry = ExtractDeadlineEntry(tasks->begin());
+
+			if (IsCancelled(entry)) {
+				--_size;
+				continue;
+			}
+			if (entry.deadline < now) {
+				if (_deadlineMissPolicy == DEADLINE_MISS_DROP) {
+					--_size;
+					dropped.push_back(std::move(entry.task));
+					continue;
+				}
+				if (_deadlineMissPolicy == DEADLINE_MISS_DEPRIORITIZE) {
+					_lateTasks[entry.isBlocking].push_back(std::move(entry));
+					continue;
+				}
+				missedDeadline = true;
+			}
+
+			--_size;
+			return TakeEntry(entry, posted);
+		}
+
+		// Nothing that can make its deadline is left, the late ones go in the order they missed it
+		for (int i = 0; i < (ignoreBlocking ? 1 : 2); i++) {
+			while (!_lateTasks[i].empty()) {
+				Entry entry = std::move(_lateTasks[i].front());
+				_lateTasks[i].pop_front();
+				--_size;
+
+				if (!IsCancelled(entry)) {
+					missedDeadline = true;
+					return TakeEntry(entry, posted);
+				}
+			}
+		}
+
+		return nullptr;
+	}
+
+	TaskPtr TasksReadyQueue::TakeByWeightedPriority(const bool ignoreBlocking, PostedCall& posted) {
+		const auto now = scheduleClock::now();
+		const int numClasses = ignoreBlocking ? 1 : 2;
+
+		std::map<TaskPriority, PriorityLevel>::iterator oldestLevel = _levels.end();
+		int oldestClass = 0;
+		std::map<TaskPriority, PriorityLevel>::iterator nextLevel = _levels.end();
+
+		for (auto levelIt = _levels.begin(); levelIt != _levels.end(); ) {
+			PriorityLevel& level = levelIt->second;
+			bool eligible = false;
+
+			for (int i = 0; i < 2; i++) {
+				while (!level.tasks[i].empty() && IsCancelled(level.tasks[i].front())) {
+					level.tasks[i].pop_front();
+					--_size;
+				}
+				if ((i >= numClasses) || level.tasks[i].empty()) {
+					continue;
+				}
+
+				eligible = true;
+				const Entry& front = level.tasks[i].front();
+				if ((front.added + _agingTime <= now)
+					&& ((oldestLevel == _levels.end()) || (front.sequence < oldestLevel->second.tasks[oldestClass].front().sequence))
+					)
+				{
+					oldestLevel = levelIt;
+					oldestClass = i;
+				}
+			}
+
+			if (level.tasks[0].empty() && level.tasks[1].empty()) {
+				levelIt = _levels.erase(levelIt);
+				continue;
+			}
+			// On a tie the higher priority goes first, it comes later in the map
+			if (eligible
+				&& ((nextLevel == _levels.end()) || (std::max(level.pass, _passBase) <= std::max(nextLevel->second.pass, _passBase)))
+				)
+			{
+				nextLevel = levelIt;
+			}
+			++levelIt;
+		}
+
+		std::deque<Entry>* tasks = nullptr;
+		if (oldestLevel != _levels.end()) {
+			// Waited long enough, the level's share doesn't matter anymore
+			tasks = &oldestLevel->second.tasks[oldestClass];
+		} else if (nextLevel != _levels.end()) {
+			PriorityLevel& level = nextLevel->second;
+			const uint64_t pass = std::max(level.pass, _passBase);
+			level.pass = pass + LEVEL_STRIDE / (uint64_t{ nextLevel->first } + 1);
+			_passBase = pass;
+
+			// Take the older one of the two classes
+			tasks = &level.tasks[0];
+			if ((numClasses > 1) && !level.tasks[1].empty()
+				&& (tasks->empty() || (level.tasks[1].front().sequence < tasks->front().sequence))
+				)
+			{
+				tasks = &level.tasks[1];
+			}
+		} else {
+			return nullptr;
+		}
+
+		TaskPtr task = TakeEntry(tasks->front(), posted);
+		tasks->pop_front();
+		--_size;
+		return task;
+	}
+
+	TaskPtr TasksReadyQueue::TakeOldest() {
+		std::deque<Entry>* oldestTasks = nullptr;
+		bool isOldestDeadline = false;
+		uint64_t oldestSequence = UINT64_MAX;
+
+		// The queues in order of submission only have to be looked at in the front
+		auto checkFront = [this, &oldestTasks, &isOldestDeadline, &oldestSequence](std::deque<Entry>& tasks) {
+			while (!tasks.empty() && IsCancelled(tasks.front())) {
+				tasks.pop_front();
+				--_size;
+			}
+			if (!tasks.empty() && tasks.front().task && (tasks.front().sequence < oldestSequence)) {
+				oldestSequence = tasks.front().sequence;
+				oldestTasks = &tasks;
+				isOldestDeadline = false;
+			}
+		};
+		checkFront(_fifo);
+		for (int i = 0; i < 2; i++) {
+			checkFront(_lateTasks[i]);
+		}
+		for (auto& level : _levels) {
+			for (auto& tasks : level.second.tasks) {
+				checkFront(tasks);
+			}
+		}
+		// The deadline tasks are indexed by sequence as well
+		while (!_deadlineOrder.empty() && IsCancelled(*_deadlineOrder.begin()->second)) {
+			ExtractDeadlineEntry(_deadlineOrder.begin()->second);
+			--_size;
+		}
+		if (!_deadlineOrder.empty() && (_deadlineOrder.begin()->first < oldestSequence)) {
+			oldestTasks = nullptr;
+			isOldestDeadline = true;
+		}
+
+		TaskPtr task;
+		if (oldestTasks) {
+			task = std::move(oldestTasks->front().task);
+			oldestTasks->pop_front();
+		} else if (isOldestDeadline) {
+			task = std::move(ExtractDeadlineEntry(_deadlineOrder.begin()->second).task);
+		} else {
+			return nullptr;
+		}
+
+		--_size;
+		return task;
+	}
+
+	std::vector<TasksReadyQueue::Entry> TasksReadyQueue::TakeAll() {
+		std::vector<Entry> entries(std::make_move_iterator(_fifo.begin()), std::make_move_iterator(_fifo.end()));
+		_fifo.clear();
+		for (int i = 0; i < 2; i++) {
+			while (!_deadlineTasks[i].empty()) {
+				entries.push_back(std::move(_deadlineTasks[i].extract(_deadlineTasks[i].begin()).value()));
+			}
+			std::move(_lateTasks[i].begin(), _lateTasks[i].end(), std::back_inserter(entries));
+			_lateTasks[i].clear();
+		}
+		_deadlineOrder.clear();
+		for (auto& level : _levels) {
+			for (auto& tasks : level.second.tasks) {
+				std::move(tasks.begin(), tasks.end(), std::back_inserter(entries));
+			}
+		}
+		_levels.clear();
+		_size = 0;
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) { return lhs.sequence < rhs.sequence; });
+		return entries;
+	}
+
+	TasksReadyQueue::Entry TasksReadyQueue::ExtractDeadlineEntry(const DeadlineSet::iterator it) {
+		if (it->task) {
+			_deadlineOrder.erase(it->sequence);
+		}
+		return std::move(_deadlineTasks[it->isBlocking].extract(it).value());
+	}
+	TaskPtr TasksReadyQueue::TakeEntry(Entry& entry, PostedCall& posted) {
+		if (!entry.task) {
+			posted.executable = std::move(entry.posted);
+			posted.priority = entry.priority;
+		}
+		return std::move(entry.task);
+	}
+	bool TasksReadyQueue::IsCancelled(const Entry& entry) {
+		return entry.task && entry.task->_isCancelled.load(std::memory_order_relaxed);		// Posted callables can't be cancelled
+	}
+
+}
@@ -0,0 +1,272 @@
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+
+#include "taskslib/TasksTracer.h"
+
+#define TRACE_MIN_EVENTS_PER_THREAD		16
+
+namespace {
+
+	using namespace TasksLib;
+
+	struct TraceEvent {
+		int64_t begin;
+		int64_t duration;					// Negative for instant events
+		uint64_t id;
+		uint32_t thread;
+		uint32_t kind;
+	};
+
+	// Relaxed atomics all of them, they compile to plain stores and the dump may read a slot while it is overwritten
+	struct TraceSlot {
+		std::atomic<int64_t> begin{ 0 };
+		std::atomic<int64_t> duration{ 0 };
+		std::atomic<uint64_t> id{ 0 };
+		std::atomic<uint32_t> thread{ 0 };
+		std::atomic<uint32_t> kind{ 0 };
+	};
+
+	/*
+		Single writer ring, the thread that leased it. Writing announces the slot in _claimed before touching it
+		and publishes it in _written afterwards, so a reader that copies up to _written and checks _claimed after the
+		copy knows which of the slots it read may have been overwritten meanwhile.
+	 */
+	class TraceBuffer {
+	public:
+		explicit TraceBuffer(const size_t capacity)
+			: _capacity(capacity)
+			, _slots(new TraceSlot[capacity])
+			, _session(0)
+			, _claimed(0)
+			, _written(0)
+		{}
+
+		void Push(const TraceEvent& event) {
+			const uint64_t n = _claimed.load(std::memory_order_relaxed);
+			TraceSlot& slot = _slots[n % _capacity];
+
+			_claimed.store(n + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.begin.store(event.begin, std::memory_order_relaxed);
+			slot.duration.store(event.duration, std::memory_order_relaxed);
+			slot.id.store(event.id, std::memory_order_relaxed);
+			slot.thread.store(event.thread, std::memory_order_relaxed);
+			slot.kind.store(event.kind, std::memory_order_relaxed);
+			_written.store(n + 1, std::memory_order_release);
+		}
+
+		/* Appends the events that weren't overwritten while reading them, returns how many have been overwritten in total */
+		uint64_t Read(std::vector<TraceEvent>& events) const {
+			const uint64_t written = _written.load(std::memory_order_acquire);
+			const uint64_t first = (written > _capacity) ? (written - _capacity) : 0;
+
+			const size_t start = events.size();
+			for (uint64_t n = first; n < written; ++n) {
+				const TraceSlot& slot = _slots[n % _capacity];
+				events.push_back(TraceEvent{
+					slot.begin.load(std::memory_order_relaxed),
+					slot.duration.load(std::memory_order_relaxed),
+					slot.id.load(std::memory_order_relaxed),
+					slot.thread.load(std::memory_order_relaxed),
+					slot.kind.load(std::memory_order_relaxed)
+				});
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t claimed = _claimed.load(std::memory_order_relaxed);
+			const uint64_t valid = (claimed > _capacity) ? (claimed - _capacity) : 0;
+			if (valid > first) {
+				const auto torn = static_cast<ptrdiff_t>(std::min(valid, written) - first);
+				events.erase(events.begin() + static_cast<ptrdiff_t>(start), events.begin() + static_cast<ptrdiff_t>(start) + torn);
+			}
+			return std::max(valid, first);
+		}
+
+		/* Only while nobody writes into it - it is the caller's own or an idle one */
+		void Reset(const uint64_t session) {
+			_session = session;
+			_claimed.store(0, std::memory_order_relaxed);
+			_written.store(0, std::memory_order_release);
+		}
+
+		size_t GetCapacity() const {
+			return _capacity;
+		}
+		uint64_t GetSession() const {
+			return _session;
+		}
+
+	private:
+		const size_t _capacity;
+		std::unique_ptr<TraceSlot[]> _slots;
+		uint64_t _session;					// Changed under the registry's mutex, by the writer or while idle
+		std::atomic<uint64_t> _claimed;
+		std::atomic<uint64_t> _written;
+	};
+
+	struct TraceRegistry {
+		std::mutex mutex;
+		std::vector<std::unique_ptr<TraceBuffer>> buffers;
+		std::vector<TraceBuffer*> idle;		// Left behind by the threads that have exited, their events are still dumped
+		size_t capacity = TasksTracer::DEFAULT_EVENTS_PER_THREAD;
+	};
+
+	// Never destroyed, threads may still exit and return their buffers while the statics are being destroyed
+	TraceRegistry& GetRegistry() {
+		static TraceRegistry* registry = new TraceRegistry();
+		return *registry;
+	}
+
+	std::atomic<uint64_t> s_session{ 0 };
+	std::atomic<uint32_t> s_lastThread{ 0 };
+	thread_local const uint32_t t_thread = ++s_lastThread;
+
+	struct TraceLease {
+		TraceBuffer* buffer = nullptr;
+
+		~TraceLease() {
+			if (buffer) {
+				TraceRegistry& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+				registry.idle.push_back(buffer);
+			}
+		}
+	};
+	thread_local TraceLease t_lease;
+
+	void RemoveBuffer(TraceRegistry& registry, const TraceBuffer* buffer) {
+		registry.buffers.erase(std::find_if(registry.buffers.begin(), registry.buffers.end(), [buffer](const std::unique_ptr<TraceBuffer>& it) {
+			return it.get() == buffer;
+		}));
+	}
+
+	/* The slow path of the first event of a thread in a session */
+	TraceBuffer* LeaseBuffer() {
+		TraceRegistry& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		TraceBuffer*& buffer = t_lease.buffer;
+		if (buffer && (buffer->GetCapacity() != registry.capacity)) {
+			RemoveBuffer(registry, buffer);
+			buffer = nullptr;
+		}
+		if (!buffer) {
+			auto idleIt = std::find_if(registry.idle.begin(), registry.idle.end(), [&registry](const TraceBuffer* it) {
+				return (it->GetCapacity() == registry.capacity) && (it->GetSession() != s_session.load(std::memory_order_relaxed));
+			});
+			if ((idleIt == registry.idle.end()) && (registry.buffers.size() >= TasksTracer::MAX_BUFFERS)) {
+				// Full, the thread that exited first gives up its events - the idle buffers are in the order of exit
+				idleIt = std::find_if(registry.idle.begin(), registry.idle.end(), [&registry](const TraceBuffer* it) {
+					return it->GetCapacity() == registry.capacity;
+				});
+			}
+			if (idleIt != registry.idle.end()) {
+				buffer = *idleIt;
+				registry.idle.erase(idleIt);
+			} else {
+				registry.buffers.push_back(std::make_unique<TraceBuffer>(registry.capacity));
+				buffer = registry.buffers.back().get();
+			}
+		}
+
+		buffer->Reset(s_session.load(std::memory_order_relaxed));
+		return buffer;
+	}
+
+	const char* GetEventName(const uint32_t kind) {
+		switch (kind) {
+			case TRACE_ADD:			return "Add";
+			case TRACE_SUSPEND:		return "Suspend";
+			case TRACE_RESUME:		return "Resume";
+			case TRACE_EXECUTE:		return "Execute";
+			case TRACE_RESCHEDULE:	return "Reschedule";
+			case TRACE_CANCEL:		return "Cancel";
+			case TRACE_UPDATE:		return "Update";
+			default:				return "Unknown";
+		}
+	}
+
+	// Trace-event timestamps are in microseconds
+	void WriteMicroseconds(std::ostream& out, const int64_t ns) {
+		out << (ns / 1000) << '.' << std::setw(3) << std::setfill('0') << (ns % 1000) << std::setfill(' ');
+	}
+
+}
+
+namespace TasksLib {
+
+	// ===== TasksTracer ================================================================
+    [[maybe_unused]] void TasksTracer::Enable(const size_t eventsPerThread) {
+		TraceRegistry& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		registry.capacity = std::max<size_t>(eventsPerThread, TRACE_MIN_EVENTS_PER_THREAD);
+		registry.idle.erase(std::remove_if(registry.idle.begin(), registry.idle.end(), [&registry](const TraceBuffer* buffer) {
+			if (buffer->GetCapacity() == registry.capacity) {
+				return false;
+			}
+			RemoveBuffer(registry, buffer);
+			return true;
+		}), registry.idle.end());
+
+		// Every thread switches to the new session with its next event
+		s_session.fetch_add(1, std::memory_order_relaxed);
+		_isEnabled.store(true, std::memory_order_relaxed);
+	}
+    [[maybe_unused]] void TasksTracer::Disable() {
+		_isEnabled.store(false, std::memory_order_relaxed);
+	}
+
+    [[maybe_unused]] void TasksTracer::WriteChromeTrace(std::ostream& out) {
+		std::vector<TraceEvent> events;
+		uint64_t overwritten = 0;
+		{
+			TraceRegistry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+
+			const uint64_t session = s_session.load(std::memory_order_relaxed);
+			for (const auto& buffer : registry.buffers) {
+				if (buffer->GetSession() == session) {
+					overwritten += buffer->Read(events);
+				}
+			}
+		}
+
+		std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+			return a.begin < b.begin;
+		});
+
+		out << "{\"traceEvents\":[";
+		out << "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"TasksLib\"}}";
+		for (const TraceEvent& event : events) {
+			out << ",\n{\"name\":\"" << GetEventName(event.kind) << "\",\"cat\":\"" << ((event.kind == TRACE_UPDATE) ? "queue" : "task") << "\"";
+			if (event.duration >= 0) {
+				out << ",\"ph\":\"X\",\"ts\":";
+				WriteMicroseconds(out, event.begin);
+				out << ",\"dur\":";
+				WriteMicroseconds(out, event.duration);
+			} else {
+				out << ",\"ph\":\"i\",\"s\":\"t\",\"ts\":";
+				WriteMicroseconds(out, event.begin);
+			}
+			out << ",\"pid\":1,\"tid\":" << event.thread;
+			if (event.id != 0) {
+				out << ",\"args\":{\"task\":\"0x" << std::hex << event.id << std::dec << "\"}";
+			}
+			out << "}";
+		}
+		out << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"overwrittenEvents\":" << overwritten << "}}\n";
+	}
+
+	void TasksTracer::Write(const TaskTraceEvent event, const void* id, const int64_t begin, const int64_t duration) {
+		TraceBuffer* buffer = t_lease.buffer;
+		if (!buffer || (buffer->GetSession() != s_session.load(std::memory_order_relaxed))) {
+			buffer = LeaseBuffer();
+		}
+		buffer->Push(TraceEvent{ begin, duration, reinterpret_cast<uintptr_t>(id), t_thread, event });
+	}
+
+}
@@ -0,0 +1,335 @@
+#include <algorithm>
+
+#include "taskslib/TasksThread.h"
+#include "taskslib/TasksWorkerPool.h"
+
+#define LANE_STRIDE		(1u << 20)
+
+namespace TasksLib {
+
+	// ===== TasksWorkerPool::LaneConfiguration =========================================
+	TasksWorkerPool::LaneConfiguration::LaneConfiguration()
+		: LaneConfiguration(1, 0, 0) {}
+	TasksWorkerPool::LaneConfiguration::LaneConfiguration(uint16_t laneWeight, uint16_t laneMinConcurrency, uint16_t laneMaxConcurrency)
+		: weight(laneWeight)
+		, minConcurrency(laneMinConcurrency)
+		, maxConcurrency(laneMaxConcurrency)
+		, capacity() {}
+
+	// ===== TasksWorkerPool ============================================================
+	TasksWorkerPool::TasksWorkerPool()
+		: _isInitialized(false)
+		, _isShuttingDown(false)
+		, _numNonBlockingThreads(0)
+		, _idleWorkers{ 0, 0 }
+		, _busyWorkers(0)
+		, _passBase(0)
+		, _scheduleChanged(false)
+	{}
+	TasksWorkerPool::TasksWorkerPool(const TasksQueue::Configuration& configuration)
+		: TasksWorkerPool()
+	{
+		Initialize(configuration);
+	}
+	TasksWorkerPool::~TasksWorkerPool() {
+		Cleanup();
+	}
+
+	bool TasksWorkerPool::isInitialized() const {
+		return _isInitialized;
+	}
+    [[maybe_unused]] uint16_t TasksWorkerPool::numWorkerThreads() const {
+		return static_cast<uint16_t>(_workerThreads.size());
+	}
+    [[maybe_unused]] uint16_t TasksWorkerPool::numBlockingThreads() const {
+		return static_cast<uint16_t>(_workerThreads.size()) - _numNonBlockingThreads;
+	}
+    [[maybe_unused]] uint16_t TasksWorkerPool::numNonBlockingThreads() const {
+		return _numNonBlockingThreads;
+	}
+    [[maybe_unused]] uint16_t TasksWorkerPool::numSchedulingThreads() const {
+		return static_cast<uint16_t>(_schedulingThreads.size());
+	}
+    [[maybe_unused]] size_t TasksWorkerPool::numLanes() const {
+		std::lock_guard<std::mutex> lock(_poolMutex);
+		return _lanes.size();
+	}
+
+	void TasksWorkerPool::Initialize(const TasksQueue::Configuration& configuration) {
+		std::lock_guard<std::mutex> guard(_initMutex);
+
+		if (_isInitialized || _isShuttingDown) {
+			return;
+		}
+		if (configuration.blockingThreads < 1) {
+			return;
+		}
+
+		CreateThreads(configuration);
+		_isInitialized = true;
+	}
+	void TasksWorkerPool::Cleanup() {
+		if (!_isInitialized || _isShuttingDown) {
+			return;
+		}
+
+		{
+			// Taking the locks makes sure no thread is between checking its predicate and going to sleep
+			std::lock_guard<std::mutex> lockPool(_poolMutex);
+			std::lock_guard<std::mutex> lockSched(_scheduleMutex);
+			_isShuttingDown = true;
+		}
+
+		_poolConditions[false].notify_all();
+		_poolConditions[true].notify_all();
+		_scheduleCondition.notify_all();
+		for (const std::shared_ptr<TasksThread>& thread : _workerThreads) {
+			thread->join();
+		}
+		for (const std::shared_ptr<TasksThread>& thread : _schedulingThreads) {
+			thread->join();
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(_initMutex);
+			_workerThreads.clear();
+			_schedulingThreads.clear();
+			_numNonBlockingThreads = 0;
+			_busyWorkers = 0;
+			_isInitialized = false;
+			_isShuttingDown = false;
+		}
+	}
+
+    [[maybe_unused]] bool TasksWorkerPool::AttachQueue(TasksQueue* queue, const LaneConfiguration& configuration) {
+		if (!queue || queue->isInitialized()) {
+			return false;
+		}
+
+		queue->AttachToPool(this, configuration.capacity);
+		if (!queue->isInitialized()) {
+			return false;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_poolMutex);
+
+			auto lane = std::make_unique<Lane>();
+			lane->queue = queue;
+			lane->configuration = configuration;
+			lane->configuration.weight = std::max<uint16_t>(configuration.weight, 1);
+			lane->running = 0;
+			lane->pass = _passBase;
+			lane->notifications = 0;
+			lane->pending[0] = lane->pending[1] = false;
+			_lanes.push_back(std::move(lane));
+		}
+
+		return true;
+	}
+
+	void TasksWorkerPool::CreateThreads(const TasksQueue::Configuration& configuration) {
+		for (int i = 0; i < configuration.blockingThreads; ++i) {
+			auto thread = std::make_shared<TasksThread>(false, &TasksWorkerPool::ThreadExecuteTasks, this, false);
+			_workerThreads.push_back(thread);
+		}
+		for (int i = 0; i < configuration.nonBlockingThreads; ++i) {
+			auto thread = std::make_shared<TasksThread>(true, &TasksWorkerPool::ThreadExecuteTasks, this, true);
+			_workerThreads.push_back(thread);
+		}
+		_numNonBlockingThreads = configuration.nonBlockingThreads;
+		if (configuration.schedulingThreads > 0) {
+			auto thread = std::make_shared<TasksThread>(false, &TasksWorkerPool::ThreadExecuteScheduledTasks, this);
+			_schedulingThreads.push_back(thread);
+		}
+	}
+
+	void TasksWorkerPool::NotifyTasks(TasksQueue* queue) {
+		uint32_t wakeups[2] = { 0, 0 };			// Indexed by ignoreBlocking
+		{
+			std::lock_guard<std::mutex> lock(_poolMutex);
+
+			// A single task needs a single worker, only a lane below its minimum concurrency wants as many as it is short of
+			uint32_t numWakeups = 1;
+			for (auto& lane : _lanes) {
+				if (lane->queue == queue) {
+					++lane->notifications;
+					lane->pending[0] = lane->pending[1] = true;
+					if (lane->running < lane->configuration.minConcurrency) {
+						numWakeups = lane->configuration.minConcurrency - lane->running;
+					}
+					break;
+				}
+			}
+
+			// Non-blocking workers go first and leave the blocking ones for the blocking tasks. A non-blocking worker that
+			// can't run the task passes the wakeup on to a blocking one, see ThreadExecuteTasks()
+			wakeups[true] = std::min(numWakeups, _idleWorkers[true]);
+			wakeups[false] = std::max<uint32_t>(numWakeups - wakeups[true], (wakeups[true] == 0) ? 1 : 0);
+		}
+
+		for (int i = 0; i < 2; i++) {
+			for (uint32_t n = 0; n < wakeups[i]; n++) {
+				_poolConditions[i].notify_one();
+			}
+		}
+	}
+	void TasksWorkerPool::NotifySchedule() {
+		{
+			std::lock_guard<std::mutex> lock(_scheduleMutex);
+			_scheduleChanged = true;
+		}
+
+		_scheduleCondition.notify_one();
+	}
+
+	TasksWorkerPool::Lane* TasksWorkerPool::PickLane(const bool ignoreBlocking) {
+		// Workers not yet claimed by the lanes' minimum concurrency - only by the lanes that have tasks for them
+		uint32_t reserved = 0;
+		for (const auto& lane : _lanes) {
+			if (IsPending(*lane) && (lane->running < lane->configuration.minConcurrency)) {
+				reserved += lane->configuration.minConcurrency - lane->running;
+			}
+		}
+		const auto idle = static_cast<uint32_t>(_workerThreads.size()) - _busyWorkers;
+
+		Lane* picked = nullptr;
+		bool pickedUnderMin = false;
+		for (const auto& lane : _lanes) {
+			const LaneConfiguration& config = lane->configuration;
+			if (!lane->pending[ignoreBlocking]) {
+				continue;
+			}
+			if ((config.maxConcurrency > 0) && (lane->running >= config.maxConcurrency)) {
+				continue;
+			}
+
+			bool underMin = lane->running < config.minConcurrency;
+			if (!underMin && (idle <= reserved)) {
+				continue;			// The rest of the idle workers are spoken for
+			}
+
+			// Lanes below their minimum go first, then the one with the lowest pass
+			if (!picked
+				|| (underMin && !pickedUnderMin)
+				|| ((underMin == pickedUnderMin) && (std::max(lane->pass, _passBase) < std::max(picked->pass, _passBase)))
+				)
+			{
+				picked = lane.get();
+				pickedUnderMin = underMin;
+			}
+		}
+
+		return picked;
+	}
+	bool TasksWorkerPool::IsPending(const Lane& lane) {
+		return lane.pending[false] || lane.pending[true];
+	}
+
+	void TasksWorkerPool::ThreadExecuteTasks(const bool ignoreBlocking) {
+		for (;;) {
+			Lane* lane = nullptr;
+			uint64_t notifications;
+			{
+				std::unique_lock<std::mutex> lock(_poolMutex);
+
+				++_idleWorkers[ignoreBlocking];
+				_poolConditions[ignoreBlocking].wait(lock, [this, &lane, ignoreBlocking] {
+					return _isShuttingDown || ((lane = PickLane(ignoreBlocking)) != nullptr);
+				});
+				--_idleWorkers[ignoreBlocking];
+				if (_isShuttingDown) {
+					break;
+				}
+
+				lane->pass = std::max(lane->pass, _passBase) + LANE_STRIDE / lane->configuration.weight;
+				_passBase = std::max(_passBase, lane->pass - LANE_STRIDE / lane->configuration.weight);
+				notifications = lane->notifications;
+				++lane->running;
+				++_busyWorkers;
+			}
+
+			bool executed = lane->queue->ExecuteTask(ignoreBlocking);
+
+			uint32_t wakeups[2] = { 0, 0 };			// Indexed by ignoreBlocking
+			{
+				std::lock_guard<std::mutex> lock(_poolMutex);
+
+				const LaneConfiguration& config = lane->configuration;
+				const bool wasAtMax = (config.maxConcurrency > 0) && (lane->running >= config.maxConcurrency);
+				const bool wasPending = IsPending(*lane);
+				--lane->running;
+				--_busyWorkers;
+
+				// Found nothing and nothing new came in meanwhile - don't look at the lane again until notified.
+				// A blocking thread can run anything, so if it found nothing, neither will the others.
+				if (!executed && (lane->notifications == notifications)) {
+					lane->pending[ignoreBlocking] = false;
+					if (!ignoreBlocking) {
+						lane->pending[true] = false;
+					}
+				}
+
+				// Workers that were held back by the lane's limits may have something to do now - as many as the lane is
+				// short of its minimum, or the one freed slot at its maximum, and this worker comes back for one of them.
+				// A lane that ran out of tasks no longer reserves workers, they may be free for the other lanes.
+				uint32_t numWakeups = 0;
+				const uint32_t shortfall = (lane->running < config.minConcurrency) ? config.minConcurrency - lane->running : 0;
+				if (IsPending(*lane)) {
+					numWakeups = std::max<uint32_t>(shortfall, wasAtMax ? 1 : 0);
+					if (lane->pending[ignoreBlocking] && (numWakeups > 0)) {
+						--numWakeups;
+					}
+				} else if (wasPending) {
+					numWakeups = shortfall;
+				}
+				const bool nonBlockingFirst = lane->pending[true] || !IsPending(*lane);
+				wakeups[true] = nonBlockingFirst ? std::min(numWakeups, _idleWorkers[true]) : 0;
+				wakeups[false] = std::min(numWakeups - wakeups[true], _idleWorkers[false]);
+
+				// Woken for a blocking task that this worker can't run
+				if (!executed && ignoreBlocking && lane->pending[false] && (wakeups[false] == 0) && (_idleWorkers[false] > 0)) {
+					wakeups[false] = 1;
+				}
+			}
+
+			for (int i = 0; i < 2; i++) {
+				for (uint32_t n = 0; n < wakeups[i]; n++) {
+					_poolConditions[i].notify_one();
+				}
+			}
+		}
+	}
+	void TasksWorkerPool::ThreadExecuteScheduledTasks() {
+		for (;;) {
+			std::vector<TasksQueue*> queues;
+			{
+				std::lock_guard<std::mutex> lock(_poolMutex);
+				for (const auto& lane : _lanes) {
+					queues.push_back(lane->queue);
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lock(_scheduleMutex);
+				_scheduleChanged = false;
+			}
+
+			scheduleTimePoint earliest = scheduleTimePoint::max();
+			for (TasksQueue* queue : queues) {
+				earliest = std::min(earliest, queue->ExpireScheduledTasks());
+			}
+
+			std::unique_lock<std::mutex> lock(_scheduleMutex);
+			auto wakeUp = [this] { return _isShuttingDown || _scheduleChanged; };
+			if (earliest == scheduleTimePoint::max()) {
+				_scheduleCondition.wait(lock, wakeUp);
+			} else {
+				_scheduleCondition.wait_until(lock, earliest, wakeUp);
+			}
+			if (_isShuttingDown) {
+				break;
+			}
+		}
+	}
+
+}
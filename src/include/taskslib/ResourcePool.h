@@ -1,8 +1,11 @@
 #pragma once
 
 #include <stack>
+#include <vector>
+#include <atomic>
 #include <mutex>
 #include <memory>
+#include <algorithm>
 
 #include "Types.h"
 
@@ -104,6 +107,7 @@ namespace TasksLib {
 
     // ==========================================================================
 
+
     /*
      * Class Singleton
      *
@@ -113,31 +117,164 @@ namespace TasksLib {
      * it is the Window, or the Renderer, or the Config manager it is useful).
      *
      * Use the static getInstance() to retrieve a pointer to the underlying instance, and
-     * create it if needed.
+     * create it if needed. The singleton doesn't own the instance - it gets destroyed when the
+     * last shared_ptr to it is released, and the next getInstance() creates a new one.
+     *
+     * getInstance() is thread safe and doesn't lock once the instance exists, but it isn't free - the
+     * returned shared_ptr takes a reference on the instance's shared count, which all threads write to.
+     * Creation is serialized on a mutex, so concurrent first calls always agree on one instance.
+     *
+     * getCachedInstance() is for hot paths - it keeps a shared_ptr in a thread_local, so after the
+     * first call it costs a TLS access and nothing else. The cached pointer pins the instance until
+     * the calling thread exits or calls releaseCachedInstance().
      */
     template <class T> class [[maybe_unused]] Singleton {
-    public:
-        [[maybe_unused]] static std::weak_ptr<T> _instance;
-
     public:
         template <typename... Args>
         [[maybe_unused]] static std::shared_ptr<T> getInstance(Args ...args);
+        template <typename... Args>
+        [[maybe_unused]] static const std::shared_ptr<T>& getCachedInstance(Args ...args);
+        [[maybe_unused]] static void releaseCachedInstance();
+
+        /* Holders kept in memory - the current one and the old ones some thread may still be reading */
+        [[maybe_unused]] static size_t getHolderCount();
+
+    private:
+        // Holders are immutable once published. A thread announces the holder it reads in its reader's hazard
+        // slot, and the old holders are freed after a new one is published as soon as no hazard slot has them
+        struct Holder {
+            std::weak_ptr<T> instance;
+        };
+        struct Reader {
+            std::atomic<Holder*> hazard{ nullptr };
+            std::atomic<bool> isUsed{ true };
+        };
+        struct ReaderSlot {				// Gives the thread's reader back to the next thread when the thread exits
+            Reader* reader = nullptr;
+            ~ReaderSlot();
+        };
+
+        static std::atomic<Holder*> _holder;
+        static std::mutex _holderMutex;
+        static std::vector<std::unique_ptr<Holder>> _holders;
+        static std::vector<std::unique_ptr<Reader>> _readers;
+        static thread_local ReaderSlot _readerSlot;
+        static thread_local std::shared_ptr<T> _cachedInstance;
+
+        static Reader& GetReader_();
+        static void ReclaimHolders_();
     };
 
-    // We have to explicitly instantiate the static data member
-    template <class T> std::weak_ptr<T> Singleton<T>::_instance;
+    // We have to explicitly instantiate the static data members
+    template <class T> std::atomic<typename Singleton<T>::Holder*> Singleton<T>::_holder{ nullptr };
+    template <class T> std::mutex Singleton<T>::_holderMutex;
+    template <class T> std::vector<std::unique_ptr<typename Singleton<T>::Holder>> Singleton<T>::_holders;
+    template <class T> std::vector<std::unique_ptr<typename Singleton<T>::Reader>> Singleton<T>::_readers;
+    template <class T> thread_local typename Singleton<T>::ReaderSlot Singleton<T>::_readerSlot;
+    template <class T> thread_local std::shared_ptr<T> Singleton<T>::_cachedInstance;
+
+    template <class T> Singleton<T>::ReaderSlot::~ReaderSlot() {
+        if (reader) {
+            reader->hazard.store(nullptr, std::memory_order_relaxed);
+            reader->isUsed.store(false, std::memory_order_release);
+        }
+    }
 
     template <class T>
     template <typename... Args>
     [[maybe_unused]] std::shared_ptr<T> Singleton<T>::getInstance(Args ...args) {
-        std::shared_ptr<T> ptr = _instance.lock();
+        Reader& reader = GetReader_();
+
+        // The holder is read only if it is still the published one after it has been announced - a newer
+        // holder's publisher sees the announcement and keeps it, or we see the newer holder and try again
+        Holder* holder = _holder.load(std::memory_order_acquire);
+        while (holder) {
+            reader.hazard.store(holder, std::memory_order_seq_cst);
+            Holder* published = _holder.load(std::memory_order_seq_cst);
+            if (published == holder) {
+                break;
+            }
+            holder = published;
+        }
+        if (holder) {
+            std::shared_ptr<T> ptr = holder->instance.lock();
+            reader.hazard.store(nullptr, std::memory_order_release);
+            if (ptr) {
+                return ptr;
+            }
+        }
 
-        if (ptr.use_count() == 0) {
-            ptr = std::make_shared<T>(args...);
-            _instance = ptr;
+        std::lock_guard<std::mutex> lock(_holderMutex);
+
+        // Someone might have created it while we were waiting for the lock
+        holder = _holder.load(std::memory_order_relaxed);
+        if (holder) {
+            if (std::shared_ptr<T> ptr = holder->instance.lock()) {
+                return ptr;
+            }
         }
 
+        std::shared_ptr<T> ptr = std::make_shared<T>(args...);
+        _holders.push_back(std::make_unique<Holder>(Holder{ ptr }));
+        _holder.store(_holders.back().get(), std::memory_order_seq_cst);
+        ReclaimHolders_();
+
         return ptr;
     }
+    template <class T>
+    template <typename... Args>
+    [[maybe_unused]] const std::shared_ptr<T>& Singleton<T>::getCachedInstance(Args ...args) {
+        // While the cache holds the instance it can't expire, so there is nothing to revalidate
+        if (!_cachedInstance) {
+            _cachedInstance = getInstance(args...);
+        }
+
+        return _cachedInstance;
+    }
+    template <class T> [[maybe_unused]] void Singleton<T>::releaseCachedInstance() {
+        _cachedInstance.reset();
+    }
+    template <class T> [[maybe_unused]] size_t Singleton<T>::getHolderCount() {
+        std::lock_guard<std::mutex> lock(_holderMutex);
+
+        return _holders.size();
+    }
+
+    template <class T> typename Singleton<T>::Reader& Singleton<T>::GetReader_() {
+        if (!_readerSlot.reader) {
+            std::lock_guard<std::mutex> lock(_holderMutex);
+
+            // The readers of exited threads are reused, there are never more than threads alive at the same time
+            for (auto& reader : _readers) {
+                if (!reader->isUsed.load(std::memory_order_acquire)) {
+                    reader->isUsed.store(true, std::memory_order_relaxed);
+                    _readerSlot.reader = reader.get();
+                    break;
+                }
+            }
+            if (!_readerSlot.reader) {
+                _readers.push_back(std::make_unique<Reader>());
+                _readerSlot.reader = _readers.back().get();
+            }
+        }
+
+        return *_readerSlot.reader;
+    }
+    template <class T> void Singleton<T>::ReclaimHolders_() {
+        // Under _holderMutex, right after a new holder has been published
+        const Holder* current = _holder.load(std::memory_order_relaxed);
+        auto isRead = [](const Holder* holder) -> bool {
+            for (const auto& reader : _readers) {
+                if (reader->hazard.load(std::memory_order_seq_cst) == holder) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        _holders.erase(std::remove_if(_holders.begin(), _holders.end(), [current, &isRead](const std::unique_ptr<Holder>& holder) -> bool {
+            return (holder.get() != current) && !isRead(holder.get());
+        }), _holders.end());
+    }
 
 }
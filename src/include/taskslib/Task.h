@@ -1,11 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <chrono>
+#include <optional>
 
 #include "Types.h"
 #include "TaskOptions.h"
+#include "TasksMainThreadQueue.h"
 
 namespace TasksLib {
 
@@ -26,26 +29,64 @@ namespace TasksLib {
 		/* Sets the task up for another run through the task queue with a new set of options.
 		   This method can be used by the task callback to keep the task going.
 		   If Reschedule( ... ) is not called, the task is complete and is removed from the queue.
+		   It is meant to be called from the task's own callback - the new options are not guarded against other threads,
+		   they are only published to the queue when the callback returns.
 		*/
 		template <typename... Ts> void Reschedule(Ts&& ...opts);
+		/* Parks the task when its callback returns - it waits as TASK_SUSPENDED, off the timers and the workers, until
+		   TasksQueue::Unpark() puts it back on the queue. Like Reschedule(), it is meant to be called from the task's own
+		   callback, and the two go together - the task waits with the reschedule options and runs with them when unparked.
+		   Unpark() may come before the callback returns, the task goes straight back to the queue then.
+		*/
+        [[maybe_unused]] void Park();
+		/* What the Unpark() that woke the task up last has passed on */
+        [[maybe_unused]] [[nodiscard]] uint32_t GetParkResult() const;
 
 	protected:
-		std::mutex& GetTaskMutex_();
-
 		void Execute(TasksQueue* queue, const TaskPtr& task);
 
 	private:
-		TaskStatus	_status;
+		// The status is the task's state machine - the queue moves it along with compare-and-swap, whoever makes a
+		// transition owns the task for that stage. TasksQueue::Cancel() competes for the same transitions.
+		std::atomic<TaskStatus>	_status;
 		TaskOptions	_options;
 		TaskOptions	_rescheduleOptions;
-		bool		_doReschedule;
+		std::atomic<bool>	_doReschedule;				// Released after _rescheduleOptions are written
+		std::atomic<bool>	_isCancelled;				// Set after the status went to TASK_CANCELLED, lets the queues skip it cheaply
+		std::atomic<uint8_t>	_parkState;			// TaskParkState, Park() and TasksQueue::Unpark() race for it
+		std::atomic<uint32_t>	_parkResult;
+
+		// The queue's bookkeeping, so that it can find the task without searching for it
+		std::atomic<TasksQueue*>	_ownerQueue;		// The queue the task was added to last, written before its status leaves INIT / FINISHED
+		bool						_isScheduled;		// In the queue's scheduleMap, guarded by its schedulerMutex
+		scheduleMap::iterator		_scheduleIt;
+		scheduleMap::node_type		_scheduleNode;		// The timer node from the last wake up, reused by the next one instead of allocating
+		scheduleTimePoint			_periodDue;			// When the current run of a TaskPeriod task was due, min() until its first run
+		bool						_isRateHeld;		// Waiting for a token of its TaskRateClass, guarded by the queue's schedulerMutex
+		bool						_hasRateToken;		// Released by the rate limit, the next AddTask() doesn't take another token
+		rateHeldList::iterator		_rateHeldIt;
+		uint64_t					_indexedTag;		// Cancel tag the queue has indexed the task under, guarded by its cancelMutex
+		cancelTagList::iterator		_indexedTagIt;
+		std::atomic<uint64_t>		_indexedDedupKey;	// Dedup key the queue has indexed the task under, written under its cancelMutex
+		bool						_isDedupAdding;		// Indexed under its dedup key, but not queued yet - guarded by the queue's cancelMutex
+		bool						_isDedupReplaced;	// A DEDUP_REPLACE duplicate came meanwhile, cancelled once it is queued
+		TasksMainThreadQueue::Node	_mainThreadNode;	// Links the task in the queue's main thread lane
+		uint32_t					_lastWorker;		// Id of the worker thread that executed it last, 0 is none yet
+		size_t						_queuedBytes;		// What the queue has counted against its byte capacity for the task
+		std::shared_ptr<TaskGroupState>	_group;		// Set when TaskGroup::AddTask() is accepted, released when the task finishes
 
 	private:
-		std::mutex	_taskMutex;
+		bool Start_();
+		bool Transition_(TaskStatus from, TaskStatus to);
 		void ApplyReschedule_();
 		void ResetReschedule_();
+		void ReleaseExecutables_();
+		void LeaveGroup_();
 
 		friend class TasksQueue;
+		friend class TasksReadyQueue;
+		friend class TasksMainThreadQueue;
+		friend class TaskGroup;
         friend class TaskTest;			// To enable tests to call ApplyReschedule_() & ResetReschedule_(), which are called by TasksQueue
 	};
 
@@ -54,8 +95,6 @@ namespace TasksLib {
 
     // These have to be defined in the .h
     template <typename... Ts> void Task::Reschedule(Ts&& ...ts) {
-        std::lock_guard<std::mutex> lock(_taskMutex);
-
         _rescheduleOptions.SetOptions(std::forward<Ts>(ts)...);
         Reschedule();
     }
@@ -93,4 +132,56 @@ namespace TasksLib {
 
 		data_ = data;
 	}
+
+
+	// ====== TaskWithInlineData ========================================================
+
+	/*
+		Carries its data inside the task object - std::make_shared allocates both at once, and the accessors take no
+		lock and touch no reference count.
+
+		The data is not guarded. It belongs to whoever owns the task at the moment - the code that sets it up before
+		AddTask(), then the task's own callback, which never runs on two threads at once, and whoever looks at it after
+		the task has finished. The queue's hand-offs between them order the accesses. Use TaskWithData for data that
+		other threads touch while the task is on the queue.
+	 */
+	template <class T> class TaskWithInlineData : public Task {
+	public:
+		/* Creates the task without data, with the specified set of options */
+		template <typename... Ts> explicit TaskWithInlineData(Ts&& ...opts);
+		~TaskWithInlineData() override;
+
+		/* Constructs the data in place, destroying the data it had before */
+		template <typename... Args> T& EmplaceData(Args&& ...args);
+        [[maybe_unused]] void ResetData();
+
+        [[maybe_unused]] [[nodiscard]] bool HasData() const;
+		/* nullptr if there is no data */
+        [[maybe_unused]] [[nodiscard]] T* GetData();
+        [[maybe_unused]] [[nodiscard]] const T* GetData() const;
+
+	private:
+		std::optional<T>	data_;
+	};
+
+	template <class T> template <typename... Ts> TaskWithInlineData<T>::TaskWithInlineData(Ts&& ...opts)
+		: Task(std::forward<Ts>(opts)...)
+	{}
+	template <class T> TaskWithInlineData<T>::~TaskWithInlineData() = default;
+
+	template <class T> template <typename... Args> T& TaskWithInlineData<T>::EmplaceData(Args&& ...args) {
+		return data_.emplace(std::forward<Args>(args)...);
+	}
+	template <class T> [[maybe_unused]] void TaskWithInlineData<T>::ResetData() {
+		data_.reset();
+	}
+	template <class T> [[maybe_unused]] bool TaskWithInlineData<T>::HasData() const {
+		return data_.has_value();
+	}
+	template <class T> [[maybe_unused]] T* TaskWithInlineData<T>::GetData() {
+		return data_ ? &*data_ : nullptr;
+	}
+	template <class T> [[maybe_unused]] const T* TaskWithInlineData<T>::GetData() const {
+		return data_ ? &*data_ : nullptr;
+	}
 }
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <utility>
+
+#include "Types.h"
+#include "TaskOptions.h"
+#include "Task.h"
+#include "TasksQueue.h"
+
+namespace TasksLib {
+
+	/*
+		Coalesces tiny work items into batches, so that the queue handles one task per batch instead of one per item.
+
+		A batcher is a batch key - the items added to it within the window go to the queue as a single task, and its
+		BatchingExecutable gets all of them at once, in the order they were added. The first item of a batch adds the
+		task, delayed by the window, the items that come meanwhile only append to the batch. A zero window doesn't
+		delay the task, the batch takes whatever has been added until a worker picks it up - under load that is a lot,
+		when idle it is a single item without any extra latency. A batch that reaches maxItems goes to the queue right
+		away, it doesn't wait for the window.
+
+		Different batches of a batcher may execute in parallel on a queue with more than one thread. Batches hold on to
+		the batcher's state, the items added before the batcher is destroyed are still executed.
+	 */
+	template <class T> class TaskBatcher {
+	public:
+		using BatchingExecutable = std::function<void(TasksQueue* queue, std::vector<T>& items)>;
+
+		/* The options (priority, blocking, thread target, ...) apply to the batch tasks, the executable and the delay are the batcher's own */
+		template <typename... Ts> TaskBatcher(TasksQueue* queue, BatchingExecutable executable, TaskDelay window, size_t maxItems, Ts&& ...opts);
+
+		TaskBatcher(const TaskBatcher&) = delete;
+		TaskBatcher& operator=(const TaskBatcher&) = delete;
+
+		/* Adds the item to the current batch. Returns false if the queue has refused the batch task (it is not
+		   initialized, or at capacity), the items stay with the batcher then and go with the next batch. */
+        [[maybe_unused]] bool Add(T item);
+		/* Sends the current batch to the queue without waiting for the window */
+        [[maybe_unused]] bool Flush();
+		/* Items added but not taken by a batch task yet */
+        [[maybe_unused]] [[nodiscard]] size_t GetPending() const;
+
+	private:
+		struct State {
+			TasksQueue* queue;
+			BatchingExecutable executable;
+			TaskOptions options;
+			TaskDelay window;
+			size_t maxItems;
+
+			mutable std::mutex mutex;
+			std::vector<T> items;
+			bool isScheduled = false;				// A task is going to take the items, guarded by the mutex
+			uint64_t windowGeneration = 0;			// Of the latest window task, guarded by the mutex
+		};
+		/* Held by a window task's callback. The queue releases the callback when it cancels or drops the task - with a
+		   cancel tag, by the overflow policy, on shutdown - and the batcher schedules a new window on the next Add() then.
+		   The generation tells the window that has gone from one that has replaced it. */
+		struct Window {
+			std::shared_ptr<State> state;
+			uint64_t generation;
+
+			Window(std::shared_ptr<State> windowState, uint64_t windowGeneration);
+			~Window();
+		};
+		std::shared_ptr<State> _state;
+
+		bool AddBatch_(std::unique_lock<std::mutex>& lock);
+		bool AddWindow_(std::unique_lock<std::mutex>& lock);
+	};
+
+	// ==========================================================================
+
+	template <class T> template <typename... Ts> TaskBatcher<T>::TaskBatcher(TasksQueue* queue, BatchingExecutable executable, const TaskDelay window, const size_t maxItems, Ts&& ...opts)
+		: _state(std::make_shared<State>())
+	{
+		_state->queue = queue;
+		_state->executable = std::move(executable);
+		_state->options = TaskOptions(std::forward<Ts>(opts)...);
+		_state->window = window;
+		_state->maxItems = (maxItems > 0) ? maxItems : 1;
+	}
+
+	template <class T> TaskBatcher<T>::Window::Window(std::shared_ptr<State> windowState, const uint64_t windowGeneration)
+		: state(std::move(windowState))
+		, generation(windowGeneration)
+	{}
+	template <class T> TaskBatcher<T>::Window::~Window() {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		if (state->windowGeneration == generation) {
+			state->isScheduled = false;
+		}
+	}
+
+	template <class T> [[maybe_unused]] bool TaskBatcher<T>::Add(T item) {
+		std::unique_lock<std::mutex> lock(_state->mutex);
+
+		_state->items.push_back(std::move(item));
+		if (_state->items.size() >= _state->maxItems) {
+			return AddBatch_(lock);
+		}
+		if (!_state->isScheduled) {
+			return AddWindow_(lock);
+		}
+		return true;
+	}
+	template <class T> [[maybe_unused]] bool TaskBatcher<T>::Flush() {
+		std::unique_lock<std::mutex> lock(_state->mutex);
+
+		if (_state->items.empty()) {
+			return true;
+		}
+		return AddBatch_(lock);
+	}
+	template <class T> [[maybe_unused]] size_t TaskBatcher<T>::GetPending() const {
+		std::lock_guard<std::mutex> lock(_state->mutex);
+
+		return _state->items.size();
+	}
+
+	/* Takes the items into a task of their own, the window's task finds fewer (or none) when it runs */
+	template <class T> bool TaskBatcher<T>::AddBatch_(std::unique_lock<std::mutex>& lock) {
+		auto batch = std::make_shared<std::vector<T>>();
+		batch->reserve(_state->maxItems);
+		batch->swap(_state->items);
+		lock.unlock();
+
+		const std::shared_ptr<State> state = _state;
+		const bool isAdded = state->queue->AddTask(std::make_shared<Task>(
+			state->options,
+			(TaskExecutable)[state, batch](TasksQueue* queue, const TaskPtr&) -> void {
+				state->executable(queue, *batch);
+			}
+		));
+		if (!isAdded) {
+			// Back in front of whatever has been added meanwhile
+			lock.lock();
+			batch->insert(batch->end(), std::make_move_iterator(state->items.begin()), std::make_move_iterator(state->items.end()));
+			batch->swap(state->items);
+		}
+		return isAdded;
+	}
+	template <class T> bool TaskBatcher<T>::AddWindow_(std::unique_lock<std::mutex>& lock) {
+		_state->isScheduled = true;
+		auto window = std::make_shared<Window>(_state, ++_state->windowGeneration);
+		lock.unlock();
+
+		const std::shared_ptr<State> state = _state;
+		return state->queue->AddTask(std::make_shared<Task>(
+			state->options,
+			(TaskExecutable)[window](TasksQueue* queue, const TaskPtr&) -> void {
+				const std::shared_ptr<State>& state = window->state;
+				std::vector<T> items;
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+					items.swap(state->items);
+					state->isScheduled = false;
+				}
+				if (!items.empty()) {
+					state->executable(queue, items);
+				}
+			},
+			state->window
+		));
+	}
+
+}
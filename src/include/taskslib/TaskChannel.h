@@ -0,0 +1,222 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <utility>
+
+#include "Types.h"
+#include "Task.h"
+#include "TasksQueue.h"
+
+namespace TasksLib {
+
+	enum TaskChannelWait {
+		CHANNEL_PARKED,				// The task is parked, it runs again when the channel is ready for it
+		CHANNEL_READY,				// Ready already, the task may try again right away
+		CHANNEL_CLOSED,				// Closed - nothing can be sent, or nothing is left to receive
+	};
+
+	/*
+		A bounded multi-producer, multi-consumer queue of items between tasks, that never blocks a worker thread.
+
+		TrySend() and TryReceive() don't wait. When they fail, a task calls WaitToSend() or WaitToReceive() and returns
+		from its callback - it is parked (see Task::Park()) and put back on its queue as soon as the channel has room or
+		an item for it, one waiting task per item or free slot. Threads outside the queues can use Send() and Receive(),
+		which block the calling thread instead.
+
+		Close() lets the receivers drain what is left, then their waits end with CHANNEL_CLOSED. The channel has to
+		outlive the tasks that wait on it - keep it in a shared_ptr that they hold on to.
+	 */
+	template <class T> class TaskChannel {
+	public:
+		explicit TaskChannel(size_t capacity);
+
+		TaskChannel(const TaskChannel&) = delete;
+		TaskChannel& operator=(const TaskChannel&) = delete;
+
+		/* The item is moved from only if it is sent. Fails if the channel is full or closed. */
+        [[maybe_unused]] bool TrySend(T&& item);
+        [[maybe_unused]] std::optional<T> TryReceive();
+		/* Park the task from its callback until the channel has room / an item, see TaskChannelWait */
+        [[maybe_unused]] TaskChannelWait WaitToSend(TasksQueue* queue, const TaskPtr& task);
+        [[maybe_unused]] TaskChannelWait WaitToReceive(TasksQueue* queue, const TaskPtr& task);
+
+		/* Blocking versions for threads that are not the queue's workers, Send() fails if the channel gets closed
+		   and Receive() returns nothing once it is closed and empty */
+        [[maybe_unused]] bool Send(T&& item);
+        [[maybe_unused]] std::optional<T> Receive();
+
+		/* Nothing can be sent afterwards, all waiting tasks and threads are woken up */
+        [[maybe_unused]] void Close();
+        [[maybe_unused]] [[nodiscard]] bool IsClosed() const;
+        [[maybe_unused]] [[nodiscard]] size_t GetSize() const;
+        [[maybe_unused]] [[nodiscard]] size_t GetCapacity() const;
+
+	private:
+		struct Waiter {
+			TasksQueue* queue;
+			TaskPtr task;
+		};
+
+		const size_t _capacity;
+		mutable std::mutex _mutex;
+		std::condition_variable _condition;			// For Send() and Receive()
+		std::deque<T> _items;
+		std::deque<Waiter> _senders;				// Parked tasks, in the order they came
+		std::deque<Waiter> _receivers;
+		uint32_t _blockedThreads;
+		bool _isClosed;
+
+		void Sent_(std::unique_lock<std::mutex>& lock);
+		void Received_(std::unique_lock<std::mutex>& lock);
+		void Wake_(std::unique_lock<std::mutex>& lock, std::deque<Waiter>& waiters);
+	};
+
+	// ==========================================================================
+
+	template <class T> TaskChannel<T>::TaskChannel(const size_t capacity)
+		: _capacity((capacity > 0) ? capacity : 1)
+		, _blockedThreads(0)
+		, _isClosed(false)
+	{}
+
+	template <class T> [[maybe_unused]] bool TaskChannel<T>::TrySend(T&& item) {
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		if (_isClosed || (_items.size() >= _capacity)) {
+			return false;
+		}
+		_items.push_back(std::move(item));
+		Sent_(lock);
+		return true;
+	}
+	template <class T> [[maybe_unused]] std::optional<T> TaskChannel<T>::TryReceive() {
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		if (_items.empty()) {
+			return std::nullopt;
+		}
+		std::optional<T> item(std::move(_items.front()));
+		_items.pop_front();
+		Received_(lock);
+		return item;
+	}
+
+	template <class T> [[maybe_unused]] TaskChannelWait TaskChannel<T>::WaitToSend(TasksQueue* queue, const TaskPtr& task) {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_isClosed) {
+			return CHANNEL_CLOSED;
+		}
+		if (_items.size() < _capacity) {
+			return CHANNEL_READY;
+		}
+		// Parked under the lock, so that a receiver can't wake it up before it is parked
+		task->Park();
+		_senders.push_back(Waiter{ queue, task });
+		return CHANNEL_PARKED;
+	}
+	template <class T> [[maybe_unused]] TaskChannelWait TaskChannel<T>::WaitToReceive(TasksQueue* queue, const TaskPtr& task) {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (!_items.empty()) {
+			return CHANNEL_READY;
+		}
+		if (_isClosed) {
+			return CHANNEL_CLOSED;
+		}
+		task->Park();
+		_receivers.push_back(Waiter{ queue, task });
+		return CHANNEL_PARKED;
+	}
+
+	template <class T> [[maybe_unused]] bool TaskChannel<T>::Send(T&& item) {
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		++_blockedThreads;
+		_condition.wait(lock, [this] { return _isClosed || (_items.size() < _capacity); });
+		--_blockedThreads;
+		if (_isClosed) {
+			return false;
+		}
+		_items.push_back(std::move(item));
+		Sent_(lock);
+		return true;
+	}
+	template <class T> [[maybe_unused]] std::optional<T> TaskChannel<T>::Receive() {
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		++_blockedThreads;
+		_condition.wait(lock, [this] { return _isClosed || !_items.empty(); });
+		--_blockedThreads;
+		if (_items.empty()) {
+			return std::nullopt;
+		}
+		std::optional<T> item(std::move(_items.front()));
+		_items.pop_front();
+		Received_(lock);
+		return item;
+	}
+
+	template <class T> [[maybe_unused]] void TaskChannel<T>::Close() {
+		std::deque<Waiter> waiters;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_isClosed) {
+				return;
+			}
+			_isClosed = true;
+			waiters.swap(_senders);
+			waiters.insert(waiters.end(), std::make_move_iterator(_receivers.begin()), std::make_move_iterator(_receivers.end()));
+			_receivers.clear();
+		}
+
+		_condition.notify_all();
+		for (const Waiter& waiter : waiters) {
+			waiter.queue->Unpark(waiter.task);
+		}
+	}
+	template <class T> [[maybe_unused]] bool TaskChannel<T>::IsClosed() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _isClosed;
+	}
+	template <class T> [[maybe_unused]] size_t TaskChannel<T>::GetSize() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		return _items.size();
+	}
+	template <class T> [[maybe_unused]] size_t TaskChannel<T>::GetCapacity() const {
+		return _capacity;
+	}
+
+	template <class T> void TaskChannel<T>::Sent_(std::unique_lock<std::mutex>& lock) {
+		if (_blockedThreads > 0) {
+			_condition.notify_all();
+		}
+		Wake_(lock, _receivers);
+	}
+	template <class T> void TaskChannel<T>::Received_(std::unique_lock<std::mutex>& lock) {
+		if (_blockedThreads > 0) {
+			_condition.notify_all();
+		}
+		Wake_(lock, _senders);
+	}
+	/* Wakes the first of the waiting tasks up, the next one if it is gone meanwhile (cancelled) */
+	template <class T> void TaskChannel<T>::Wake_(std::unique_lock<std::mutex>& lock, std::deque<Waiter>& waiters) {
+		while (!waiters.empty()) {
+			Waiter waiter = std::move(waiters.front());
+			waiters.pop_front();
+
+			lock.unlock();
+			const bool isWoken = waiter.queue->Unpark(waiter.task);
+			lock.lock();
+			if (isWoken) {
+				return;
+			}
+		}
+	}
+
+}
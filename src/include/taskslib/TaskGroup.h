@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+
+#include "Types.h"
+
+namespace TasksLib {
+
+	/* The part of a TaskGroup its tasks hold on to, so that a task may finish after the group is gone */
+	class TaskGroupState {
+	public:
+		TaskGroupState();
+
+		void Acquire();
+		void Release();
+
+	private:
+		std::atomic<uint32_t> _pending;
+		std::atomic<uint64_t> _wakeups;			// Bumped when the queue gets a task the waiters may execute, under waitMutex
+		std::mutex _waitMutex;
+		std::condition_variable _waitCondition;
+
+		friend class TaskGroup;
+		friend class TasksQueue;
+	};
+
+	/*
+		Waits for a batch of tasks without taking a thread away from the queue.
+
+		Tasks added through the group go to its queue as usual and count as pending until they finish - after their
+		last run if they reschedule, or when they are cancelled. Wait() executes the queue's ready tasks on the calling
+		thread meanwhile, so a worker that waits for the tasks it has forked keeps working on them instead of idling or
+		deadlocking a queue with few threads. It only sleeps when there is nothing to execute - the rest of the group
+		is executing elsewhere, suspended or waiting for the main thread - and it wakes up when the group finishes or
+		a task is queued. On a non-blocking worker it doesn't execute blocking tasks, like the worker wouldn't.
+
+		Main thread tasks are executed only by TasksQueue::Update(), waiting for them on the main thread never ends.
+	 */
+	class TaskGroup {
+	public:
+		explicit TaskGroup(TasksQueue* queue);
+		~TaskGroup();
+
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		/* Adds the task to the queue and, once the queue has accepted it, to the group. A task can be in one group at a
+		   time - like TasksQueue::TryAddTask(), one that is already in flight is refused. */
+        [[maybe_unused]] bool AddTask(const TaskPtr& task);
+        [[maybe_unused]] [[nodiscard]] uint32_t GetPending() const;
+
+		/* Executes the queue's tasks until all tasks of the group have finished */
+        [[maybe_unused]] void Wait();
+		/* Same as Wait(), but gives up after the timeout, returns true if the group has finished */
+        [[maybe_unused]] bool WaitFor(std::chrono::milliseconds timeout);
+
+	private:
+		TasksQueue* _queue;
+		std::shared_ptr<TaskGroupState> _state;
+
+		bool WaitUntil(scheduleTimePoint deadline);
+	};
+
+}
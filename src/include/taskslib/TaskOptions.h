@@ -13,6 +13,13 @@ namespace TasksLib {
         bool			isMainThread;
         TaskExecutable	executable;
         TaskDelay		suspendTime;
+        TaskCancelTag	cancelTag;
+        TaskDeadline	deadline;
+        TaskAffinity	affinity;
+        TaskPeriod		period;
+        TaskRateClass	rateClass;
+        TaskFootprint	footprint;
+        TaskDedupKey	dedupKey;
 
     public:
 		/* Creates TaskOptions with the default set of values */
@@ -53,6 +60,13 @@ namespace TasksLib {
         [[maybe_unused]] void SetOption_(const TaskExecutable& executable);
         [[maybe_unused]] void SetOption_(TaskExecutable&& executable);
         [[maybe_unused]] void SetOption_(const TaskDelay& ms);
+        [[maybe_unused]] void SetOption_(const TaskCancelTag& tag);
+        [[maybe_unused]] void SetOption_(const TaskDeadline& deadline);
+        [[maybe_unused]] void SetOption_(const TaskAffinity& affinity);
+        [[maybe_unused]] void SetOption_(const TaskPeriod& period);
+        [[maybe_unused]] void SetOption_(const TaskRateClass& rateClass);
+        [[maybe_unused]] void SetOption_(const TaskFootprint& footprint);
+        [[maybe_unused]] void SetOption_(const TaskDedupKey& dedupKey);
 	};
 
 
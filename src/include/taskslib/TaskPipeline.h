@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "Types.h"
+#include "TaskOptions.h"
+#include "Task.h"
+#include "TaskGroup.h"
+#include "TaskChannel.h"
+
+namespace TasksLib {
+
+	/*
+		Connects TaskChannels with stages of tasks - decode -> transform -> encode - and waits for them to finish.
+
+		A stage takes the items from its input channel, passes each to its function and sends what that returns to its
+		output channel. It runs as concurrency tasks on the queue, so a stage with a concurrency of 4 handles up to 4
+		items at the same time, and the items may come out of it in a different order. The last stage has no output.
+
+		The stage tasks park on the channels instead of waiting on a worker - an empty input parks the stage until
+		something comes, a full output parks it until the next stage takes something. A slow stage fills the channels
+		before it and the pipeline's producer ends up waiting on the first channel, that is the backpressure, and the
+		items in flight are bounded by the channels' capacities and the stages' concurrency.
+
+		Closing the first channel finishes the pipeline - each stage finishes when its input is closed and drained, and
+		its last task closes the output. Wait() returns when all stages have finished.
+
+		Usage:
+			auto frames = std::make_shared<TaskChannel<Frame>>(16);
+			auto images = std::make_shared<TaskChannel<Image>>(16);
+			TaskPipeline pipeline(&queue);
+			pipeline.AddStage<Frame, Image>(frames, images, decode, 2);
+			pipeline.AddStage<Image>(images, encode, 4);
+			for (...) frames->Send(std::move(frame));
+			frames->Close();
+			pipeline.Wait();
+	 */
+	class TaskPipeline {
+	public:
+		template <class In, class Out> using StageFunction = std::function<Out(TasksQueue* queue, In& item)>;
+
+		explicit TaskPipeline(TasksQueue* queue);
+
+		TaskPipeline(const TaskPipeline&) = delete;
+		TaskPipeline& operator=(const TaskPipeline&) = delete;
+
+		/* Adds a stage of concurrency tasks from the input to the output channel. The options (priority, blocking, ...)
+		   apply to the stage's tasks. Returns false if the queue has refused them. */
+		template <class In, class Out, typename... Ts> bool AddStage(std::shared_ptr<TaskChannel<In>> input, std::shared_ptr<TaskChannel<Out>> output,
+																	  StageFunction<In, Out> function, uint32_t concurrency, Ts&& ...opts);
+		/* Adds the last stage, without an output */
+		template <class In, typename... Ts> bool AddStage(std::shared_ptr<TaskChannel<In>> input, StageFunction<In, void> function, uint32_t concurrency, Ts&& ...opts);
+
+		/* Stage tasks that have not finished yet */
+        [[maybe_unused]] [[nodiscard]] uint32_t GetPending() const;
+		/* Executes the queue's tasks until all stages have finished, see TaskGroup::Wait() */
+        [[maybe_unused]] void Wait();
+        [[maybe_unused]] bool WaitFor(std::chrono::milliseconds timeout);
+
+	private:
+		static constexpr int STAGE_RUN_ITEMS = 64;			// Items a stage task handles in a row before it lets other tasks have the worker
+
+		template <class In, class Out> struct Stage {
+			std::shared_ptr<TaskChannel<In>> input;
+			std::shared_ptr<TaskChannel<Out>> output;			// nullptr for the last stage
+			StageFunction<In, Out> function;
+			std::atomic<uint32_t> running;
+		};
+
+		TasksQueue* _queue;
+		TaskGroup _group;
+
+		template <class In, class Out, typename... Ts> bool AddStage_(std::shared_ptr<Stage<In, Out>> stage, uint32_t concurrency, Ts&& ...opts);
+		template <class In, class Out> static void RunStage_(TasksQueue* queue, const TaskPtr& task, Stage<In, Out>& stage);
+	};
+
+	// ==========================================================================
+
+	inline TaskPipeline::TaskPipeline(TasksQueue* queue)
+		: _queue(queue)
+		, _group(queue)
+	{}
+
+	template <class In, class Out, typename... Ts> bool TaskPipeline::AddStage(std::shared_ptr<TaskChannel<In>> input, std::shared_ptr<TaskChannel<Out>> output,
+																				StageFunction<In, Out> function, const uint32_t concurrency, Ts&& ...opts) {
+		if (!output) {
+			return false;
+		}
+		auto stage = std::make_shared<Stage<In, Out>>();
+		stage->input = std::move(input);
+		stage->output = std::move(output);
+		stage->function = std::move(function);
+		return AddStage_(std::move(stage), concurrency, std::forward<Ts>(opts)...);
+	}
+	template <class In, typename... Ts> bool TaskPipeline::AddStage(std::shared_ptr<TaskChannel<In>> input, StageFunction<In, void> function,
+																	 const uint32_t concurrency, Ts&& ...opts) {
+		auto stage = std::make_shared<Stage<In, void>>();
+		stage->input = std::move(input);
+		stage->function = std::move(function);
+		return AddStage_(std::move(stage), concurrency, std::forward<Ts>(opts)...);
+	}
+
+    [[maybe_unused]] inline uint32_t TaskPipeline::GetPending() const {
+		return _group.GetPending();
+	}
+    [[maybe_unused]] inline void TaskPipeline::Wait() {
+		_group.Wait();
+	}
+    [[maybe_unused]] inline bool TaskPipeline::WaitFor(const std::chrono::milliseconds timeout) {
+		return _group.WaitFor(timeout);
+	}
+
+	template <class In, class Out, typename... Ts> bool TaskPipeline::AddStage_(std::shared_ptr<Stage<In, Out>> stage, const uint32_t concurrency, Ts&& ...opts) {
+		if (!_queue || !stage->input || !stage->function || (concurrency == 0)) {
+			return false;
+		}
+
+		// An output item that is waiting for room in the output channel stays with the task that has made it
+		using StageTask = std::conditional_t<std::is_void_v<Out>, Task, TaskWithInlineData<Out>>;
+		const TaskOptions options(std::forward<Ts>(opts)...);
+		stage->running = concurrency;
+
+		bool isAdded = true;
+		for (uint32_t i = 0; i < concurrency; ++i) {
+			auto task = std::make_shared<StageTask>(
+				options,
+				(TaskExecutable)[stage](TasksQueue* queue, const TaskPtr& task) -> void {
+					RunStage_(queue, task, *stage);
+				}
+			);
+			if (!_group.AddTask(task)) {
+				isAdded = false;
+				if (--stage->running == 0) {
+					if constexpr (!std::is_void_v<Out>) {
+						stage->output->Close();
+					}
+				}
+			}
+		}
+		return isAdded;
+	}
+
+	template <class In, class Out> void TaskPipeline::RunStage_(TasksQueue* queue, const TaskPtr& task, Stage<In, Out>& stage) {
+		for (int i = 0; i < STAGE_RUN_ITEMS; ++i) {
+			if constexpr (!std::is_void_v<Out>) {
+				auto& self = static_cast<TaskWithInlineData<Out>&>(*task);
+				if (Out* pending = self.GetData()) {
+					if (!stage.output->TrySend(std::move(*pending))) {
+						const TaskChannelWait wait = stage.output->WaitToSend(queue, task);
+						if (wait == CHANNEL_PARKED) {
+							return;
+						}
+						if (wait == CHANNEL_READY) {
+							continue;
+						}
+						// Closed from the outside, nobody takes the item anymore
+					}
+					self.ResetData();
+				}
+			}
+
+			std::optional<In> item = stage.input->TryReceive();
+			if (!item) {
+				const TaskChannelWait wait = stage.input->WaitToReceive(queue, task);
+				if (wait == CHANNEL_PARKED) {
+					return;
+				}
+				if (wait == CHANNEL_READY) {
+					continue;
+				}
+
+				// Drained, the last task of the stage lets the next stage know
+				if (stage.running.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					if constexpr (!std::is_void_v<Out>) {
+						stage.output->Close();
+					}
+				}
+				return;
+			}
+
+			if constexpr (std::is_void_v<Out>) {
+				stage.function(queue, *item);
+			} else {
+				static_cast<TaskWithInlineData<Out>&>(*task).EmplaceData(stage.function(queue, *item));
+			}
+		}
+
+		// Gives the worker to the other tasks for a moment, the stage goes on where it has left off
+		task->Reschedule();
+	}
+
+}
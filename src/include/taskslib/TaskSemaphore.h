@@ -0,0 +1,73 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <cstdint>
+
+#include "Types.h"
+
+namespace TasksLib {
+
+	/*
+		A counting semaphore for tasks - a task that can't get a permit is parked instead of blocking its worker thread.
+
+		A task calls Acquire() from its callback. If a permit is free the task holds it right away, otherwise it is parked
+		(see Task::Park()) and Release() hands the permit over to it and puts it back on the queue - the permits go to
+		the waiting tasks in the order they came. Either way the task holds the permit in the run after the callback,
+		so the usual way is to Reschedule() the task to the step that needs the permit and then Acquire():
+
+			task->Reschedule((TaskExecutable)CriticalStep);		// Calls semaphore.Release() when it is done
+			semaphore.Acquire(queue, task);
+
+		Whoever holds a permit releases it, there is no owner. A cancelled task that waits for a permit is passed over,
+		but one cancelled while it holds a permit doesn't give it back. The semaphore has to outlive the tasks waiting for it.
+	 */
+	class TaskSemaphore {
+	public:
+		explicit TaskSemaphore(uint32_t permits);
+
+		TaskSemaphore(const TaskSemaphore&) = delete;
+		TaskSemaphore& operator=(const TaskSemaphore&) = delete;
+
+		/* Takes a permit for the task, returns true if it has got one right away and false if the task is parked until it does */
+        [[maybe_unused]] bool Acquire(TasksQueue* queue, const TaskPtr& task);
+		/* Takes a permit if there is one free, without waiting - from a task or any other thread */
+        [[maybe_unused]] bool TryAcquire();
+		/* Gives the permit to the first task waiting for one, or back to the semaphore */
+        [[maybe_unused]] void Release();
+
+        [[maybe_unused]] [[nodiscard]] uint32_t GetAvailable() const;
+        [[maybe_unused]] [[nodiscard]] size_t GetWaiting() const;
+
+	private:
+		struct Waiter {
+			TasksQueue* queue;
+			TaskPtr task;
+		};
+
+		mutable std::mutex _mutex;
+		uint32_t _available;				// Always 0 while tasks are waiting, Release() hands the permits over directly
+		std::deque<Waiter> _waiters;
+	};
+
+	/* A TaskSemaphore with a single permit, see there how tasks wait for it */
+	class TaskMutex {
+	public:
+		TaskMutex();
+
+		TaskMutex(const TaskMutex&) = delete;
+		TaskMutex& operator=(const TaskMutex&) = delete;
+
+		/* Locks the mutex for the task, returns true if it has right away and false if the task is parked until it has */
+        [[maybe_unused]] bool Lock(TasksQueue* queue, const TaskPtr& task);
+        [[maybe_unused]] bool TryLock();
+        [[maybe_unused]] void Unlock();
+
+        [[maybe_unused]] [[nodiscard]] bool IsLocked() const;
+        [[maybe_unused]] [[nodiscard]] size_t GetWaiting() const;
+
+	private:
+		TaskSemaphore _semaphore;
+	};
+
+}
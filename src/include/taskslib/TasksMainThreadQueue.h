@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+
+#include "Types.h"
+
+namespace TasksLib {
+
+	/*
+		The tasks waiting for the main thread, in order of submission.
+
+		Any number of threads may push at the same time without locking, only one thread at a time may take tasks out -
+		the one that calls TasksQueue::Update(). The queue is intrusive: every task carries its own node, so pushing
+		doesn't allocate. Only a task that is already in a main thread lane when it's pushed gets a node allocated for it.
+		While a task is in the queue its node holds a reference to it, taking the task out releases it.
+		A push that is still in progress can make Pop() return nullptr early, the task then comes out on the next call.
+	 */
+	class TasksMainThreadQueue {
+	public:
+		struct Node {
+			Node();
+
+			std::atomic<Node*>	next;
+			TaskPtr				task;
+			std::atomic<bool>	isLinked;		// The task's own node is in a queue
+			bool				isAllocated;	// Pushed in place of the task's own node, deleted when taken out
+		};
+
+		TasksMainThreadQueue();
+		~TasksMainThreadQueue();
+
+		TasksMainThreadQueue(const TasksMainThreadQueue&) = delete;
+		TasksMainThreadQueue& operator=(const TasksMainThreadQueue&) = delete;
+
+		void Push(const TaskPtr& task);
+		TaskPtr Pop();
+
+	private:
+		std::atomic<Node*>	_head;		// Last pushed, producers swap themselves in here
+		Node*				_tail;		// Next to pop, only touched by the consumer
+		Node				_stub;		// Keeps the list from ever being empty
+
+		void PushNode(Node* node);
+	};
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+/*
+	Compile-time hooks into the lifecycle of the tasks.
+
+	Build the library with TASKSLIB_OBSERVER set to a header (the CMake cache variable of the same name, it becomes a
+	public compile definition of TasksLib) that defines TasksLib::TasksObserver with the same static functions as the
+	one below. The queue calls them directly, so an observer that records a few counters costs just that, and the
+	default one - empty inline functions - compiles to nothing.
+
+	The hooks are called on the thread that made the transition, outside of the queue's locks. Other threads may have
+	moved the task on already by the time a hook runs - OnEnqueue() may come after the task has started executing -
+	so they should only look at the task's identity and options. They must not add, cancel or wait for tasks.
+
+	Each run of a task goes OnDequeue(), OnExecuteBegin(), OnExecuteEnd(), then OnReschedule() if it is going to run
+	again. OnComplete() or OnCancel() comes once, when the queue is done with the task. OnExecuteBegin() and
+	OnExecuteEnd() are skipped when the task has been cancelled before it could run.
+ */
+#if defined(TASKSLIB_OBSERVER)
+#include TASKSLIB_OBSERVER
+#else
+
+namespace TasksLib {
+
+	class Task;
+	class TasksQueue;
+
+	struct TasksObserver {
+		static void OnEnqueue([[maybe_unused]] const TasksQueue* queue, [[maybe_unused]] const Task& task) {}			// Ready to execute, on the queue or the main thread lane
+		static void OnDequeue([[maybe_unused]] const TasksQueue* queue, [[maybe_unused]] const Task& task) {}			// Taken by a thread to execute
+		static void OnExecuteBegin([[maybe_unused]] const TasksQueue* queue, [[maybe_unused]] const Task& task) {}
+		static void OnExecuteEnd([[maybe_unused]] const TasksQueue* queue, [[maybe_unused]] const Task& task) {}
+		static void OnSuspend([[maybe_unused]] const TasksQueue* queue, [[maybe_unused]] const Task& task) {}			// Delayed, or held by a rate limit
+		static void OnResume([[maybe_unused]] const TasksQueue* queue, [[maybe_unused]] const Task& task) {}
+		static void OnReschedule([[maybe_unused]] const TasksQueue* queue, [[maybe_unused]] const Task& task) {}		// Including the next period of a periodic task
+		static void OnComplete([[maybe_unused]] const TasksQueue* queue, [[maybe_unused]] const Task& task) {}
+		static void OnCancel([[maybe_unused]] const TasksQueue* queue, [[maybe_unused]] const Task& task) {}			// Cancelled, or dropped by the queue
+	};
+
+}
+
+#endif
@@ -9,6 +9,9 @@
 #include <cstdint>
 
 #include "Types.h"
+#include "TaskOptions.h"
+#include "TasksReadyQueue.h"
+#include "TasksMainThreadQueue.h"
 
 namespace TasksLib {
 
@@ -20,6 +23,36 @@ namespace TasksLib {
 			, resumed(0)
 			, waiting(0)
 			, total(0)
+			, cancelled(0)
+			, deadlineMissed(0)
+			, deadlineDropped(0)
+			, executedLocal(0)
+			, executedMigrated(0)
+			, periodsSkipped(0)
+			, throttled(0)
+			, overflowRejected(0)
+			, overflowDropped(0)
+			, deduplicated(0)
+			, bytes(0)
+		{}
+		template<typename U> TasksQueuePerformanceStats(const TasksQueuePerformanceStats<U>& other)		// Implicit, like the conversions of the numbers themselves
+			: added(static_cast<T>(other.added))
+			, completed(static_cast<T>(other.completed))
+			, suspended(static_cast<T>(other.suspended))
+			, resumed(static_cast<T>(other.resumed))
+			, waiting(static_cast<T>(other.waiting))
+			, total(static_cast<T>(other.total))
+			, cancelled(static_cast<T>(other.cancelled))
+			, deadlineMissed(static_cast<T>(other.deadlineMissed))
+			, deadlineDropped(static_cast<T>(other.deadlineDropped))
+			, executedLocal(static_cast<T>(other.executedLocal))
+			, executedMigrated(static_cast<T>(other.executedMigrated))
+			, periodsSkipped(static_cast<T>(other.periodsSkipped))
+			, throttled(static_cast<T>(other.throttled))
+			, overflowRejected(static_cast<T>(other.overflowRejected))
+			, overflowDropped(static_cast<T>(other.overflowDropped))
+			, deduplicated(static_cast<T>(other.deduplicated))
+			, bytes(static_cast<T>(other.bytes))
 		{}
 
 		// accumulating between resets
@@ -30,18 +63,43 @@ namespace TasksLib {
 		// current (does not reset)
 		T waiting;			// Tasks waiting in suspended state
 		T total;			// Total tasks in the queue
+		// accumulating between resets
+		T cancelled;		// Tasks removed by Cancel() or CancelTag()
+		T deadlineMissed;	// Tasks that started executing after their deadline
+		T deadlineDropped;	// Tasks not executed because of DEADLINE_MISS_DROP
+		T executedLocal;	// Rescheduled tasks the worker that ran them kept and ran again
+		T executedMigrated;	// Tasks a worker ran after a different worker had run them
+		T periodsSkipped;	// Runs of TaskPeriod tasks dropped by OVERRUN_SKIP
+		T throttled;		// Tasks held back by the rate limit of their TaskRateClass
+		T overflowRejected;	// Tasks TryAddTask() refused because the queue was at its capacity
+		T overflowDropped;	// Tasks OVERFLOW_DROP_OLDEST cancelled to make room
+		T deduplicated;		// Tasks merged by their TaskDedupKey - the new ones dropped and the pending ones replaced
+		// current (does not reset)
+		T bytes;			// Approximate memory of the tasks in the queue, as counted against Capacity::maxBytes - 0 without it
 	};
 
 	class TasksQueue {
     private:
-        std::atomic<bool> _isInitialized;
+        // Read by every task, written rarely - apart from the counters that every task writes
+        alignas(CACHE_LINE_SIZE) std::atomic<bool> _isInitialized;
         std::atomic<bool> _isShuttingDown;
-        std::atomic<uint32_t> _runningPriority;
-
         uint16_t _numNonBlockingThreads;
-        TasksQueuePerformanceStats<std::atomic<std::int32_t>> _stats;
+        TasksWorkerPool* _pool;             // Set when the queue is a lane of a shared pool and has no threads of its own
 
-        // Mutexes lock order is - (Task->dataMutex), initMutex, schedulerMutex, tasksMutex, mtTasksMutex
+        alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> _runningPriority;
+
+        // The counters are split into shards, a thread only writes to its own (unless there are more threads than
+        // shards), and GetPerformanceStats() sums them up. Depth and memory have to be exact for the capacity limits,
+        // they are the only counters all threads share - and only when the queue has the limit, see ReserveCapacity().
+        using StatsCounters = TasksQueuePerformanceStats<std::atomic<std::int64_t>>;
+        struct alignas(CACHE_LINE_SIZE) StatsShard {
+            StatsCounters counters;
+        };
+        std::unique_ptr<StatsShard[]> _statsShards;
+        alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> _total;
+        std::atomic<std::int64_t> _bytes;
+
+        // Mutexes lock order is - initMutex, schedulerMutex, tasksMutex, cancelMutex, capacityMutex
         std::mutex _initMutex;				// To ensure that calling Initialize() and/or Shutdown() from many threads at the same time is going to work
         std::vector<std::shared_ptr<TasksThread>> _workerThreads;
 
@@ -51,16 +109,63 @@ namespace TasksLib {
         scheduleMap _scheduledTasks;
 
         // The earliest point in time when the scheduling thread has something to do -> the time of the first delayed task
-        std::atomic<scheduleTimePoint> _scheduleEarliest;
+        alignas(CACHE_LINE_SIZE) std::atomic<scheduleTimePoint> _scheduleEarliest;
+
+        struct RateLimit {                  // A token bucket, guarded by schedulerMutex like the timers
+            double tokensPerSecond;
+            double burst;
+            double tokens;
+            scheduleTimePoint refilled;
+            rateHeldList held;              // Tasks waiting for a token, in the order they came
+
+            void Refill(scheduleTimePoint now);
+            [[nodiscard]] scheduleTimePoint NextToken() const;
+        };
+        std::unordered_map<uint32_t, RateLimit> _rateLimits;
 
         std::mutex _tasksMutex;
         std::condition_variable _tasksCondition;
-        std::vector<TaskPtr> _tasks;
+        TasksReadyQueue _tasks;
+
+        // Without scheduling threads, one idle worker at a time - the leader - waits for the earliest timer and expires
+        // the timers itself. The rest of the idle workers follow, they only wait for tasks.
+        bool _isWorkerTimers;                   // Set while the queue is not running yet
+        bool _hasTimerLeader;                   // Guarded by tasksMutex
+        std::condition_variable _timerCondition;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _tasksPushed;   // Spinning workers watch it for new tasks
+
+        // TaskGroup::Wait() callers that execute the queue's tasks, woken up when a task is queued. Lock order is
+        // groupWaitersMutex, then the group's waitMutex.
+        std::atomic<uint32_t> _numGroupWaiters;
+        std::mutex _groupWaitersMutex;
+        std::vector<TaskGroupState*> _groupWaiters;
 
-        std::mutex _mtTasksMutex;
-        std::vector<TaskPtr> _mtTasks;
+        TasksMainThreadQueue _mtTasks;
+        std::vector<TaskPtr> _mtBatch;          // Only touched by Update(), kept to reuse their memory
+        std::vector<TaskPtr> _mtDeferred;       // Main thread tasks waiting for the running priority to drop
+
+        std::mutex _cancelMutex;
+        cancelTagMap _cancelTags;
+        std::unordered_map<uint64_t, TaskWeakPtr> _dedupKeys;	// The task last added with each TaskDedupKey, guarded by cancelMutex too
 
 	public:
+		struct Capacity {
+			Capacity();
+
+            uint32_t maxTasks;                          // Tasks in the queue, suspended and executing ones included, 0 is no limit
+            size_t maxBytes;                            // Approximate memory of those tasks, see TaskFootprint, 0 is no limit
+            TasksQueueOverflowPolicy overflowPolicy;
+            std::chrono::milliseconds overflowTimeout;  // How long OVERFLOW_BLOCK waits for room
+		};
+		struct IdleStrategy {                           // What a worker does when it runs out of tasks, before it sleeps
+			IdleStrategy();
+			IdleStrategy(std::chrono::microseconds spinTime, std::chrono::microseconds yieldTime, bool adaptive = true);
+
+            std::chrono::microseconds spin;             // Polls for new tasks with a CPU pause in between
+            std::chrono::microseconds yield;            // Then keeps polling, yielding the CPU in between
+            bool isAdaptive;                            // Polls for about twice the average gap between tasks, within spin + yield
+		};
 		struct Configuration {
 			Configuration();
 			Configuration(uint16_t numBlockingThreads, uint16_t numNonBlockingThreads, uint16_t numSchedulingThreads);
@@ -68,6 +173,12 @@ namespace TasksLib {
             uint16_t blockingThreads;
             uint16_t nonBlockingThreads;
             uint16_t schedulingThreads;
+            TasksQueuePolicy policy;
+            TaskDeadlineMissPolicy deadlineMissPolicy;
+            std::chrono::milliseconds priorityAgingTime;
+            Capacity capacity;
+            IdleStrategy blockingIdle;
+            IdleStrategy nonBlockingIdle;
 		};
 
 		TasksQueue();
@@ -82,7 +193,7 @@ namespace TasksLib {
         [[maybe_unused]] [[nodiscard]] uint16_t numNonBlockingThreads() const;
         [[maybe_unused]] [[nodiscard]] uint16_t numSchedulingThreads() const;
 
-		TasksQueuePerformanceStats<std::uint32_t> GetPerformanceStats(bool reset = false);
+		TasksQueuePerformanceStats<std::uint64_t> GetPerformanceStats(bool reset = false);
 
 		/* Initialize the threads queue with the specified number of threads 
 		   @param configuration
@@ -94,10 +205,23 @@ namespace TasksLib {
                     uint16_t blockingThreads;
                     uint16_t nonBlockingThreads;
                     uint16_t schedulingThreads;
+                    TasksQueuePolicy policy;
+                    TaskDeadlineMissPolicy deadlineMissPolicy;
+                    std::chrono::milliseconds priorityAgingTime;
+                    Capacity capacity;
+                    IdleStrategy blockingIdle;
+                    IdleStrategy nonBlockingIdle;
                 };
 		   
 		   numBlockingThreads should be at least 1.
 		   numSchedulingThreads = 0 will disable the ability to put tasks on delay.
+		   policy selects the order in which worker threads pick tasks (POLICY_PRIORITY by default), with POLICY_DEADLINE the
+		   deadlineMissPolicy decides what to do with the tasks that are already late (DEADLINE_MISS_RUN by default).
+		   priorityAgingTime is for POLICY_WEIGHTED_PRIORITY - a task that waited that long goes ahead of every level's
+		   share, so no level starves however busy the higher ones are (100 ms by default).
+		   capacity bounds the queue, see TryAddTask(). There are no limits by default.
+		   blockingIdle and nonBlockingIdle are what the blocking and the non-blocking workers do when they run out of
+		   tasks - poll for the next one up to spin + yield, see IdleStrategy, then sleep. By default they sleep right away.
 		   
 		   Default constructor yields some sensible minimum thread numbers, with at least 1 in each category.
 		   The TasksQueue will not initialize if the number of blocking threads requested is 0.
@@ -106,20 +230,120 @@ namespace TasksLib {
 		void Cleanup();
 
         [[maybe_unused]] bool AddTask(const TaskPtr& task);
+		/* Adds the task like AddTask(), or says why it didn't.
+		   When the queue is at its capacity the overflowPolicy decides - OVERFLOW_REJECT refuses the task with ADD_FULL,
+		   OVERFLOW_DROP_OLDEST cancels the task that has waited longest for a worker and OVERFLOW_BLOCK waits for room,
+		   up to the overflowTimeout. Main thread and suspended tasks are never dropped, and the queue's own tasks don't
+		   block on it - they get ADD_FULL instead of holding up a worker that would make room.
+		   A task with a TaskDedupKey may be merged into a pending task of the same key instead, that is ADD_MERGED.
+		   Only a new or a finished task can be added - one that is queued, waiting or executing gets ADD_INVALID, a task
+		   keeps itself going with Task::Reschedule().
+		 */
+        [[maybe_unused]] TaskAddResult TryAddTask(const TaskPtr& task);
+		/* Cancels a task of this queue, its callbacks and everything they captured are released right away.
+		   A suspended task is taken off the timer, a task waiting in the queue is skipped when its turn comes - neither
+		   involves searching for it. A task that is executing at the moment finishes the current run and doesn't reschedule.
+		   Returns false if the task is not in the queue (not added yet, finished or already cancelled).
+		 */
+        [[maybe_unused]] bool Cancel(const TaskPtr& task);
+		/* Cancels all tasks that have the tag in their options, returns how many were cancelled */
+        [[maybe_unused]] size_t CancelTag(TaskCancelTag tag);
+		/* Lets the tasks with the TaskRateClass option start at most tokensPerSecond times per second, in bursts of up to
+		   burst tasks. Tasks over the limit wait off the workers in the order they came, the scheduling thread releases
+		   each of them as soon as there is a token for it. tokensPerSecond = 0 removes the limit and releases the waiting tasks.
+		 */
+        [[maybe_unused]] bool SetRateLimit(TaskRateClass rateClass, double tokensPerSecond, uint32_t burst = 1);
+		/* Puts a task that has parked itself with Task::Park() back on the queue, the task reads the result with
+		   GetParkResult(). Returns false if the task isn't parked - it hasn't called Park(), it has been unparked or
+		   cancelled already. */
+        [[maybe_unused]] bool Unpark(const TaskPtr& task, uint32_t result = 0);
+		/* Runs the callable once on a worker thread - the fast path for fire-and-forget work. It waits in the ready queue
+		   as a bare callable, no Task is created, and it costs only the one allocation of the std::function, if any.
+		   The options may be TaskPriority and TaskBlocking, they order it like a task's. Anything that needs a Task (a delay,
+		   the main thread, a cancel tag, a deadline, ...) or a queue with a capacity gets one - it is added like AddTask() would.
+		   Posted callables can't be cancelled, they are not traced nor seen by the observer hooks, the stats count them
+		   as added and completed tasks. Returns false if the queue is not running.
+		 */
+		template <typename... Ts> bool Post(PostedExecutable executable, Ts&& ...opts);
 		/* Handle queue updates
 		   You are supposed to call this periodically on your main thread. If Update() doesn't get called, tasks that are targeted on the main thread will
 		   never get executed, also tasks that are suspended will never wake.
+		   The main thread tasks execute in the order they were added. Only one thread at a time may call Update().
 		 */
 		void Update();
 
 	private:
+        // Of the types above, so they come after them
+        Capacity _capacity;                     // Only changes while the queue is not initialized
+        IdleStrategy _idleStrategies[2];        // Of the blocking and the non-blocking workers, same as the capacity
+        std::atomic<uint32_t> _capacityWaiters; // Threads blocked by OVERFLOW_BLOCK
+        std::mutex _capacityMutex;
+        std::condition_variable _capacityCondition;
+
 		void CreateThreads(const Configuration& configuration);
-		bool AddTask(const TaskPtr& task, std::unique_lock<std::mutex> lockTask, bool updateTotal = true);
-		
+		bool PostExecutable(PostedExecutable&& executable, const TaskOptions& options);
+		void AttachToPool(TasksWorkerPool* pool, const Capacity& capacity);
+		/* Moves the task from the status the caller has seen it in to its place in the queue, fails if something else
+		   (like Cancel()) has moved it first. A wakeTime other than min() suspends the task until then. */
+		bool AddTask(const TaskPtr& task, TaskStatus from, scheduleTimePoint wakeTime = scheduleTimePoint::min());
+		/* TryAddTask() for TaskGroup::AddTask() - the task joins the group only once the queue has accepted it, a task
+		   that is on a queue right now belongs to whoever has it, and so does its group */
+		TaskAddResult TryAddTask(const TaskPtr& task, const std::shared_ptr<TaskGroupState>& group);
+		TaskAddResult ReserveCapacity(const TaskPtr& task);		// Counts a new task in, unless the queue is at its capacity
+		TaskAddResult Overflow(const TaskPtr& task);			// Applies the overflow policy when it is
+		void ReleaseCapacity(Task* task);						// Counts a task out of the queue
+		bool DropOldestTask();
+		/* Parks a task that has called Task::Park() when its run is over, fails if Cancel() has taken it */
+		bool ParkTask(const TaskPtr& task);
+		void ResumeParkedTask(const TaskPtr& task);
+		/* Sets a TaskPeriod task up for its next run */
+		bool RearmTask(const TaskPtr& task);
+		/* Keeps a rescheduled task on the worker thread that is running it, per the task's TaskAffinity */
+		bool AddLocalTask(const TaskPtr& task);
+		void NotifyTasks();
+		void WakeGroupWaiters();
+		/* Holds the task back if its TaskRateClass is out of tokens, fails if the task has moved meanwhile like AddTask() */
+		bool HoldForRate(const TaskPtr& task, TaskStatus from, bool& isHeld);
+		bool AdvanceScheduleEarliest(scheduleTimePoint wakeTime);		// _schedulerMutex must be held, true if the scheduling thread needs a notification
+		void NotifySchedule();
+
+		StatsCounters& Stats();								// The calling thread's shard
+
 		void ThreadExecuteTasks(bool ignoreBlocking);
+		struct IdleState;
+		bool WaitForWork(std::unique_lock<std::mutex>& lockTasks, IdleState& idle);		// Idles a worker, true when it has timers to expire
+		void SpinForWork(std::unique_lock<std::mutex>& lockTasks, IdleState& idle);		// Per the idle strategy, with the lock released
 		void ThreadExecuteScheduledTasks();
 
+		TaskPtr TakeTask(bool ignoreBlocking, TasksReadyQueue::PostedCall& posted);		// _tasksMutex must be held
+		void DropTask(const TaskPtr& task, std::atomic<std::int64_t>& reason);		// Cancels a task that was waiting in the ready queue
+		bool ExecuteTask(bool ignoreBlocking);				// Runs one ready task on the calling thread, if there is any
+		/* Executes ready tasks on the calling thread until the group has finished, sleeps while there are none,
+		   see TaskGroup::Wait(). Returns false if the deadline comes first. */
+		bool WaitForGroup(TaskGroupState& state, scheduleTimePoint deadline);
+		scheduleTimePoint ExpireScheduledTasks();			// Moves due tasks to the ready queue, returns the time of the next one
+
+		void RunWorkerTask(TaskPtr task, bool ignoreBlocking);		// Executes the task, then whatever it left in the worker's run-next slot
+		void RunPostedCall(TasksReadyQueue::PostedCall& posted, bool ignoreBlocking);
 		void RescheduleTask(const std::shared_ptr<Task>& task);
+
+		void IndexCancelTag(const TaskPtr& task);			// Only by whoever owns the task's current status
+		void UnindexCancelTag(Task* task);					// Only by whoever owns the task's current status
+		/* Looks the task's TaskDedupKey up and applies its policy - ADD_MERGED if the task is not to be added, otherwise
+		   the task is indexed under the key, and with DEDUP_REPLACE the pending one is cancelled */
+		TaskAddResult MergeDuplicate(const TaskPtr& task, TaskStatus status);
+		void UnindexDedupKey(Task* task);
+		void EndDedupAdd(const TaskPtr& task);				// Once an indexed task is queued, or failed to
+		static bool IsPending(TaskStatus status);			// Waiting to execute - it can still be merged with
+
+		friend class TasksWorkerPool;
+		friend class TaskGroup;
     };
 
+	// ==========================================================================
+
+	template <typename... Ts> bool TasksQueue::Post(PostedExecutable executable, Ts&& ...opts) {
+		return PostExecutable(std::move(executable), TaskOptions(std::forward<Ts>(opts)...));
+	}
+
 }
@@ -1,23 +1,74 @@
 #pragma once
 
-#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "Types.h"
 #include "TasksQueue.h"
+#include "TasksWorkerPool.h"
 
 namespace TasksLib {
 
 	class TasksQueuesContainer {
 	public:
 		TasksQueuesContainer();
+		/* Creates the container with a shared TasksWorkerPool, which serves the queues created with CreateLane() */
+		explicit TasksQueuesContainer(const TasksQueue::Configuration& sharedPoolConfiguration);
 		virtual ~TasksQueuesContainer();
 
-		TasksQueue* GetQueue(const std::string& queueName);
-        [[maybe_unused]] void CreateQueue(const std::string& queueName, const TasksQueue::Configuration& configuration);
+		/* Lookups never lock and are safe to call while other threads are creating queues.
+		   Prefer the handle returned by CreateQueue() on hot paths, it is a plain array index.
+		 */
+		TasksQueue* GetQueue(const std::string& queueName) const;
+        [[maybe_unused]] TasksQueue* GetQueue(TasksQueueHandle handle) const;
+        [[maybe_unused]] TasksQueueHandle GetQueueHandle(const std::string& queueName) const;
+
+		/* Creates and initializes a named queue and returns its handle. If the name is already taken, the existing
+		   queue's handle is returned and the configuration is ignored. Handles stay valid for the container's lifetime.
+		 */
+        [[maybe_unused]] TasksQueueHandle CreateQueue(const std::string& queueName, const TasksQueue::Configuration& configuration);
+		/* Creates a named queue without threads of its own, served by the shared pool. Same naming rules as CreateQueue().
+		   Returns INVALID_QUEUE_HANDLE if the container was created without a shared pool.
+		 */
+        [[maybe_unused]] TasksQueueHandle CreateLane(const std::string& queueName, const TasksWorkerPool::LaneConfiguration& configuration);
+        [[maybe_unused]] TasksWorkerPool* GetSharedPool() const;
         [[maybe_unused]] size_t GetQueuesCount() const;
         [[maybe_unused]] void Update();
 
 	private:
-		std::unordered_map<std::string, TasksQueue> queueMap_;
+		// Lookups read the current table without locks. A table has room for a number of queues and AddQueue() fills it
+		// in place, only a full table is copied into one twice its size. Replaced tables are kept until destruction, as
+		// a reader might still be looking at one of them - each is half the size of the next, so together they never
+		// take more memory than the current one.
+		static constexpr size_t INITIAL_TABLE_CAPACITY = 8;
+
+		struct QueueName {
+			std::string name;
+			TasksQueueHandle handle;
+		};
+		struct Table {
+			explicit Table(size_t queuesCapacity);
+
+			size_t capacity;
+			std::unique_ptr<std::atomic<TasksQueue*>[]> queues;			// Indexed by handle
+			std::unique_ptr<std::atomic<const QueueName*>[]> names;		// Open addressing, twice as many slots as queues
+		};
+
+		std::atomic<const Table*> table_;
+		std::atomic<size_t> count_;											// Queues published, set after their slot
+		std::unique_ptr<TasksWorkerPool> pool_;
+
+		std::mutex createMutex_;											// Serializes writers only
+		std::vector<std::unique_ptr<TasksQueue>> queues_;
+		std::vector<std::unique_ptr<Table>> tables_;
+		std::vector<std::unique_ptr<const QueueName>> names_;
+
+		static const QueueName* FindName(const Table& table, const std::string& queueName);
+		static void InsertName(Table& table, const QueueName* name);
+		TasksQueueHandle AddQueue(const std::string& queueName, const TasksQueue::Configuration* configuration,
+								  const TasksWorkerPool::LaneConfiguration* laneConfiguration);
 	};
 }
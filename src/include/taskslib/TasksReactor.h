@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Types.h"
+
+namespace TasksLib {
+
+	enum TaskIoEvents : uint32_t {
+		IO_READ		= 0x01,
+		IO_WRITE	= 0x02,
+		IO_ERROR	= 0x04,			// Reported whether it was asked for or not, like IO_HANGUP
+		IO_HANGUP	= 0x08,
+		IO_TIMEOUT	= 0x10,			// The watch's timeout has passed before the descriptor was ready
+		IO_CLOSED	= 0x20,			// The reactor has been destroyed while the task was waiting
+	};
+
+	/*
+		Parks tasks until their file descriptors are ready, so that waiting for I/O doesn't take a worker thread.
+
+		A task that would block on a non-blocking descriptor - read() returned EAGAIN - calls Watch() from its callback
+		and returns. It is parked (see Task::Park()) and the reactor's thread puts it back on the queue when the
+		descriptor is ready or the timeout has passed, the task's next run reads the TaskIoEvents with GetParkResult()
+		and retries. Thousands of tasks can wait this way on a queue with a couple of workers.
+
+		Any other completion - a callback of an asynchronous library - can park the task with Task::Park() and wake it
+		up with TasksQueue::Unpark() directly, without the reactor.
+
+		Linux only, it is built on epoll - elsewhere Watch() fails. One watch per descriptor at a time. The reactor has
+		to be destroyed before its queue, the tasks still waiting are woken up with IO_CLOSED.
+
+		Cancelling a waiting task doesn't tell the reactor - its watch stays until the descriptor is ready, the timeout
+		passes or the descriptor is watched again, which drops the watch of a cancelled or finished task. Unwatch() drops
+		it right away, call it before closing the descriptor of a cancelled task.
+	 */
+	class TasksReactor {
+	public:
+		explicit TasksReactor(TasksQueue* queue);
+		~TasksReactor();
+
+		TasksReactor(const TasksReactor&) = delete;
+		TasksReactor& operator=(const TasksReactor&) = delete;
+
+		/* Parks the task, from its own callback, until the descriptor is ready for the IO_READ and/or IO_WRITE events.
+		   A timeout of 0 waits without one. Fails if another task that may still wait watches the descriptor already,
+		   or epoll refuses it. */
+        [[maybe_unused]] bool Watch(const TaskPtr& task, int fd, uint32_t events, TaskDelay timeout = TaskDelay{ 0 });
+		/* Drops the watch of the descriptor without waking its task up, returns false if there is none */
+        [[maybe_unused]] bool Unwatch(int fd);
+        [[maybe_unused]] [[nodiscard]] size_t GetWatching() const;
+
+	private:
+		struct IoWatch {
+			TaskPtr task;
+			bool hasTimeout;
+			std::multimap<scheduleTimePoint, int>::iterator timeoutIt;
+		};
+
+		TasksQueue* _queue;
+		int _epoll;
+		int _wakeFd;						// An eventfd, wakes the thread up for an earlier timeout or to stop
+
+		mutable std::mutex _mutex;
+		std::unordered_map<int, IoWatch> _watches;
+		std::multimap<scheduleTimePoint, int> _timeouts;
+		std::atomic<bool> _isStopping;
+		std::thread _thread;
+
+		void ThreadReact();
+		void Wake();
+		void DropWatch(std::unordered_map<int, IoWatch>::iterator watchIt);		// Under the mutex
+	};
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+#include <cstdint>
+
+#include "Types.h"
+
+namespace TasksLib {
+
+	/*
+		The tasks that are ready to execute in the worker threads, ordered by the queue's TasksQueuePolicy.
+
+		It is not thread safe - TasksQueue guards it with its tasksMutex. The options that decide the order are
+		copied when a task is pushed, so taking tasks out doesn't need to lock them. Cancelled tasks are not searched
+		for, they are discarded when they come up.
+
+		The callables of TasksQueue::Post() wait in the same order, as entries without a task.
+	 */
+	class TasksReadyQueue {
+	public:
+		struct PostedCall {
+			PostedExecutable	executable;
+			TaskPriority		priority = 0;
+		};
+
+		TasksReadyQueue();
+
+		void SetPolicy(TasksQueuePolicy policy, TaskDeadlineMissPolicy deadlineMissPolicy,
+					   std::chrono::milliseconds agingTime = std::chrono::milliseconds(0));
+        [[maybe_unused]] [[nodiscard]] TasksQueuePolicy GetPolicy() const;
+
+		[[nodiscard]] bool IsEmpty() const;
+        [[maybe_unused]] [[nodiscard]] size_t Size() const;
+
+		void Push(const TaskPtr& task, const TaskOptions& options);
+		/* A posted callable, of the options only the priority and TaskBlocking apply to it */
+		void Push(PostedExecutable&& executable, const TaskOptions& options);
+		/* Takes out the next task that a thread may execute, or returns nullptr.
+		   @param ignoreBlocking     skip the tasks with TaskBlocking
+		   @param runningPriority    POLICY_PRIORITY skips the tasks with lower priority
+		   @param dropped            receives the tasks that DEADLINE_MISS_DROP took out instead of executing
+		   @param missedDeadline     set to true if the returned task is already past its deadline
+		   @param posted             receives the posted callable if it is next, nullptr is returned then
+		*/
+		TaskPtr Take(bool ignoreBlocking, TaskPriority runningPriority, std::vector<TaskPtr>& dropped, bool& missedDeadline, PostedCall& posted);
+		/* Takes out the task that was pushed first regardless of the policy, or returns nullptr.
+		   Posted callables are passed over, they are not dropped to make room. Logarithmic in the number of tasks. */
+		TaskPtr TakeOldest();
+
+	private:
+		struct Entry {
+			TaskPtr			task;				// nullptr for a posted callable
+			TaskPriority	priority;
+			TaskDeadline	deadline;
+			uint64_t		sequence;
+			bool			isBlocking;
+			scheduleTimePoint	added;				// Only set by POLICY_WEIGHTED_PRIORITY
+			PostedExecutable	posted;
+		};
+		struct PriorityLevel {
+			std::deque<Entry>	tasks[2];			// In order of submission, indexed by isBlocking
+			uint64_t			pass;				// Stride scheduling virtual time
+		};
+		struct EarlierDeadline {
+			bool operator()(const Entry& lhs, const Entry& rhs) const;
+		};
+		using DeadlineSet = std::set<Entry, EarlierDeadline>;
+
+		TasksQueuePolicy _policy;
+		TaskDeadlineMissPolicy _deadlineMissPolicy;
+		uint64_t _sequence;
+		std::atomic<size_t> _size;				// Changed under the tasksMutex, IsEmpty() may read it without as a hint
+
+		std::deque<Entry> _fifo;					// POLICY_PRIORITY, in order of submission
+		DeadlineSet _deadlineTasks[2];				// POLICY_DEADLINE, by deadline, indexed by isBlocking
+		std::map<uint64_t, DeadlineSet::iterator> _deadlineOrder;	// The same tasks by sequence, posted callables left out
+		std::deque<Entry> _lateTasks[2];			// POLICY_DEADLINE with DEADLINE_MISS_DEPRIORITIZE, indexed by isBlocking
+		std::map<TaskPriority, PriorityLevel> _levels;		// POLICY_WEIGHTED_PRIORITY, only the levels that have tasks
+		uint64_t _passBase;							// Pass of the most recently served level, new levels start from here
+		scheduleDuration _agingTime;
+
+		void PushEntry(Entry&& entry);
+		TaskPtr TakeByPriority(bool ignoreBlocking, TaskPriority runningPriority, PostedCall& posted);
+		TaskPtr TakeByDeadline(bool ignoreBlocking, std::vector<TaskPtr>& dropped, bool& missedDeadline, PostedCall& posted);
+		TaskPtr TakeByWeightedPriority(bool ignoreBlocking, PostedCall& posted);
+		std::vector<Entry> TakeAll();
+		Entry ExtractDeadlineEntry(DeadlineSet::iterator it);
+		static TaskPtr TakeEntry(Entry& entry, PostedCall& posted);
+		static bool IsCancelled(const Entry& entry);
+	};
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+
+namespace TasksLib {
+
+	enum TaskTraceEvent : uint32_t {
+		TRACE_ADD = 0,
+		TRACE_SUSPEND,
+		TRACE_RESUME,
+		TRACE_EXECUTE,			// Span
+		TRACE_RESCHEDULE,
+		TRACE_CANCEL,
+		TRACE_UPDATE			// Span
+	};
+
+	/*
+		Opt-in recorder of the tasks' lifecycle, dumped as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+
+		Every thread records into a ring buffer of its own, which keeps the latest events and overwrites the oldest, so
+		recording takes no lock and shares no cache line with other threads - a clock read and a few stores. While
+		disabled, it costs a relaxed load per event.
+
+		Enable() starts a new session, the events recorded before it are not dumped anymore. WriteChromeTrace() may be
+		called at any time from any thread, events that are being overwritten while it is reading them are left out.
+
+		The buffers of the threads that have exited are kept for the dump and reused by new threads. Once there are
+		MAX_BUFFERS of them, a new thread takes over the buffer of the thread that exited first, so its events are lost
+		- the memory stays at MAX_BUFFERS buffers, or one per live thread if there are more of those.
+	 */
+	class TasksTracer {
+	public:
+		static constexpr size_t DEFAULT_EVENTS_PER_THREAD = 16384;
+		static constexpr size_t MAX_BUFFERS = 64;
+
+		[[maybe_unused]] static void Enable(size_t eventsPerThread = DEFAULT_EVENTS_PER_THREAD);
+		[[maybe_unused]] static void Disable();
+		[[maybe_unused]] static bool IsEnabled() {
+			return _isEnabled.load(std::memory_order_relaxed);
+		}
+
+		/* Records an instant event for the task (or anything else the id identifies) on the calling thread */
+		[[maybe_unused]] static void Record(const TaskTraceEvent event, const void* id) {
+			if (IsEnabled()) {
+				Write(event, id, Now(), -1);
+			}
+		}
+
+		/* Writes the events of the current session recorded by all threads so far */
+		[[maybe_unused]] static void WriteChromeTrace(std::ostream& out);
+
+		/* Records a span from its construction to its destruction */
+		class Span {
+		public:
+			Span(const TaskTraceEvent event, const void* id)
+				: _event(event)
+				, _id(id)
+				, _begin(IsEnabled() ? Now() : -1)
+			{}
+			~Span() {
+				if (_begin >= 0) {
+					Write(_event, _id, _begin, Now() - _begin);
+				}
+			}
+
+			Span(const Span&) = delete;
+			Span& operator=(const Span&) = delete;
+
+		private:
+			const TaskTraceEvent _event;
+			const void* const _id;
+			const int64_t _begin;
+		};
+
+	private:
+		static int64_t Now() {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+		static void Write(TaskTraceEvent event, const void* id, int64_t begin, int64_t duration);
+
+		static inline std::atomic<bool> _isEnabled{ false };
+	};
+
+}
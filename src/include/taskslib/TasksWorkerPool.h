@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "Types.h"
+#include "TasksQueue.h"
+
+namespace TasksLib {
+
+	/*
+		A set of worker threads and one timer thread, shared by several TasksQueue lanes.
+
+		The lanes don't have threads of their own. Idle pool workers pick the next lane to serve with stride
+		scheduling - each lane advances by 1/weight per task it gets, and the one furthest behind goes next - so a
+		backlogged lane can use all the capacity the other lanes leave idle. A lane with minConcurrency > 0 has that
+		many workers reserved for it while it has tasks: it goes first when a worker is free, and the pool doesn't let
+		other lanes take the last idle workers it would need. A lane without tasks reserves nothing.
+	 */
+	class TasksWorkerPool {
+	public:
+		struct LaneConfiguration {
+			LaneConfiguration();
+			LaneConfiguration(uint16_t laneWeight, uint16_t laneMinConcurrency = 0, uint16_t laneMaxConcurrency = 0);
+
+			uint16_t weight;				// Share of the pool relative to the other lanes, at least 1
+			uint16_t minConcurrency;		// Workers reserved for the lane while it has tasks
+			uint16_t maxConcurrency;		// Upper limit of workers running the lane's tasks at the same time, 0 is no limit
+			TasksQueue::Capacity capacity;	// Bounds the lane's queue, see TasksQueue::TryAddTask()
+		};
+
+		TasksWorkerPool();
+		explicit TasksWorkerPool(const TasksQueue::Configuration& configuration);
+		virtual ~TasksWorkerPool();
+
+		[[nodiscard]] bool isInitialized() const;
+        [[maybe_unused]] [[nodiscard]] uint16_t numWorkerThreads() const;
+        [[maybe_unused]] [[nodiscard]] uint16_t numBlockingThreads() const;
+        [[maybe_unused]] [[nodiscard]] uint16_t numNonBlockingThreads() const;
+        [[maybe_unused]] [[nodiscard]] uint16_t numSchedulingThreads() const;
+        [[maybe_unused]] [[nodiscard]] size_t numLanes() const;
+
+		/* Creates the shared threads, the configuration has the same meaning as for a TasksQueue.
+		   More than 1 scheduling thread is pointless here, the pool creates at most one.
+		 */
+		void Initialize(const TasksQueue::Configuration& configuration);
+		/* Stops the threads. The attached queues are left as they are, they don't get served until the pool is initialized again. */
+		void Cleanup();
+
+		/* Turns an uninitialized queue into a lane of the pool. The queue must outlive the pool. */
+        [[maybe_unused]] bool AttachQueue(TasksQueue* queue, const LaneConfiguration& configuration);
+
+	private:
+		struct Lane {
+			TasksQueue* queue;
+			LaneConfiguration configuration;
+			uint32_t running;				// Workers executing the lane's tasks right now
+			uint64_t pass;					// Stride scheduling virtual time
+			uint64_t notifications;			// Bumped on every NotifyTasks() for the lane
+			bool pending[2];				// May have tasks, indexed by ignoreBlocking
+		};
+
+		std::atomic<bool> _isInitialized;
+		std::atomic<bool> _isShuttingDown;
+		uint16_t _numNonBlockingThreads;
+
+		// Mutexes lock order is - (Task->dataMutex), initMutex, poolMutex, scheduleMutex
+		std::mutex _initMutex;
+		std::vector<std::shared_ptr<TasksThread>> _workerThreads;
+		std::vector<std::shared_ptr<TasksThread>> _schedulingThreads;
+
+		mutable std::mutex _poolMutex;
+		std::condition_variable _poolConditions[2];		// Idle workers wait here, indexed by ignoreBlocking
+		uint32_t _idleWorkers[2];						// Workers waiting on _poolConditions, indexed by ignoreBlocking
+		std::vector<std::unique_ptr<Lane>> _lanes;
+		uint32_t _busyWorkers;
+		uint64_t _passBase;					// Pass of the most recently served lane, lanes that were idle start from here
+
+		std::mutex _scheduleMutex;
+		std::condition_variable _scheduleCondition;
+		bool _scheduleChanged;
+
+		void CreateThreads(const TasksQueue::Configuration& configuration);
+
+		void NotifyTasks(TasksQueue* queue);
+		void NotifySchedule();
+
+		void ThreadExecuteTasks(bool ignoreBlocking);
+		void ThreadExecuteScheduledTasks();
+
+		Lane* PickLane(bool ignoreBlocking);		// _poolMutex must be held
+		static bool IsPending(const Lane& lane);	// May have tasks for any of the workers
+
+		friend class TasksQueue;
+	};
+
+}
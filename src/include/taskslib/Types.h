@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <functional>
 #include <chrono>
 #include <map>
+#include <list>
+#include <unordered_map>
 
 namespace TasksLib {
 
@@ -12,7 +15,10 @@ namespace TasksLib {
 	class Task;
 	class TasksThread;
 	class TasksQueue;
+	class TasksWorkerPool;
 	class TasksQueuesContainer;
+	class TaskGroup;
+	class TaskGroupState;
 
 	// === Task =====
 	enum TaskStatus {
@@ -23,6 +29,14 @@ namespace TasksLib {
 		TASK_IN_QUEUE,				// Waiting in a queue
 		TASK_IN_QUEUE_MAIN_THREAD,	// Waiting in a queue in main thread
 		TASK_WORKING,				// Executing
+		TASK_CANCELLED,				// Removed from the queue by TasksQueue::Cancel(), won't execute anymore
+	};
+
+	enum TaskParkState : uint8_t {
+		PARK_NONE = 0,
+		PARK_REQUESTED,				// Task::Park() was called, the callback is still running
+		PARK_PARKED,				// Waiting for TasksQueue::Unpark()
+		PARK_WOKEN,					// Unparked before the callback returned
 	};
 
 	using TaskPtr		= std::shared_ptr<Task>;
@@ -40,13 +54,100 @@ namespace TasksLib {
 	using TaskPriority		= uint32_t;
 	using TaskExecutable	= std::function<void(TasksQueue* queue, const TaskPtr& task)>;
 	using TaskDelay			= std::chrono::milliseconds;
+	using TaskDeadline		= std::chrono::steady_clock::time_point;	// Used by POLICY_DEADLINE queues, max() is no deadline
+	struct TaskCancelTag {						// Groups tasks for TasksQueue::CancelTag(), 0 is no tag
+		uint64_t value = 0;
+
+		bool operator==(const TaskCancelTag& other) const { return value == other.value; }
+		bool operator!=(const TaskCancelTag& other) const { return value != other.value; }
+	};
+	enum TaskAffinity {					// Which worker runs a task that rescheduled itself without a delay
+		AFFINITY_AUTO,					// The one that just ran it, unless other tasks are waiting for a worker
+		AFFINITY_STICKY,				// The one that just ran it
+		AFFINITY_NONE,					// Whichever takes it from the queue first, the default
+	};
+	struct TaskRateClass {						// Puts the task under the rate limit set by TasksQueue::SetRateLimit(), 0 is no class
+		uint32_t value = 0;
+
+		bool operator==(const TaskRateClass& other) const { return value == other.value; }
+		bool operator!=(const TaskRateClass& other) const { return value != other.value; }
+	};
+	struct TaskFootprint {						// Approximate memory the task's callbacks hold on to, for the queue's byte capacity
+		size_t bytes = 0;
+
+		bool operator==(const TaskFootprint& other) const { return bytes == other.bytes; }
+		bool operator!=(const TaskFootprint& other) const { return bytes != other.bytes; }
+	};
+	enum TaskPeriodMode {
+		PERIOD_FIXED_RATE,				// Runs are due every interval from the first run, however long they take
+		PERIOD_FIXED_DELAY,				// The next run is due an interval after the previous one has finished
+	};
+	enum TaskOverrunPolicy {			// What a PERIOD_FIXED_RATE task does when it falls behind its schedule
+		OVERRUN_CATCH_UP,				// Runs the missed periods back to back until it is on schedule again
+		OVERRUN_SKIP,					// Drops the missed periods and waits for the next one in the future
+	};
+	struct TaskPeriod {					// Repeats the task until it is cancelled, an interval of 0 is no period
+		std::chrono::milliseconds	interval{ 0 };
+		TaskPeriodMode				mode = PERIOD_FIXED_RATE;
+		TaskOverrunPolicy			overrun = OVERRUN_CATCH_UP;
+
+		bool operator==(const TaskPeriod& other) const { return (interval == other.interval) && (mode == other.mode) && (overrun == other.overrun); }
+		bool operator!=(const TaskPeriod& other) const { return !operator==(other); }
+	};
+	enum TaskDedupPolicy {				// What TasksQueue::AddTask() does when a task with the same TaskDedupKey is pending
+		DEDUP_KEEP_FIRST,				// Drops the new task, the pending one runs
+		DEDUP_REPLACE,					// Cancels the pending task, the new one is added instead
+		DEDUP_DEBOUNCE,					// Drops the new task, a suspended pending one waits until the new one's delay is over
+	};
+	struct TaskDedupKey {						// Merges the task with a pending one of the same key when it is added, 0 is no key
+		uint64_t		value = 0;
+		TaskDedupPolicy	policy = DEDUP_KEEP_FIRST;
+
+		bool operator==(const TaskDedupKey& other) const { return (value == other.value) && (policy == other.policy); }
+		bool operator!=(const TaskDedupKey& other) const { return !operator==(other); }
+	};
 	// </Types as options>
 
 	// === TasksQueue =====
+	enum TasksQueuePolicy {
+		POLICY_PRIORITY,				// Tasks with lower priority wait while there are higher priority ones, otherwise in order of submission
+		POLICY_DEADLINE,				// Earliest TaskDeadline first, tasks without a deadline go last in order of submission
+		POLICY_WEIGHTED_PRIORITY,		// Each priority level gets a share of the workers proportional to priority + 1,
+										// tasks that waited longer than the aging time go first
+	};
+	enum TaskDeadlineMissPolicy {		// What POLICY_DEADLINE does with tasks already past their deadline when their turn comes
+		DEADLINE_MISS_RUN,				// Run them anyway
+		DEADLINE_MISS_DEPRIORITIZE,		// Run them only when there is nothing else that can still make its deadline
+		DEADLINE_MISS_DROP,				// Don't run them at all, the tasks finish with TASK_CANCELLED
+	};
+	enum TasksQueueOverflowPolicy {		// What TasksQueue::TryAddTask() does when the queue is at its capacity
+		OVERFLOW_REJECT,				// Refuses the new task
+		OVERFLOW_BLOCK,					// Waits for room, up to the capacity's overflowTimeout
+		OVERFLOW_DROP_OLDEST,			// Cancels the task that has waited longest for a worker, refuses if there is none
+	};
+	enum TaskAddResult {
+		ADD_OK = 0,
+		ADD_NOT_RUNNING,				// The queue is not initialized or is shutting down
+		ADD_INVALID,					// No task, it is cancelled, or it is on a queue already (queued, waiting or executing)
+		ADD_FULL,						// The queue is at its capacity
+		ADD_TIMED_OUT,					// OVERFLOW_BLOCK waited and there was no room
+		ADD_MERGED,						// Merged into a pending task with the same TaskDedupKey, the new task doesn't execute
+	};
+	using PostedExecutable	= std::function<void(TasksQueue* queue)>;		// A callable for TasksQueue::Post(), it runs once without a Task
+
 	using scheduleClock		= std::chrono::steady_clock;
 	using scheduleTimePoint	= std::chrono::time_point<scheduleClock>;
 	using scheduleDuration	= scheduleClock::duration;
 	using scheduleMap		= std::multimap<scheduleTimePoint, TaskPtr>;
 	using schedulePair		= std::pair<scheduleTimePoint, TaskPtr>;
+	using cancelTagList		= std::list<TaskWeakPtr>;
+	using cancelTagMap		= std::unordered_map<uint64_t, cancelTagList>;
+	using rateHeldList		= std::list<TaskPtr>;
+
+	constexpr size_t CACHE_LINE_SIZE = 64;		// Written from many threads, state sits alone on lines of this size
+
+	// === TasksQueuesContainer =====
+	using TasksQueueHandle	= uint32_t;
+	constexpr TasksQueueHandle INVALID_QUEUE_HANDLE = UINT32_MAX;
 
 }
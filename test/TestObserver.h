@@ -0,0 +1,44 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <utility>
+
+// Compiled into TasksLibObserved as its TasksObserver, records the hooks in the order they are called
+namespace TasksLib {
+
+	class Task;
+	class TasksQueue;
+
+	struct TasksObserver {
+		static inline std::mutex mutex;
+		static inline std::vector<std::pair<const Task*, std::string>> events;
+
+		static void OnEnqueue(const TasksQueue*, const Task& task) { Record(task, "enqueue"); }
+		static void OnDequeue(const TasksQueue*, const Task& task) { Record(task, "dequeue"); }
+		static void OnExecuteBegin(const TasksQueue*, const Task& task) { Record(task, "begin"); }
+		static void OnExecuteEnd(const TasksQueue*, const Task& task) { Record(task, "end"); }
+		static void OnSuspend(const TasksQueue*, const Task& task) { Record(task, "suspend"); }
+		static void OnResume(const TasksQueue*, const Task& task) { Record(task, "resume"); }
+		static void OnReschedule(const TasksQueue*, const Task& task) { Record(task, "reschedule"); }
+		static void OnComplete(const TasksQueue*, const Task& task) { Record(task, "complete"); }
+		static void OnCancel(const TasksQueue*, const Task& task) { Record(task, "cancel"); }
+
+		static void Record(const Task& task, const char* event) {
+			std::lock_guard<std::mutex> lock(mutex);
+			events.emplace_back(&task, event);
+		}
+		static std::vector<std::string> GetEvents(const Task* task) {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::vector<std::string> result;
+			for (const auto& [eventTask, event] : events) {
+				if (eventTask == task) {
+					result.push_back(event);
+				}
+			}
+			return result;
+		}
+	};
+
+}
@@ -2,6 +2,9 @@
 
 #include <memory>
 #include <utility>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #include "TestTools.h"
 #include "taskslib/ResourcePool.h"
@@ -46,6 +49,30 @@ namespace TasksLib {
 
 
 
+    class CountedResource {
+    public:
+        static std::atomic<uint32_t> constructed;
+
+        CountedResource() {
+            // Widen the window in which a racy implementation would construct twice
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            ++constructed;
+        }
+    };
+    std::atomic<uint32_t> CountedResource::constructed{ 0 };
+
+    class CachedResource {
+    public:
+        uint32_t a = 0;
+    };
+
+    class RecreatedResource {
+    public:
+        uint32_t a = 0;
+    };
+
+
+
     class SingletonTest : public TestWithRandom {
     public:
         SingletonTest() = default;
@@ -98,4 +125,71 @@ namespace TasksLib {
         EXPECT_NE(ptr2->getA(), number);
     }
 
+    TEST_F(SingletonTest, CreatesSingleInstanceConcurrently) {
+        const int numThreads = 32;
+        std::atomic<bool> go{ false };
+        std::vector<shared_ptr<CountedResource>> results(numThreads);
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < numThreads; i++) {
+            threads.emplace_back([&go, &results, i]() {
+                while (!go) {
+                    std::this_thread::yield();
+                }
+                results[i] = Singleton<CountedResource>::getInstance();
+            });
+        }
+        go = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        EXPECT_EQ(CountedResource::constructed, 1);
+        for (const auto& ptr : results) {
+            EXPECT_EQ(ptr, results[0]);
+        }
+    }
+
+    TEST_F(SingletonTest, CachesInstance) {
+        std::uniform_int_distribution<uint32_t> distInt(1, UINT32_MAX);
+        const uint32_t number = distInt(randEng);
+
+        const shared_ptr<CachedResource>& cached = Singleton<CachedResource>::getCachedInstance();
+        cached->a = number;
+        EXPECT_EQ(Singleton<CachedResource>::getInstance(), cached);
+        EXPECT_EQ(&Singleton<CachedResource>::getCachedInstance(), &cached);
+
+        // The cache pins the instance, releasing it lets the next call create a new one
+        Singleton<CachedResource>::releaseCachedInstance();
+        EXPECT_EQ(Singleton<CachedResource>::getInstance()->a, 0);
+    }
+
+    TEST_F(SingletonTest, ReclaimsOldHolders) {
+        std::atomic<bool> isDone{ false };
+        std::atomic<uint64_t> found{ 0 };
+        std::vector<std::thread> readers;
+
+        // Readers keep looking up the instance while it is destroyed and created again
+        for (int i = 0; i < 4; i++) {
+            readers.emplace_back([&isDone, &found]() {
+                while (!isDone) {
+                    if (auto ptr = Singleton<RecreatedResource>::getInstance()) {
+                        ++found;
+                    }
+                }
+            });
+        }
+        for (uint32_t i = 0; (i < 1000) || (found < 1000); i++) {
+            Singleton<RecreatedResource>::getInstance()->a = i;
+        }
+        isDone = true;
+        for (auto& thread : readers) {
+            thread.join();
+        }
+
+        EXPECT_LE(Singleton<RecreatedResource>::getHolderCount(), 5u);		// The current one and one per reader at most
+        Singleton<RecreatedResource>::getInstance();
+        EXPECT_EQ(Singleton<RecreatedResource>::getHolderCount(), 1u);
+    }
+
 }
@@ -1,9 +1,13 @@
 #include "gtest/gtest.h"
 
 #include <random>
+#include <string>
+#include <thread>
+#include <chrono>
 
 #include "TestTools.h"
 #include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
 
 namespace TasksLib {
 
@@ -105,4 +109,57 @@ namespace TasksLib {
 		task.SetData(std::make_shared<int>(i));
 		EXPECT_EQ(*(task.GetData()), i);
 	}
+
+
+	// ====== TaskWithInlineData ========================================================
+
+	struct InlinePayload {
+		InlinePayload(std::string name, const int value)				// No default constructor
+			: name(std::move(name))
+			, value(value)
+		{}
+
+		std::string name;
+		int value;
+	};
+
+	TEST(TaskWithInlineDataTest, EmplacesAndResetsData) {
+		TaskWithInlineData<InlinePayload> task(TaskPriority{ 5 });
+		EXPECT_EQ(task.GetOptions().priority, 5u);
+		EXPECT_FALSE(task.HasData());
+		EXPECT_EQ(task.GetData(), nullptr);
+
+		InlinePayload& payload = task.EmplaceData("first", 1);
+		EXPECT_EQ(task.GetData(), &payload);
+		EXPECT_EQ(task.GetData()->name, "first");
+
+		task.EmplaceData("second", 2);
+		const TaskWithInlineData<InlinePayload>& constTask = task;
+		ASSERT_TRUE(constTask.HasData());
+		EXPECT_EQ(constTask.GetData()->name, "second");
+		EXPECT_EQ(constTask.GetData()->value, 2);
+
+		task.ResetData();
+		EXPECT_FALSE(task.HasData());
+	}
+	TEST(TaskWithInlineDataTest, CarriesDataThroughQueue) {
+		TasksQueue queue{ { 2,0,1 } };
+		auto task = std::make_shared<TaskWithInlineData<InlinePayload>>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {
+				InlinePayload* payload = static_cast<TaskWithInlineData<InlinePayload>&>(*task).GetData();
+				payload->value *= 2;
+				if (payload->value < 16) {
+					task->Reschedule();
+				}
+			}
+		);
+		task->EmplaceData("doubled", 1);
+
+		ASSERT_TRUE(queue.AddTask(task));
+		for (int i = 0; (i < 1000) && (task->GetStatus() != TaskStatus::TASK_FINISHED); i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		ASSERT_EQ(task->GetStatus(), TaskStatus::TASK_FINISHED);
+		EXPECT_EQ(task->GetData()->value, 16);
+	}
 }
@@ -0,0 +1,146 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <vector>
+
+#include "taskslib/Types.h"
+#include "TestTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TaskBatcher.h"
+
+namespace TasksLib {
+
+	using namespace ::testing;
+
+	class TaskBatcherTest : public ::testing::Test {
+	public:
+		std::mutex mutex;
+		std::vector<int> items;
+		std::vector<size_t> batches;
+
+		TaskBatcher<int>::BatchingExecutable Collect() {
+			return [this](TasksQueue* queue, std::vector<int>& batch) -> void {
+				std::lock_guard<std::mutex> lock(mutex);
+				items.insert(items.end(), batch.begin(), batch.end());
+				batches.push_back(batch.size());
+			};
+		}
+		bool WaitForItems(TasksQueue& queue, const size_t count) {
+			for (int i = 0; i < 1000; ++i) {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (items.size() >= count) {
+						return true;
+					}
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			return false;
+		}
+	};
+
+	TEST_F(TaskBatcherTest, CoalescesItemsWithinWindow) {
+		TasksQueue queue{ { 1,0,1 } };
+		TaskBatcher<int> batcher(&queue, Collect(), TaskDelay{ 20 }, 1000);
+
+		for (int i = 0; i < 100; ++i) {
+			EXPECT_TRUE(batcher.Add(i));
+		}
+		EXPECT_EQ(batcher.GetPending(), 100u);
+		ASSERT_TRUE(WaitForItems(queue, 100));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		EXPECT_EQ(batches, std::vector<size_t>{ 100 });
+		for (int i = 0; i < 100; ++i) {
+			EXPECT_EQ(items[i], i);
+		}
+		EXPECT_EQ(batcher.GetPending(), 0u);
+	}
+	TEST_F(TaskBatcherTest, SendsFullBatchesRightAway) {
+		TasksQueue queue{ { 1,0,1 } };
+		TaskBatcher<int> batcher(&queue, Collect(), TaskDelay{ 10000 }, 10);
+
+		for (int i = 0; i < 25; ++i) {
+			EXPECT_TRUE(batcher.Add(i));
+		}
+		ASSERT_TRUE(WaitForItems(queue, 20));
+		EXPECT_EQ(batcher.GetPending(), 5u);
+
+		EXPECT_TRUE(batcher.Flush());
+		ASSERT_TRUE(WaitForItems(queue, 25));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		EXPECT_EQ(batches, (std::vector<size_t>{ 10, 10, 5 }));
+		for (int i = 0; i < 25; ++i) {
+			EXPECT_EQ(items[i], i);
+		}
+	}
+	TEST_F(TaskBatcherTest, TakesWhatIsAddedUntilExecuted) {
+		TasksQueue queue{ { 1,0,0 } };
+		TaskBatcher<int> batcher(&queue, Collect(), TaskDelay{ 0 }, 1000);
+
+		// Holding the only worker, the items queue up behind it
+		std::atomic<bool> isReleased{ false };
+		queue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&isReleased](TasksQueue* queue, const TaskPtr& task) -> void {
+				while (!isReleased) {
+					std::this_thread::yield();
+				}
+			}
+		));
+		for (int i = 0; i < 50; ++i) {
+			EXPECT_TRUE(batcher.Add(i));
+		}
+		isReleased = true;
+		ASSERT_TRUE(WaitForItems(queue, 50));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		EXPECT_EQ(batches, std::vector<size_t>{ 50 });
+	}
+	TEST_F(TaskBatcherTest, KeepsItemsWhenRefused) {
+		TasksQueue queue;
+		TaskBatcher<std::unique_ptr<int>> batcher(&queue, [](TasksQueue* queue, std::vector<std::unique_ptr<int>>& batch) -> void {}, TaskDelay{ 0 }, 2);
+
+		EXPECT_FALSE(batcher.Add(std::make_unique<int>(1)));
+		EXPECT_EQ(batcher.GetPending(), 1u);
+		EXPECT_FALSE(batcher.Add(std::make_unique<int>(2)));
+		EXPECT_EQ(batcher.GetPending(), 2u);
+		EXPECT_FALSE(batcher.Flush());
+		EXPECT_EQ(batcher.GetPending(), 2u);
+	}
+	TEST_F(TaskBatcherTest, SchedulesNewWindowAfterCancel) {
+		TasksQueue queue{ { 1,0,1 } };
+		const TaskCancelTag tag{ 7 };
+		TaskBatcher<int> batcher(&queue, Collect(), TaskDelay{ 20 }, 1000, tag);
+
+		// The window task goes with the tag, its items stay with the batcher for the next window
+		EXPECT_TRUE(batcher.Add(1));
+		EXPECT_EQ(queue.CancelTag(tag), 1u);
+		EXPECT_EQ(batcher.GetPending(), 1u);
+
+		EXPECT_TRUE(batcher.Add(2));
+		ASSERT_TRUE(WaitForItems(queue, 2));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		EXPECT_EQ(items, (std::vector<int>{ 1, 2 }));
+		EXPECT_EQ(batches, std::vector<size_t>{ 2 });
+	}
+	TEST_F(TaskBatcherTest, ExecutesAfterBatcherIsGone) {
+		TasksQueue queue{ { 1,0,1 } };
+		{
+			TaskBatcher<int> batcher(&queue, Collect(), TaskDelay{ 5 }, 1000, TaskPriority{ 5 });
+			EXPECT_TRUE(batcher.Add(1));
+			EXPECT_TRUE(batcher.Add(2));
+		}
+		ASSERT_TRUE(WaitForItems(queue, 2));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		EXPECT_EQ(items, (std::vector<int>{ 1, 2 }));
+	}
+
+}
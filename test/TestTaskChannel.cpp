@@ -0,0 +1,195 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "taskslib/Types.h"
+#include "TestTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TaskChannel.h"
+#include "taskslib/TaskPipeline.h"
+
+namespace TasksLib {
+
+	using namespace ::testing;
+
+	class TaskChannelTest : public ::testing::Test {};
+
+	TEST_F(TaskChannelTest, SendsAndReceivesInOrder) {
+		TaskChannel<std::unique_ptr<int>> channel(2);
+		EXPECT_EQ(channel.GetCapacity(), 2u);
+
+		auto item = std::make_unique<int>(1);
+		EXPECT_TRUE(channel.TrySend(std::move(item)));
+		EXPECT_TRUE(channel.TrySend(std::make_unique<int>(2)));
+		item = std::make_unique<int>(3);
+		EXPECT_FALSE(channel.TrySend(std::move(item)));
+		ASSERT_NE(item, nullptr);				// Still here, it hasn't been sent
+		EXPECT_EQ(channel.GetSize(), 2u);
+
+		EXPECT_EQ(**channel.TryReceive(), 1);
+		EXPECT_TRUE(channel.TrySend(std::move(item)));
+
+		channel.Close();
+		EXPECT_TRUE(channel.IsClosed());
+		EXPECT_FALSE(channel.TrySend(std::make_unique<int>(4)));
+		EXPECT_EQ(**channel.TryReceive(), 2);
+		EXPECT_EQ(**channel.Receive(), 3);
+		EXPECT_FALSE(channel.TryReceive().has_value());
+		EXPECT_FALSE(channel.Receive().has_value());
+	}
+	TEST_F(TaskChannelTest, WakesParkedReceiver) {
+		TasksQueue queue{ { 1,0,1 } };
+		auto channel = std::make_shared<TaskChannel<int>>(4);
+		std::atomic<int> sum{ 0 };
+		std::atomic<bool> isDrained{ false };
+
+		auto consumer = std::make_shared<Task>(
+			(TaskExecutable)[channel, &sum, &isDrained](TasksQueue* queue, const TaskPtr& task) -> void {
+				for (;;) {
+					if (std::optional<int> item = channel->TryReceive()) {
+						sum += *item;
+						continue;
+					}
+					const TaskChannelWait wait = channel->WaitToReceive(queue, task);
+					if (wait == CHANNEL_CLOSED) {
+						isDrained = true;
+					}
+					if (wait != CHANNEL_READY) {
+						return;
+					}
+				}
+			}
+		);
+		ASSERT_TRUE(queue.AddTask(consumer));
+		ASSERT_TRUE(WaitFor([&]() { return consumer->GetStatus() == TASK_SUSPENDED; }));
+		EXPECT_EQ(queue.GetPerformanceStats().waiting, 1);
+
+		EXPECT_TRUE(channel->TrySend(5));
+		ASSERT_TRUE(WaitFor([&]() { return sum == 5; }));
+		ASSERT_TRUE(WaitFor([&]() { return consumer->GetStatus() == TASK_SUSPENDED; }));
+
+		EXPECT_TRUE(channel->Send(7));
+		channel->Close();
+		ASSERT_TRUE(WaitFor([&]() { return consumer->GetStatus() == TASK_FINISHED; }));
+		EXPECT_EQ(sum, 12);
+		EXPECT_TRUE(isDrained);
+	}
+	TEST_F(TaskChannelTest, ParksSenderWhileFull) {
+		TasksQueue queue{ { 1,0,1 } };
+		auto channel = std::make_shared<TaskChannel<int>>(2);
+		constexpr int NUM_ITEMS = 100;
+
+		auto producer = std::make_shared<TaskWithInlineData<int>>(
+			(TaskExecutable)[channel](TasksQueue* queue, const TaskPtr& task) -> void {
+				int& next = *static_cast<TaskWithInlineData<int>&>(*task).GetData();
+				while (next < NUM_ITEMS) {
+					int item = next;
+					if (channel->TrySend(std::move(item))) {
+						++next;
+					} else if (channel->WaitToSend(queue, task) == CHANNEL_PARKED) {
+						return;
+					}
+				}
+				channel->Close();
+			}
+		);
+		producer->EmplaceData(0);
+		ASSERT_TRUE(queue.AddTask(producer));
+		ASSERT_TRUE(WaitFor([&]() { return producer->GetStatus() == TASK_SUSPENDED; }));
+		EXPECT_EQ(channel->GetSize(), 2u);
+
+		std::vector<int> received;
+		while (std::optional<int> item = channel->Receive()) {
+			EXPECT_LE(channel->GetSize(), 2u);
+			received.push_back(*item);
+		}
+		ASSERT_EQ(received.size(), static_cast<size_t>(NUM_ITEMS));
+		for (int i = 0; i < NUM_ITEMS; ++i) {
+			EXPECT_EQ(received[i], i);
+		}
+	}
+
+	TEST_F(TaskChannelTest, RunsPipelineOnSingleWorker) {
+		// Every stage waits on its channels, and a single worker is still enough for all of them
+		TasksQueue queue{ { 1,0,1 } };
+		auto numbers = std::make_shared<TaskChannel<int>>(4);
+		auto squares = std::make_shared<TaskChannel<long long>>(4);
+		auto texts = std::make_shared<TaskChannel<std::string>>(4);
+		std::vector<std::string> results;
+
+		TaskPipeline pipeline(&queue);
+		ASSERT_TRUE((pipeline.AddStage<int, long long>(numbers, squares, [](TasksQueue* queue, int& item) -> long long {
+			return static_cast<long long>(item) * item;
+		}, 2)));
+		ASSERT_TRUE((pipeline.AddStage<long long, std::string>(squares, texts, [](TasksQueue* queue, long long& item) -> std::string {
+			return std::to_string(item);
+		}, 3)));
+		ASSERT_TRUE(pipeline.AddStage<std::string>(texts, [&results](TasksQueue* queue, std::string& item) -> void {
+			results.push_back(item);			// A single task, no need for a lock
+		}, 1));
+		EXPECT_EQ(pipeline.GetPending(), 6u);
+
+		constexpr int NUM_ITEMS = 1000;
+		for (int i = 0; i < NUM_ITEMS; ++i) {
+			ASSERT_TRUE(numbers->Send(std::move(i)));
+		}
+		numbers->Close();
+		ASSERT_TRUE(pipeline.WaitFor(std::chrono::milliseconds(5000)));
+		EXPECT_EQ(queue.GetPerformanceStats().waiting, 0);
+		EXPECT_TRUE(texts->IsClosed());
+
+		ASSERT_EQ(results.size(), static_cast<size_t>(NUM_ITEMS));
+		std::vector<long long> values;
+		for (const std::string& result : results) {
+			values.push_back(std::stoll(result));
+		}
+		std::sort(values.begin(), values.end());
+		for (int i = 0; i < NUM_ITEMS; ++i) {
+			EXPECT_EQ(values[i], static_cast<long long>(i) * i);
+		}
+	}
+	TEST_F(TaskChannelTest, PipelineAppliesBackpressure) {
+		TasksQueue queue{ { 2,0,1 } };
+		auto input = std::make_shared<TaskChannel<int>>(2);
+		auto output = std::make_shared<TaskChannel<int>>(2);
+		std::atomic<bool> release{ false };
+		std::atomic<int> consumed{ 0 };
+
+		TaskPipeline pipeline(&queue);
+		ASSERT_TRUE((pipeline.AddStage<int, int>(input, output, [](TasksQueue* queue, int& item) -> int {
+			return item;
+		}, 1)));
+		ASSERT_TRUE(pipeline.AddStage<int>(output, [&release, &consumed](TasksQueue* queue, int& item) -> void {
+			while (!release) {
+				std::this_thread::yield();
+			}
+			++consumed;
+		}, 1));
+
+		// The sink holds 1, the output channel 2, the first stage 1 waiting to be sent and the input channel 2
+		int sent = 0;
+		for (int i = 0; i < 100; ++i) {
+			if (input->TrySend(std::move(i))) {
+				++sent;
+			} else if (!WaitFor([&]() { return input->GetSize() < 2; }, std::chrono::milliseconds(1000))) {
+				break;
+			}
+		}
+		EXPECT_EQ(sent, 6);
+		EXPECT_EQ(input->GetSize(), 2u);
+		EXPECT_EQ(output->GetSize(), 2u);
+
+		release = true;
+		input->Close();
+		ASSERT_TRUE(pipeline.WaitFor(std::chrono::milliseconds(5000)));
+		EXPECT_EQ(consumed, 6);
+	}
+
+}
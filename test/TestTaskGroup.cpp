@@ -0,0 +1,189 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "taskslib/Types.h"
+#include "TestTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TaskGroup.h"
+#include "taskslib/TasksQueue.h"
+
+namespace TasksLib {
+
+	using namespace ::testing;
+
+	class TaskGroupTest : public TestWithRandom {
+	public:
+		TasksQueue queue{ { 2,0,1 } };
+	};
+
+	TEST_F(TaskGroupTest, WaitsForTasks) {
+		TaskGroup group(&queue);
+		std::atomic<int> runs{ 0 };
+
+		for (int i = 0; i < 100; i++) {
+			EXPECT_TRUE(group.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+					++runs;
+				}
+			)));
+		}
+
+		group.Wait();
+		EXPECT_EQ(runs, 100);
+		EXPECT_EQ(group.GetPending(), 0u);
+	}
+	TEST_F(TaskGroupTest, WaitsForReschedules) {
+		TaskGroup group(&queue);
+		std::atomic<int> runs{ 0 };
+
+		group.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+				if (++runs < 5) {
+					task->Reschedule(TaskBlocking{ (runs % 2) == 0 });
+				}
+			}
+		));
+
+		EXPECT_TRUE(group.WaitFor(std::chrono::milliseconds(500)));
+		EXPECT_EQ(runs, 5);
+	}
+	TEST_F(TaskGroupTest, CountsCancelledTasks) {
+		TaskGroup group(&queue);
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskDelay{ 1000 }
+		);
+
+		group.AddTask(task);
+		EXPECT_FALSE(group.WaitFor(std::chrono::milliseconds(10)));
+		EXPECT_TRUE(queue.Cancel(task));
+		EXPECT_TRUE(group.WaitFor(std::chrono::milliseconds(0)));
+	}
+	TEST_F(TaskGroupTest, RejectsTaskInAnotherGroup) {
+		TaskGroup group(&queue);
+		TaskGroup otherGroup(&queue);
+		std::atomic<bool> release{ false };
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&release](TasksQueue* queue, const TaskPtr& task) -> void {
+				while (!release) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+		);
+
+		EXPECT_TRUE(group.AddTask(task));
+		EXPECT_FALSE(otherGroup.AddTask(task));
+		EXPECT_EQ(otherGroup.GetPending(), 0u);
+		release = true;
+		group.Wait();
+		EXPECT_TRUE(otherGroup.AddTask(task));
+		otherGroup.Wait();
+	}
+	TEST_F(TaskGroupTest, RejectsTaskInFlight) {
+		TaskGroup group(&queue);
+		std::atomic<bool> isRunning{ false };
+		std::atomic<bool> release{ false };
+		std::atomic<int> runs{ 0 };
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&isRunning, &release, &runs](TasksQueue* queue, const TaskPtr& task) -> void {
+				isRunning = true;
+				while (!release) {
+					std::this_thread::yield();
+				}
+				++runs;
+			}
+		);
+
+		// Executing on a worker, outside of any group - it is the queue's, the group must not touch it
+		ASSERT_TRUE(queue.AddTask(task));
+		ASSERT_TRUE(WaitFor([&isRunning] { return isRunning.load(); }));
+		EXPECT_FALSE(group.AddTask(task));
+		EXPECT_EQ(group.GetPending(), 0u);
+
+		// Keeps trying while the worker finishes it, it joins the group only once it is accepted
+		release = true;
+		while (!group.AddTask(task)) {
+			EXPECT_EQ(group.GetPending(), 0u);
+		}
+		EXPECT_TRUE(group.WaitFor(std::chrono::seconds(2)));
+		EXPECT_EQ(group.GetPending(), 0u);
+		EXPECT_EQ(runs, 2);
+	}
+	TEST_F(TaskGroupTest, ForksAndJoinsOnSingleWorker) {
+		// Every task waits for its children - with one worker this only finishes if waiting executes them
+		TasksQueue singleQueue({ 1,0,0 });
+		std::atomic<int> leaves{ 0 };
+		std::function<void(TasksQueue*, int)> fork = [&fork, &leaves](TasksQueue* queue, int depth) {
+			if (depth == 0) {
+				++leaves;
+				return;
+			}
+			TaskGroup children(queue);
+			for (int i = 0; i < 2; i++) {
+				children.AddTask(std::make_shared<Task>(
+					(TaskExecutable)[&fork, depth](TasksQueue* queue, const TaskPtr& task) -> void {
+						fork(queue, depth - 1);
+					}
+				));
+			}
+			children.Wait();
+		};
+
+		TaskGroup root(&singleQueue);
+		root.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&fork](TasksQueue* queue, const TaskPtr& task) -> void {
+				fork(queue, 6);
+			}
+		));
+
+		EXPECT_TRUE(root.WaitFor(std::chrono::seconds(5)));
+		EXPECT_EQ(leaves, 64);
+	}
+	TEST_F(TaskGroupTest, LeavesBlockingTasksOnNonBlockingWorker) {
+		TasksQueue mixedQueue({ 1,1,1 });
+		std::atomic<bool> isHolding{ false };
+		std::atomic<bool> release{ false };
+		std::thread::id waiterThread;
+		std::thread::id childThread;
+
+		// Keeps the blocking worker busy, so that the waiting task goes to the non-blocking one
+		mixedQueue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&isHolding, &release](TasksQueue* queue, const TaskPtr& task) -> void {
+				isHolding = true;
+				while (!release) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			},
+			TaskBlocking{ true }
+		));
+		while (!isHolding) {
+			std::this_thread::yield();
+		}
+
+		TaskGroup root(&mixedQueue);
+		root.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&waiterThread, &childThread](TasksQueue* queue, const TaskPtr& task) -> void {
+				waiterThread = std::this_thread::get_id();
+				TaskGroup children(queue);
+				children.AddTask(std::make_shared<Task>(
+					(TaskExecutable)[&childThread](TasksQueue* queue, const TaskPtr& task) -> void {
+						childThread = std::this_thread::get_id();
+					},
+					TaskBlocking{ true }
+				));
+				children.Wait();
+			}
+		));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		EXPECT_EQ(root.GetPending(), 1u);			// The child waits for the blocking worker
+		release = true;
+		ASSERT_TRUE(root.WaitFor(std::chrono::seconds(5)));
+		EXPECT_NE(childThread, waiterThread);
+	}
+}
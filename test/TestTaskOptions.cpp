@@ -26,6 +26,13 @@ namespace TasksLib {
 		EXPECT_FALSE(opt.isMainThread);
 		EXPECT_EQ(opt.executable, nullptr);
 		EXPECT_EQ(opt.suspendTime, TaskDelay{ 0 });
+		EXPECT_EQ(opt.cancelTag, TaskCancelTag{});
+		EXPECT_EQ(opt.deadline, TaskDeadline::max());
+		EXPECT_EQ(opt.affinity, AFFINITY_NONE);
+		EXPECT_EQ(opt.period, TaskPeriod{});
+		EXPECT_EQ(opt.rateClass.value, 0u);
+		EXPECT_EQ(opt.footprint.bytes, 0u);
+		EXPECT_EQ(opt.dedupKey, TaskDedupKey{});
 	}
 	TEST_F(TaskOptionsTest, CreatesWithCopy) {
 		TaskOptions otherOpt = GenerateRandomOptions(randEng);
@@ -123,6 +130,65 @@ namespace TasksLib {
 		opt.SetOptions(TaskDelay{ dist(randEng) });
 		EXPECT_EQ(opt.suspendTime, ms);
 	}
+	TEST_F(TaskOptionsTest, SetsCancelTag) {
+		std::uniform_int_distribution<uint64_t> dist(1, UINT64_MAX);
+		TaskCancelTag tag{ dist(randEng) };
+
+		opt.SetOptions(tag);
+		EXPECT_EQ(opt.cancelTag, tag);
+		EXPECT_NE(opt, TaskOptions{});
+		opt.SetOptions(TaskCancelTag{});
+		EXPECT_EQ(opt.cancelTag.value, 0);
+	}
+	TEST_F(TaskOptionsTest, SetsDeadline) {
+		std::uniform_int_distribution<int> dist(1, INT_MAX);
+		TaskDeadline deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(dist(randEng));
+
+		opt.SetOptions(deadline);
+		EXPECT_EQ(opt.deadline, deadline);
+		EXPECT_NE(opt, TaskOptions{});
+	}
+	TEST_F(TaskOptionsTest, SetsAffinity) {
+		opt.SetOptions(AFFINITY_STICKY);
+		EXPECT_EQ(opt.affinity, AFFINITY_STICKY);
+		EXPECT_NE(opt, TaskOptions{});
+		opt.SetOptions(AFFINITY_NONE);
+		EXPECT_EQ(opt.affinity, AFFINITY_NONE);
+	}
+	TEST_F(TaskOptionsTest, SetsPeriod) {
+		std::uniform_int_distribution<int> dist(1, INT_MAX);
+		TaskPeriod period{ TaskDelay{ dist(randEng) }, PERIOD_FIXED_DELAY, OVERRUN_SKIP };
+
+		opt.SetOptions(period);
+		EXPECT_EQ(opt.period, period);
+		EXPECT_NE(opt, TaskOptions{});
+		opt.SetOptions(TaskPeriod{});
+		EXPECT_EQ(opt.period.interval, TaskDelay{ 0 });
+	}
+	TEST_F(TaskOptionsTest, SetsRateClass) {
+		std::uniform_int_distribution<uint32_t> dist(1, UINT32_MAX);
+		TaskRateClass rateClass{ dist(randEng) };
+
+		opt.SetOptions(rateClass);
+		EXPECT_EQ(opt.rateClass, rateClass);
+		EXPECT_NE(opt, TaskOptions{});
+	}
+	TEST_F(TaskOptionsTest, SetsFootprint) {
+		std::uniform_int_distribution<size_t> dist(1, SIZE_MAX);
+		TaskFootprint footprint{ dist(randEng) };
+
+		opt.SetOptions(footprint);
+		EXPECT_EQ(opt.footprint, footprint);
+		EXPECT_NE(opt, TaskOptions{});
+	}
+	TEST_F(TaskOptionsTest, SetsDedupKey) {
+		std::uniform_int_distribution<uint64_t> dist(1, UINT64_MAX);
+		TaskDedupKey dedupKey{ dist(randEng), DEDUP_DEBOUNCE };
+
+		opt.SetOptions(dedupKey);
+		EXPECT_EQ(opt.dedupKey, dedupKey);
+		EXPECT_NE(opt, TaskOptions{});
+	}
 	TEST_F(TaskOptionsTest, SetsMultipleOptions) {
 		// I'm annoyingly unable to return and hold in a variable a (tuple) of random length and element types to pass to SetOptions(),
 		// so this test is not covering the cases when SetOptions() is called with number of arguments between 2 and max-1.
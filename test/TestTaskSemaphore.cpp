@@ -0,0 +1,129 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "taskslib/Types.h"
+#include "TestTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TaskSemaphore.h"
+
+namespace TasksLib {
+
+	using namespace ::testing;
+
+	class TaskSemaphoreTest : public ::testing::Test {
+	public:
+		std::atomic<int> inside{ 0 };
+		std::atomic<int> mostInside{ 0 };
+		std::atomic<int> finished{ 0 };
+
+		/* A task that takes a permit, stays in the critical step for a moment and releases it */
+		TaskPtr MakeTask(TaskSemaphore& semaphore) {
+			auto critical = (TaskExecutable)[this, &semaphore](TasksQueue* queue, const TaskPtr& task) -> void {
+				const int now = ++inside;
+				int most = mostInside.load();
+				while ((now > most) && !mostInside.compare_exchange_weak(most, now)) {}
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				--inside;
+				++finished;
+				semaphore.Release();
+			};
+			return std::make_shared<Task>(
+				(TaskExecutable)[&semaphore, critical](TasksQueue* queue, const TaskPtr& task) -> void {
+					task->Reschedule(critical);
+					semaphore.Acquire(queue, task);
+				}
+			);
+		}
+	};
+
+	TEST_F(TaskSemaphoreTest, LimitsConcurrentTasks) {
+		TasksQueue queue{ { 8,0,1 } };
+		TaskSemaphore semaphore(3);
+
+		constexpr int NUM_TASKS = 40;
+		for (int i = 0; i < NUM_TASKS; ++i) {
+			ASSERT_TRUE(queue.AddTask(MakeTask(semaphore)));
+		}
+		ASSERT_TRUE(WaitFor([&]() { return finished == NUM_TASKS; }));
+		EXPECT_LE(mostInside, 3);
+		ASSERT_TRUE(WaitFor([&]() { return queue.GetPerformanceStats().total == 0; }));
+		EXPECT_EQ(semaphore.GetAvailable(), 3u);
+		EXPECT_EQ(semaphore.GetWaiting(), 0u);
+	}
+	TEST_F(TaskSemaphoreTest, WaitsWithoutHoldingWorker) {
+		// A single worker, the tasks waiting for the mutex leave it to the others
+		TasksQueue queue{ { 1,0,1 } };
+		TaskMutex mutex;
+		ASSERT_TRUE(mutex.TryLock());
+		EXPECT_FALSE(mutex.TryLock());
+
+		std::vector<int> order;
+		constexpr int NUM_TASKS = 5;
+		for (int i = 0; i < NUM_TASKS; ++i) {
+			ASSERT_TRUE(queue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&mutex, &order, i](TasksQueue* queue, const TaskPtr& task) -> void {
+					task->Reschedule((TaskExecutable)[&mutex, &order, i](TasksQueue* queue, const TaskPtr& task) -> void {
+						order.push_back(i);			// Guarded by the mutex
+						mutex.Unlock();
+					});
+					EXPECT_FALSE(mutex.Lock(queue, task));
+				}
+			)));
+		}
+		ASSERT_TRUE(WaitFor([&]() { return mutex.GetWaiting() == NUM_TASKS; }));
+
+		std::atomic<bool> executed{ false };
+		queue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&executed](TasksQueue* queue, const TaskPtr& task) -> void {
+				executed = true;
+			}
+		));
+		ASSERT_TRUE(WaitFor([&]() { return executed.load(); }));
+		EXPECT_EQ(queue.GetPerformanceStats().waiting, NUM_TASKS);
+
+		mutex.Unlock();
+		ASSERT_TRUE(WaitFor([&]() { return queue.GetPerformanceStats().total == 0; }));
+		EXPECT_FALSE(mutex.IsLocked());
+		EXPECT_EQ(order, (std::vector<int>{ 0, 1, 2, 3, 4 }));
+	}
+	TEST_F(TaskSemaphoreTest, PassesOverCancelledTask) {
+		TasksQueue queue{ { 1,0,1 } };
+		TaskMutex mutex;
+		ASSERT_TRUE(mutex.TryLock());
+
+		std::atomic<int> locked{ 0 };
+		auto makeWaiter = [&mutex, &locked]() -> TaskPtr {
+			return std::make_shared<Task>(
+				(TaskExecutable)[&mutex, &locked](TasksQueue* queue, const TaskPtr& task) -> void {
+					task->Reschedule((TaskExecutable)[&locked](TasksQueue* queue, const TaskPtr& task) -> void {
+						++locked;
+					});
+					mutex.Lock(queue, task);
+				}
+			);
+		};
+		auto cancelled = makeWaiter();
+		auto waiting = makeWaiter();
+		ASSERT_TRUE(queue.AddTask(cancelled));
+		ASSERT_TRUE(queue.AddTask(waiting));
+		ASSERT_TRUE(WaitFor([&]() { return (cancelled->GetStatus() == TASK_SUSPENDED) && (waiting->GetStatus() == TASK_SUSPENDED); }));
+
+		EXPECT_TRUE(queue.Cancel(cancelled));
+		mutex.Unlock();
+		ASSERT_TRUE(WaitFor([&]() { return waiting->GetStatus() == TASK_FINISHED; }));
+		EXPECT_EQ(locked, 1);
+		EXPECT_TRUE(mutex.IsLocked());			// The task that got it hasn't unlocked it
+		EXPECT_EQ(mutex.GetWaiting(), 0u);
+
+		mutex.Unlock();
+		EXPECT_FALSE(mutex.IsLocked());
+	}
+
+}
@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "taskslib/Types.h"
+#include "TestTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TasksObserver.h"
+
+namespace TasksLib {
+
+	using namespace ::testing;
+
+	class TasksObserverTest : public ::testing::Test {
+	public:
+		TasksQueue queue{ { 1,0,1 } };
+
+		TasksObserverTest() {
+			std::lock_guard<std::mutex> lock(TasksObserver::mutex);
+			TasksObserver::events.clear();			// Tasks of the previous tests may have had the same addresses
+		}
+
+		void WaitForQueue() {
+			for (int i = 0; (i < 1000) && (queue.GetPerformanceStats().total > 0); ++i) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				queue.Update();
+			}
+			ASSERT_EQ(queue.GetPerformanceStats().total, 0);
+		}
+	};
+
+	TEST_F(TasksObserverTest, ObservesTaskLifecycle) {
+		int runs = 0;
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+				if (++runs < 2) {
+					task->Reschedule();
+				}
+			},
+			TaskThreadTarget{ MAIN_THREAD }
+		);
+
+		queue.AddTask(task);
+		queue.Update();
+		queue.Update();
+
+		EXPECT_THAT(TasksObserver::GetEvents(task.get()), ElementsAre(
+			"enqueue", "dequeue", "begin", "end", "reschedule",
+			"enqueue", "dequeue", "begin", "end", "complete"
+		));
+	}
+	TEST_F(TasksObserverTest, ObservesSuspendAndResume) {
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskDelay{ 1 }
+		);
+
+		queue.AddTask(task);
+		WaitForQueue();
+
+		EXPECT_THAT(TasksObserver::GetEvents(task.get()), UnorderedElementsAre(
+			"suspend", "resume", "enqueue", "dequeue", "begin", "end", "complete"
+		));
+	}
+	TEST_F(TasksObserverTest, ObservesCancel) {
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskDelay{ 1000 }
+		);
+
+		queue.AddTask(task);
+		EXPECT_TRUE(queue.Cancel(task));
+
+		EXPECT_THAT(TasksObserver::GetEvents(task.get()), ElementsAre("suspend", "cancel"));
+	}
+	TEST_F(TasksObserverTest, ObservesCancelWhileExecuting) {
+		std::atomic<bool> started{ false };
+		std::atomic<bool> release{ false };
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&started, &release](TasksQueue* queue, const TaskPtr& task) -> void {
+				started = true;
+				while (!release) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				task->Reschedule();
+			}
+		);
+
+		queue.AddTask(task);
+		while (!started) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_TRUE(queue.Cancel(task));
+		release = true;
+		WaitForQueue();
+
+		EXPECT_THAT(TasksObserver::GetEvents(task.get()), Contains("cancel").Times(1));
+		EXPECT_THAT(TasksObserver::GetEvents(task.get()), Not(Contains("reschedule")));
+		EXPECT_THAT(TasksObserver::GetEvents(task.get()), Not(Contains("complete")));
+	}
+
+}
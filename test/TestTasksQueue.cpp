@@ -2,11 +2,16 @@
 
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
 
 #include "taskslib/Types.h"
 #include "TestTools.h"
 #include "taskslib/TasksQueue.h"
 #include "taskslib/Task.h"
+#include "taskslib/TaskGroup.h"
 
 namespace TasksLib {
 
@@ -48,7 +53,104 @@ namespace TasksLib {
 				EXPECT_EQ(stats.total, total) << helper;
 			}
 		}
+		// Runs a TaskPeriod task that busies itself for work[run] ms and cancels itself after numRuns, returns when each run started
+		std::vector<scheduleTimePoint> RunPeriodicTask(TaskPeriod period, int numRuns, std::vector<int> work = {}) {
+			std::mutex startsMutex;
+			std::vector<scheduleTimePoint> starts;
+			work.resize(numRuns, 0);
+
+			auto task = std::make_shared<Task>(
+				(TaskExecutable)[&startsMutex, &starts, &work, numRuns](TasksQueue* queue, const TaskPtr& task) -> void {
+					size_t run;
+					{
+						std::lock_guard<std::mutex> lock(startsMutex);
+						run = starts.size();
+						starts.push_back(scheduleClock::now());
+					}
+					std::this_thread::sleep_for(std::chrono::milliseconds(work[run]));
+					if (run + 1 == static_cast<size_t>(numRuns)) {
+						queue->Cancel(task);
+					}
+				},
+				period
+			);
+			queue.AddTask(task);
+
+			// Nothing calls Update(), the scheduling thread wakes up for each period by itself
+			auto until = scheduleClock::now() + period.interval * numRuns * 3 + std::chrono::milliseconds(100);
+			while (((task->GetStatus() != TaskStatus::TASK_CANCELLED) || (queue.GetPerformanceStats().total > 0)) && (scheduleClock::now() < until)) {
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+			EXPECT_EQ(task->GetStatus(), TaskStatus::TASK_CANCELLED);
+
+			std::lock_guard<std::mutex> lock(startsMutex);
+			return starts;
+		}
+	};
+	class TasksQueueDeadlineTest : public TasksQueueTest {
+	public:
+		TasksQueue deadlineQueue;
+		std::atomic<bool> release{ false };
+		std::mutex orderMutex;
+		std::vector<int> order;
+
+		void InitDeadlineQueue(const TaskDeadlineMissPolicy missPolicy) {
+			TasksQueue::Configuration config{ 1,0,1 };
+			config.policy = POLICY_DEADLINE;
+			config.deadlineMissPolicy = missPolicy;
+			InitGatedQueue(config);
+		}
+		// Single worker, held by a gate task until release is set, so that the queue can be filled up first
+		void InitGatedQueue(const TasksQueue::Configuration& config) {
+			deadlineQueue.Initialize(config);
+			ASSERT_TRUE(deadlineQueue.isInitialized());
+
+			deadlineQueue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[this](TasksQueue* queue, const TaskPtr& task) -> void {
+					while (!release) {
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					}
+				}
+			));
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		void AddOrderedTask(const int id, const TaskDeadline deadline) {
+			deadlineQueue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[this, id](TasksQueue* queue, const TaskPtr& task) -> void {
+					std::lock_guard<std::mutex> lock(orderMutex);
+					order.push_back(id);
+				},
+				deadline
+			));
+		}
+		void AddPriorityTask(const int id, const TaskPriority priority, const std::chrono::milliseconds duration = std::chrono::milliseconds(0)) {
+			deadlineQueue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[this, id, duration](TasksQueue* queue, const TaskPtr& task) -> void {
+					std::this_thread::sleep_for(duration);
+					std::lock_guard<std::mutex> lock(orderMutex);
+					order.push_back(id);
+				},
+				priority
+			));
+		}
+		TaskAddResult TryAddOrderedTask(const int id, const TaskFootprint footprint = TaskFootprint{}) {
+			return deadlineQueue.TryAddTask(std::make_shared<Task>(
+				(TaskExecutable)[this, id](TasksQueue* queue, const TaskPtr& task) -> void {
+					std::lock_guard<std::mutex> lock(orderMutex);
+					order.push_back(id);
+				},
+				footprint
+			));
+		}
+		bool WaitForCompleted(const uint32_t count) {
+			auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+			while ((deadlineQueue.GetPerformanceStats().completed < count) && (std::chrono::steady_clock::now() < until)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			return deadlineQueue.GetPerformanceStats().completed >= count;
+		}
 	};
+
 	TEST_F(TasksQueueTest, Creates) {
 		TasksQueue checkQueue;
 
@@ -164,6 +266,61 @@ namespace TasksLib {
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
 		CheckStats(1, 1, -1, -1, -1, 0, "AddsTaskMainThread: Should run in the main thread");
 	}
+	TEST_F(TasksQueueTest, RunsMainThreadTasksInOrder) {
+		std::vector<int> order;
+		for (int i = 0; i < 100; i++) {
+			queue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&order, i](TasksQueue* queue, const TaskPtr& task) -> void {
+					order.push_back(i);
+				},
+				TaskThreadTarget{ MAIN_THREAD }
+			));
+		}
+
+		queue.Update();
+		ASSERT_EQ(order.size(), 100u);
+		for (int i = 0; i < 100; i++) {
+			EXPECT_EQ(order[i], i);
+		}
+		CheckStats(100, 100, -1, -1, -1, 0);
+	}
+	TEST_F(TasksQueueTest, AddsMainThreadTasksFromManyThreads) {
+		constexpr int numThreads = 4;
+		constexpr int numTasks = 2000;
+		std::vector<std::vector<int>> order(numThreads);
+		std::atomic<int> producing{ numThreads };
+		std::vector<std::thread> producers;
+
+		for (int t = 0; t < numThreads; t++) {
+			producers.emplace_back([this, t, &order, &producing]() {
+				for (int i = 0; i < numTasks; i++) {
+					queue.AddTask(std::make_shared<Task>(
+						(TaskExecutable)[&order, t, i](TasksQueue* queue, const TaskPtr& task) -> void {
+							order[t].push_back(i);
+						},
+						TaskThreadTarget{ MAIN_THREAD }
+					));
+				}
+				--producing;
+			});
+		}
+
+		auto until = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while ((producing > 0) || (queue.GetPerformanceStats().total > 0)) {
+			queue.Update();
+			if (std::chrono::steady_clock::now() > until) {
+				break;
+			}
+		}
+		for (auto& producer : producers) {
+			producer.join();
+		}
+
+		for (int t = 0; t < numThreads; t++) {
+			ASSERT_EQ(order[t].size(), (size_t)numTasks) << "Thread " << t;
+			EXPECT_TRUE(std::is_sorted(order[t].begin(), order[t].end())) << "Thread " << t;
+		}
+	}
 	TEST_F(TasksQueueTest, IgnoresBlockingProperly) {
 		bool threadSet = false;
 		for (int i = 0; i < 4; i++) {
@@ -402,4 +559,1069 @@ namespace TasksLib {
 		EXPECT_EQ(task->GetStatus(), TaskStatus::TASK_SUSPENDED);
 		EXPECT_EQ(task->GetOptions().suspendTime, delay);
 	}
+	TEST_F(TasksQueueTest, CancelsSuspendedTask) {
+		bool threadSet = false;
+		auto captured = std::make_shared<int>(0);
+
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&threadSet, captured](TasksQueue* queue, const TaskPtr& task) -> void {
+				threadSet = true;
+			},
+			TaskDelay{ 50 }
+		);
+		queue.AddTask(task);
+		ASSERT_EQ(task->GetStatus(), TaskStatus::TASK_SUSPENDED);
+		ASSERT_EQ(captured.use_count(), 2);
+
+		EXPECT_TRUE(queue.Cancel(task));
+		EXPECT_EQ(task->GetStatus(), TaskStatus::TASK_CANCELLED);
+		EXPECT_EQ(captured.use_count(), 1);			// The captured state is released right away
+		EXPECT_FALSE(queue.Cancel(task));
+		EXPECT_FALSE(queue.AddTask(task));
+		CheckStats(1, 0, 1, 0, 0, 0, "Should have cancelled the task");
+		EXPECT_EQ(queue.GetPerformanceStats().cancelled, 1);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(70));
+		queue.Update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		EXPECT_FALSE(threadSet);
+		CheckStats(1, 0, 1, 0, 0, 0, "Should not resume the task");
+	}
+	TEST_F(TasksQueueTest, RefusesTaskThatIsOnQueue) {
+		TasksQueue otherQueue{ { 1,0,1 } };
+		std::atomic<int> runs{ 0 };
+		std::atomic<TaskAddResult> ownResult{ ADD_OK };
+		std::atomic<TaskAddResult> otherResult{ ADD_OK };
+
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&](TasksQueue* queue, const TaskPtr& task) -> void {
+				// Adding itself while it runs, here and on another queue
+				ownResult = queue->TryAddTask(task);
+				otherResult = otherQueue.TryAddTask(task);
+				++runs;
+			}
+		);
+		ASSERT_TRUE(queue.AddTask(task));
+		auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+		while ((task->GetStatus() != TaskStatus::TASK_FINISHED) && (std::chrono::steady_clock::now() < until)) {
+			std::this_thread::yield();
+		}
+		ASSERT_EQ(task->GetStatus(), TaskStatus::TASK_FINISHED);
+		EXPECT_EQ(ownResult, ADD_INVALID);
+		EXPECT_EQ(otherResult, ADD_INVALID);
+		EXPECT_EQ(runs, 1);
+		EXPECT_EQ(queue.GetPerformanceStats().cancelled, 0);
+		EXPECT_EQ(otherQueue.GetPerformanceStats().added, 0);
+
+		// Queued on the main thread lane, and then finished and added again
+		auto mainTask = std::make_shared<Task>(
+			(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+				++runs;
+			},
+			TaskThreadTarget{ MAIN_THREAD }
+		);
+		ASSERT_TRUE(queue.AddTask(mainTask));
+		EXPECT_EQ(otherQueue.TryAddTask(mainTask), ADD_INVALID);
+		EXPECT_EQ(queue.TryAddTask(mainTask), ADD_INVALID);
+		queue.Update();
+		EXPECT_EQ(runs, 2);
+		EXPECT_EQ(otherQueue.TryAddTask(mainTask), ADD_OK);
+		otherQueue.Update();
+		EXPECT_EQ(runs, 3);
+	}
+	TEST_F(TasksQueueTest, DoesNotCancelOtherQueuesTask) {
+		TasksQueue otherQueue{ { 1,0,1 } };
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskDelay{ 50 }
+		);
+		otherQueue.AddTask(task);
+		ASSERT_EQ(task->GetStatus(), TaskStatus::TASK_SUSPENDED);
+
+		EXPECT_FALSE(queue.Cancel(task));
+		EXPECT_EQ(task->GetStatus(), TaskStatus::TASK_SUSPENDED);
+		EXPECT_EQ(queue.GetPerformanceStats().cancelled, 0);
+
+		EXPECT_TRUE(otherQueue.Cancel(task));
+		EXPECT_EQ(otherQueue.GetPerformanceStats().waiting, 0);
+		EXPECT_EQ(otherQueue.GetPerformanceStats().cancelled, 1);
+	}
+	TEST_F(TasksQueueTest, CancelsQueuedTask) {
+		bool threadSet = false;
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&threadSet](TasksQueue* queue, const TaskPtr& task) -> void {
+				threadSet = true;
+			},
+			TaskThreadTarget{ MAIN_THREAD }
+		);
+		queue.AddTask(task);
+		ASSERT_EQ(task->GetStatus(), TaskStatus::TASK_IN_QUEUE_MAIN_THREAD);
+
+		EXPECT_TRUE(queue.Cancel(task));
+		queue.Update();
+		EXPECT_FALSE(threadSet);
+		CheckStats(1, 0, -1, -1, -1, 0, "Should have cancelled the task");
+		EXPECT_EQ(queue.GetPerformanceStats().cancelled, 1);
+	}
+	TEST_F(TasksQueueTest, CancelsWorkingTask) {
+		std::atomic<int> runs{ 0 };
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+				++runs;
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				task->Reschedule();
+			}
+		);
+		queue.AddTask(task);
+
+		auto now = std::chrono::steady_clock::now();
+		while ((task->GetStatus() != TaskStatus::TASK_WORKING) && (std::chrono::steady_clock::now() < now + std::chrono::milliseconds(50))) {
+			std::this_thread::yield();
+		}
+		ASSERT_EQ(task->GetStatus(), TaskStatus::TASK_WORKING);
+		EXPECT_TRUE(queue.Cancel(task));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(60));
+		EXPECT_EQ(runs, 1);
+		EXPECT_EQ(task->GetStatus(), TaskStatus::TASK_CANCELLED);
+		CheckStats(1, 0, -1, -1, -1, 0, "Should finish the current run and not reschedule");
+		EXPECT_EQ(queue.GetPerformanceStats().cancelled, 1);
+	}
+	TEST_F(TasksQueueTest, ReschedulesConcurrentlyWithStatusReads) {
+		constexpr int numTasks = 40;
+		constexpr int numRuns = 100;
+		std::vector<TaskPtr> tasks;
+		std::vector<std::atomic<int>> runs(numTasks);
+
+		for (int i = 0; i < numTasks; i++) {
+			tasks.push_back(std::make_shared<Task>(
+				(TaskExecutable)[&runs, i](TasksQueue* queue, const TaskPtr& task) -> void {
+					const int run = ++runs[i];
+					if (run < numRuns) {
+						// Hop between the lanes, every change of options has to reach the queue intact
+						task->Reschedule(TaskBlocking{ (run % 2) == 0 }, TaskThreadTarget{ (run % 10) == 0 ? MAIN_THREAD : WORKER_THREAD });
+					}
+				}
+			));
+		}
+
+		std::atomic<bool> done{ false };
+		std::vector<std::thread> readers;
+		for (int r = 0; r < 2; r++) {
+			readers.emplace_back([&tasks, &done]() {
+				while (!done) {
+					for (const TaskPtr& task : tasks) {
+						const TaskStatus status = task->GetStatus();
+						EXPECT_TRUE((status >= TASK_FINISHED) && (status <= TASK_CANCELLED));
+						(void)task->WillReschedule();
+					}
+				}
+			});
+		}
+
+		for (const TaskPtr& task : tasks) {
+			queue.AddTask(task);
+		}
+		std::thread canceller([this, &tasks]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			for (int i = 0; i < numTasks; i += 4) {
+				queue.Cancel(tasks[i]);
+			}
+		});
+
+		auto until = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while ((queue.GetPerformanceStats().total > 0) && (std::chrono::steady_clock::now() < until)) {
+			queue.Update();
+		}
+		canceller.join();
+		done = true;
+		for (auto& reader : readers) {
+			reader.join();
+		}
+
+		auto stats = queue.GetPerformanceStats();
+		EXPECT_EQ(stats.total, 0);
+		EXPECT_EQ(stats.completed + stats.cancelled, (uint32_t)numTasks);
+		for (int i = 0; i < numTasks; i++) {
+			if (tasks[i]->GetStatus() == TaskStatus::TASK_CANCELLED) {
+				EXPECT_LE(runs[i], numRuns);
+			} else {
+				EXPECT_EQ(tasks[i]->GetStatus(), TaskStatus::TASK_FINISHED) << "Task " << i;
+				EXPECT_EQ(runs[i], numRuns) << "Task " << i;
+			}
+		}
+	}
+	TEST_F(TasksQueueTest, KeepsStickyTaskOnItsWorker) {
+		std::mutex threadsMutex;
+		std::vector<std::thread::id> threads;
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&threadsMutex, &threads](TasksQueue* queue, const TaskPtr& task) -> void {
+				std::lock_guard<std::mutex> lock(threadsMutex);
+				threads.push_back(std::this_thread::get_id());
+				if (threads.size() < 20) {
+					task->Reschedule();
+				}
+			},
+			AFFINITY_STICKY
+		);
+		queue.AddTask(task);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		ASSERT_EQ(task->GetStatus(), TaskStatus::TASK_FINISHED);
+		ASSERT_EQ(threads.size(), 20u);
+		EXPECT_EQ(std::count(threads.begin(), threads.end(), threads.front()), 20);
+
+		auto stats = queue.GetPerformanceStats();
+		EXPECT_EQ(stats.executedLocal, 19);
+		EXPECT_EQ(stats.executedMigrated, 0);
+		EXPECT_EQ(stats.completed, 1);
+	}
+	TEST_F(TasksQueueTest, MovesTaskWithoutAffinity) {
+		std::atomic<int> runs{ 0 };
+		queue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+				if (++runs < 20) {
+					task->Reschedule();
+				}
+			},
+			AFFINITY_NONE
+		));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		ASSERT_EQ(runs, 20);
+		auto stats = queue.GetPerformanceStats();
+		EXPECT_EQ(stats.executedLocal, 0);
+		EXPECT_LE(stats.executedMigrated, 19);
+	}
+	TEST_F(TasksQueueDeadlineTest, LetsWaitingTasksGoFirstWithAutoAffinity) {
+		InitGatedQueue({ 1,0,1 });
+		std::atomic<bool> added{ false };
+		int runs = 0;
+
+		deadlineQueue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[this, &added, &runs](TasksQueue* queue, const TaskPtr& task) -> void {
+				while (!added) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				{
+					std::lock_guard<std::mutex> lock(orderMutex);
+					order.push_back(0);
+				}
+				if (++runs < 4) {
+					task->Reschedule();
+				}
+			},
+			AFFINITY_AUTO
+		));
+		for (int i = 1; i <= 3; i++) {
+			AddPriorityTask(i, 0);
+		}
+		added = true;
+		release = true;
+
+		ASSERT_TRUE(WaitForCompleted(5));
+		// Waits behind the others once, then the queue is empty and it stays on the worker
+		EXPECT_EQ(order, std::vector<int>({ 0, 1, 2, 3, 0, 0, 0 }));
+		EXPECT_EQ(deadlineQueue.GetPerformanceStats().executedLocal, 2);
+	}
+	TEST_F(TasksQueueTest, RunsPeriodicTaskAtFixedRate) {
+		auto starts = RunPeriodicTask(TaskPeriod{ TaskDelay{ 20 }, PERIOD_FIXED_RATE }, 8, std::vector<int>(8, 8));
+		ASSERT_EQ(starts.size(), 8u);
+
+		// The 8 ms each run takes doesn't push the later ones back, the grid starts a moment before the first callback does
+		for (size_t i = 1; i < starts.size(); i++) {
+			EXPECT_GE(starts[i] - starts[0], std::chrono::milliseconds(20 * i - 2)) << "Run " << i;
+		}
+		EXPECT_LT(starts[7] - starts[0], std::chrono::milliseconds(140 + 15));
+		CheckStats(1, 0, -1, -1, 0, 0, "Should have nothing left on the timer");
+	}
+	TEST_F(TasksQueueTest, RunsPeriodicTaskWithFixedDelay) {
+		auto starts = RunPeriodicTask(TaskPeriod{ TaskDelay{ 20 }, PERIOD_FIXED_DELAY }, 4, std::vector<int>(4, 10));
+		ASSERT_EQ(starts.size(), 4u);
+
+		for (size_t i = 1; i < starts.size(); i++) {
+			EXPECT_GE(starts[i] - starts[i - 1], std::chrono::milliseconds(30)) << "Run " << i;
+		}
+	}
+	TEST_F(TasksQueueTest, CatchesUpMissedPeriods) {
+		auto starts = RunPeriodicTask(TaskPeriod{ TaskDelay{ 20 }, PERIOD_FIXED_RATE, OVERRUN_CATCH_UP }, 4, { 50 });
+		ASSERT_EQ(starts.size(), 4u);
+
+		// The runs due at 20 and 40 ms go right after the first one without the timer, the one due at 60 ms waits for its time
+		EXPECT_LE(queue.GetPerformanceStats().suspended, 1);
+		EXPECT_GE(starts[3] - starts[0], std::chrono::milliseconds(60 - 2));
+		EXPECT_EQ(queue.GetPerformanceStats().periodsSkipped, 0);
+	}
+	TEST_F(TasksQueueTest, SkipsMissedPeriods) {
+		auto starts = RunPeriodicTask(TaskPeriod{ TaskDelay{ 20 }, PERIOD_FIXED_RATE, OVERRUN_SKIP }, 3, { 50 });
+		ASSERT_EQ(starts.size(), 3u);
+
+		// The runs due at 20 and 40 ms are dropped, the schedule stays on the 20 ms grid
+		EXPECT_GE(starts[1] - starts[0], std::chrono::milliseconds(60 - 2));
+		EXPECT_GE(starts[2] - starts[0], std::chrono::milliseconds(80 - 2));
+		EXPECT_GE(queue.GetPerformanceStats().periodsSkipped, 2);
+	}
+	TEST_F(TasksQueueTest, LimitsRateOfClass) {
+		constexpr int numTasks = 6;
+		std::mutex startsMutex;
+		std::vector<scheduleTimePoint> starts;
+		std::vector<int> order;
+		ASSERT_TRUE(queue.SetRateLimit(TaskRateClass{ 1 }, 100.0, 2));
+
+		auto begin = scheduleClock::now();
+		for (int i = 0; i < numTasks; i++) {
+			queue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&startsMutex, &starts, &order, i](TasksQueue* queue, const TaskPtr& task) -> void {
+					std::lock_guard<std::mutex> lock(startsMutex);
+					starts.push_back(scheduleClock::now());
+					order.push_back(i);
+				},
+				TaskRateClass{ 1 }
+			));
+		}
+		CheckStats(numTasks, -1, 0, -1, -1, -1, "Should not put the tasks on the timer");
+		EXPECT_EQ(queue.GetPerformanceStats().throttled, numTasks - 2);
+
+		// Nothing calls Update(), the scheduling thread wakes up for the next token by itself
+		auto until = begin + std::chrono::milliseconds(500);
+		while ((queue.GetPerformanceStats().completed < numTasks) && (scheduleClock::now() < until)) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		CheckStats(numTasks, numTasks, 0, 0, 0, 0, "Should have run all tasks");
+
+		// The burst goes right away, then one task per 10 ms in the order they were added
+		std::lock_guard<std::mutex> lock(startsMutex);
+		ASSERT_EQ(order.size(), static_cast<size_t>(numTasks));
+		EXPECT_EQ(std::vector<int>(order.begin() + 2, order.end()), std::vector<int>({ 2, 3, 4, 5 }));
+		for (int i = 2; i < numTasks; i++) {
+			EXPECT_GE(starts[i] - begin, std::chrono::milliseconds(10 * (i - 1)) - std::chrono::microseconds(100)) << "Task " << i;
+		}
+	}
+	TEST_F(TasksQueueTest, WorkersReleaseRateLimitedTasksWithoutSchedulingThread) {
+		TasksQueue rateQueue{ { 2,0,0 } };
+		std::atomic<int> runs{ 0 };
+		ASSERT_TRUE(rateQueue.SetRateLimit(TaskRateClass{ 1 }, 200.0, 1));
+
+		for (int i = 0; i < 4; i++) {
+			rateQueue.AddTask(std::make_shared<Task>((TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void { ++runs; }, TaskRateClass{ 1 }));
+		}
+		auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+		while ((runs < 4) && (std::chrono::steady_clock::now() < until)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_EQ(runs, 4);
+	}
+	TEST_F(TasksQueueTest, CancelsTaskHeldByRateLimit) {
+		auto captured = std::make_shared<int>(0);
+		ASSERT_TRUE(queue.SetRateLimit(TaskRateClass{ 7 }, 1.0));
+
+		auto first = std::make_shared<Task>((TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {}, TaskRateClass{ 7 });
+		auto second = std::make_shared<Task>((TaskExecutable)[captured](TasksQueue* queue, const TaskPtr& task) -> void {}, TaskRateClass{ 7 });
+		queue.AddTask(first);
+		queue.AddTask(second);
+		EXPECT_EQ(second->GetStatus(), TaskStatus::TASK_SUSPENDED);
+		CheckStats(2, -1, 0, 0, 1, -1, "Should hold the second task back");
+
+		EXPECT_TRUE(queue.Cancel(second));
+		EXPECT_EQ(second->GetStatus(), TaskStatus::TASK_CANCELLED);
+		EXPECT_EQ(captured.use_count(), 1);
+		CheckStats(2, -1, 0, 0, 0, -1, "Should have taken the task off the rate limit");
+	}
+	TEST_F(TasksQueueTest, ReleasesTasksWhenRateLimitIsRemoved) {
+		std::atomic<int> runs{ 0 };
+		ASSERT_TRUE(queue.SetRateLimit(TaskRateClass{ 3 }, 1.0));
+		EXPECT_FALSE(queue.SetRateLimit(TaskRateClass{}, 1.0));
+		EXPECT_FALSE(queue.SetRateLimit(TaskRateClass{ 3 }, 1.0, 0));
+
+		for (int i = 0; i < 3; i++) {
+			queue.AddTask(std::make_shared<Task>((TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void { ++runs; }, TaskRateClass{ 3 }));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		EXPECT_EQ(runs, 1);
+
+		ASSERT_TRUE(queue.SetRateLimit(TaskRateClass{ 3 }, 0.0));
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		EXPECT_EQ(runs, 3);
+		CheckStats(3, 3, -1, -1, 0, 0, "Should have run the released tasks");
+	}
+	TEST_F(TasksQueueDeadlineTest, RejectsTasksOverCapacity) {
+		TasksQueue::Configuration config{ 1,0,1 };
+		config.capacity.maxTasks = 3;
+		InitGatedQueue(config);
+
+		EXPECT_EQ(TryAddOrderedTask(1), ADD_OK);
+		EXPECT_EQ(TryAddOrderedTask(2), ADD_OK);
+		EXPECT_EQ(TryAddOrderedTask(3), ADD_FULL);			// The gate task that is executing counts too
+		EXPECT_EQ(TryAddOrderedTask(0), ADD_FULL);
+		EXPECT_EQ(deadlineQueue.TryAddTask(nullptr), ADD_INVALID);
+
+		auto stats = deadlineQueue.GetPerformanceStats();
+		EXPECT_EQ(stats.total, 3);
+		EXPECT_EQ(stats.overflowRejected, 2);
+
+		release = true;
+		ASSERT_TRUE(WaitForCompleted(3));
+		EXPECT_EQ(TryAddOrderedTask(4), ADD_OK);
+		ASSERT_TRUE(WaitForCompleted(4));
+		EXPECT_EQ(order, std::vector<int>({ 1, 2, 4 }));
+	}
+	TEST_F(TasksQueueDeadlineTest, DropsOldestTaskOverCapacity) {
+		TasksQueue::Configuration config{ 1,0,1 };
+		config.capacity.maxTasks = 3;
+		config.capacity.overflowPolicy = OVERFLOW_DROP_OLDEST;
+		InitGatedQueue(config);
+
+		for (int i = 1; i <= 4; i++) {
+			EXPECT_EQ(TryAddOrderedTask(i), ADD_OK) << "Task " << i;
+		}
+		auto stats = deadlineQueue.GetPerformanceStats();
+		EXPECT_EQ(stats.total, 3);
+		EXPECT_EQ(stats.overflowDropped, 2);
+		EXPECT_EQ(stats.overflowRejected, 0);
+
+		release = true;
+		ASSERT_TRUE(WaitForCompleted(3));
+		EXPECT_EQ(order, std::vector<int>({ 3, 4 }));
+	}
+	TEST_F(TasksQueueDeadlineTest, DropsOldestTaskByDeadlinePolicy) {
+		TasksQueue::Configuration config{ 1,0,1 };
+		config.policy = POLICY_DEADLINE;
+		config.capacity.maxTasks = 4;
+		config.capacity.overflowPolicy = OVERFLOW_DROP_OLDEST;
+		InitGatedQueue(config);
+
+		// The oldest task has the latest deadline, it is the last one the policy would take
+		const auto now = std::chrono::steady_clock::now();
+		AddOrderedTask(1, now + std::chrono::seconds(4));
+		AddOrderedTask(2, now + std::chrono::seconds(3));
+		AddOrderedTask(3, now + std::chrono::seconds(1));
+		AddOrderedTask(4, now + std::chrono::seconds(2));
+		EXPECT_EQ(deadlineQueue.GetPerformanceStats().overflowDropped, 1);
+
+		release = true;
+		ASSERT_TRUE(WaitForCompleted(4));
+		EXPECT_EQ(order, std::vector<int>({ 3, 4, 2 }));
+	}
+	TEST_F(TasksQueueDeadlineTest, BlocksUntilThereIsRoom) {
+		TasksQueue::Configuration config{ 1,0,1 };
+		config.capacity.maxTasks = 2;
+		config.capacity.overflowPolicy = OVERFLOW_BLOCK;
+		config.capacity.overflowTimeout = std::chrono::milliseconds(20);
+		InitGatedQueue(config);
+
+		EXPECT_EQ(TryAddOrderedTask(1), ADD_OK);
+		auto begin = std::chrono::steady_clock::now();
+		EXPECT_EQ(TryAddOrderedTask(2), ADD_TIMED_OUT);
+		EXPECT_GE(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(20));
+
+		std::thread releaser([this] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			release = true;
+		});
+		EXPECT_EQ(TryAddOrderedTask(3), ADD_OK);
+		releaser.join();
+
+		ASSERT_TRUE(WaitForCompleted(3));
+		EXPECT_EQ(order, std::vector<int>({ 1, 3 }));
+		EXPECT_EQ(deadlineQueue.GetPerformanceStats().overflowRejected, 1);
+	}
+	TEST_F(TasksQueueDeadlineTest, LimitsBytesOfQueuedTasks) {
+		const size_t taskBytes = sizeof(Task) + 1000;
+		TasksQueue::Configuration config{ 1,0,1 };
+		config.capacity.maxBytes = 3 * taskBytes;
+		InitGatedQueue(config);
+
+		EXPECT_EQ(TryAddOrderedTask(1, TaskFootprint{ 1000 }), ADD_OK);
+		EXPECT_EQ(TryAddOrderedTask(2, TaskFootprint{ 1000 }), ADD_OK);
+		EXPECT_EQ(TryAddOrderedTask(3, TaskFootprint{ 1000 }), ADD_FULL);		// Together with the gate task it would be over
+		EXPECT_EQ(deadlineQueue.GetPerformanceStats().bytes, sizeof(Task) + 2 * taskBytes);
+
+		release = true;
+		ASSERT_TRUE(WaitForCompleted(3));
+		EXPECT_EQ(deadlineQueue.GetPerformanceStats().bytes, 0);
+	}
+	TEST_F(TasksQueueTest, CancelsByTag) {
+		std::uniform_int_distribution<uint64_t> dist(1, UINT64_MAX - 1);
+		const TaskCancelTag tag{ dist(randEng) };
+		const TaskCancelTag otherTag{ tag.value + 1 };
+		std::atomic<int> runs{ 0 };
+		auto lambda = [&runs](TasksQueue* queue, const TaskPtr& task) -> void { ++runs; };
+
+		for (int i = 0; i < 100; i++) {
+			queue.AddTask(std::make_shared<Task>((TaskExecutable)lambda, TaskDelay{ 30 }, tag));
+		}
+		for (int i = 0; i < 10; i++) {
+			queue.AddTask(std::make_shared<Task>((TaskExecutable)lambda, TaskThreadTarget{ MAIN_THREAD }, (i % 2) ? tag : otherTag));
+		}
+
+		EXPECT_EQ(queue.CancelTag(tag), 105);
+		EXPECT_EQ(queue.CancelTag(tag), 0);
+		EXPECT_EQ(queue.CancelTag(TaskCancelTag{}), 0);
+		CheckStats(110, 0, 100, 0, 0, 5, "Should have cancelled the tagged tasks");
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		queue.Update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		EXPECT_EQ(runs, 5);
+		CheckStats(110, 5, 100, 0, 0, 0, "Should run only the other tasks");
+	}
+	TEST_F(TasksQueueTest, DoesNotCancelFinishedTask) {
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskThreadTarget{ MAIN_THREAD }
+		);
+		EXPECT_FALSE(queue.Cancel(task));
+		EXPECT_FALSE(queue.Cancel(nullptr));
+
+		queue.AddTask(task);
+		queue.Update();
+		ASSERT_EQ(task->GetStatus(), TaskStatus::TASK_FINISHED);
+		EXPECT_FALSE(queue.Cancel(task));
+		EXPECT_EQ(queue.GetPerformanceStats().cancelled, 0);
+	}
+	TEST_F(TasksQueueTest, KeepsFirstOfDuplicates) {
+		const TaskDedupKey key{ 42, DEDUP_KEEP_FIRST };
+		std::vector<int> runs;
+		auto addTask = [this, &runs, &key](int id) -> TaskAddResult {
+			return queue.TryAddTask(std::make_shared<Task>(
+				(TaskExecutable)[&runs, id](TasksQueue* queue, const TaskPtr& task) -> void { runs.push_back(id); },
+				TaskThreadTarget{ MAIN_THREAD },
+				key
+			));
+		};
+
+		EXPECT_EQ(addTask(1), ADD_OK);
+		EXPECT_EQ(addTask(2), ADD_MERGED);
+		EXPECT_EQ(addTask(3), ADD_MERGED);
+		EXPECT_TRUE(queue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void { runs.push_back(4); },
+			TaskThreadTarget{ MAIN_THREAD },
+			key
+		)));
+
+		// A merged task is done for its group, it doesn't keep the group waiting
+		TaskGroup group(&queue);
+		EXPECT_TRUE(group.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskThreadTarget{ MAIN_THREAD },
+			key
+		)));
+		EXPECT_EQ(group.GetPending(), 0u);
+
+		queue.Update();
+		EXPECT_EQ(runs, std::vector<int>({ 1 }));
+		CheckStats(1, 1, -1, -1, -1, 0, "Should have added only the first task");
+		EXPECT_EQ(queue.GetPerformanceStats().deduplicated, 4);
+
+		// Nothing is pending anymore, the key is free
+		EXPECT_EQ(addTask(5), ADD_OK);
+		queue.Update();
+		EXPECT_EQ(runs, std::vector<int>({ 1, 5 }));
+	}
+	TEST_F(TasksQueueTest, ReplacesDuplicates) {
+		const TaskDedupKey key{ 42, DEDUP_REPLACE };
+		std::vector<int> runs;
+		std::vector<TaskPtr> tasks;
+		for (int id = 1; id <= 3; id++) {
+			tasks.push_back(std::make_shared<Task>(
+				(TaskExecutable)[&runs, id](TasksQueue* queue, const TaskPtr& task) -> void { runs.push_back(id); },
+				TaskThreadTarget{ MAIN_THREAD },
+				key
+			));
+			EXPECT_EQ(queue.TryAddTask(tasks.back()), ADD_OK);
+		}
+		// Other keys are left alone
+		EXPECT_EQ(queue.TryAddTask(std::make_shared<Task>(
+			(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void { runs.push_back(4); },
+			TaskThreadTarget{ MAIN_THREAD },
+			TaskDedupKey{ 43, DEDUP_REPLACE }
+		)), ADD_OK);
+
+		EXPECT_EQ(tasks[0]->GetStatus(), TaskStatus::TASK_CANCELLED);
+		EXPECT_EQ(tasks[1]->GetStatus(), TaskStatus::TASK_CANCELLED);
+		EXPECT_EQ(queue.TryAddTask(tasks[2]), ADD_INVALID);		// Already pending, not a duplicate of itself
+
+		queue.Update();
+		EXPECT_EQ(runs, std::vector<int>({ 3, 4 }));
+		auto stats = queue.GetPerformanceStats();
+		EXPECT_EQ(stats.deduplicated, 2);
+		EXPECT_EQ(stats.cancelled, 2);
+		EXPECT_EQ(stats.total, 0);
+	}
+	TEST_F(TasksQueueTest, MergesWithTaskBeingAdded) {
+		TasksQueue::Configuration config{ 1,0,1 };
+		config.capacity.maxTasks = 1;
+		config.capacity.overflowPolicy = OVERFLOW_BLOCK;
+		config.capacity.overflowTimeout = std::chrono::milliseconds(2000);
+		TasksQueue fullQueue(config);
+		const TaskDedupKey key{ 42, DEDUP_KEEP_FIRST };
+		std::vector<int> runs;
+		auto makeTask = [&runs, &key](int id) -> TaskPtr {
+			return std::make_shared<Task>(
+				(TaskExecutable)[&runs, id](TasksQueue* queue, const TaskPtr& task) -> void { runs.push_back(id); },
+				TaskThreadTarget{ MAIN_THREAD },
+				key
+			);
+		};
+
+		// The first task is indexed under the key, then waits for room - it is being added, not pending yet
+		ASSERT_TRUE(fullQueue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskThreadTarget{ MAIN_THREAD }
+		)));
+		std::thread adder([&fullQueue, &makeTask]() {
+			EXPECT_EQ(fullQueue.TryAddTask(makeTask(1)), ADD_OK);
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		EXPECT_EQ(fullQueue.TryAddTask(makeTask(2)), ADD_MERGED);
+		fullQueue.Update();
+		adder.join();
+		fullQueue.Update();
+		EXPECT_EQ(runs, std::vector<int>({ 1 }));
+		EXPECT_EQ(fullQueue.GetPerformanceStats().deduplicated, 1);
+	}
+	TEST_F(TasksQueueTest, DeduplicatesConcurrentAdds) {
+		// Main thread tasks stay pending until Update(), so exactly one of each round may run
+		constexpr int NUM_THREADS = 4;
+		for (const TaskDedupPolicy policy : { DEDUP_KEEP_FIRST, DEDUP_REPLACE }) {
+			for (int round = 0; round < 200; round++) {
+				std::atomic<int> runs{ 0 };
+				std::atomic<int> ready{ 0 };
+				std::vector<std::thread> threads;
+				for (int i = 0; i < NUM_THREADS; i++) {
+					threads.emplace_back([this, &runs, &ready, policy]() {
+						auto task = std::make_shared<Task>(
+							(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void { ++runs; },
+							TaskThreadTarget{ MAIN_THREAD },
+							TaskDedupKey{ 42, policy }
+						);
+						++ready;
+						while (ready < NUM_THREADS) {
+							std::this_thread::yield();
+						}
+						EXPECT_TRUE(queue.AddTask(task));
+					});
+				}
+				for (auto& thread : threads) {
+					thread.join();
+				}
+
+				queue.Update();
+				ASSERT_EQ(runs, 1) << "Policy " << policy << ", round " << round;
+			}
+		}
+		EXPECT_EQ(queue.GetPerformanceStats().total, 0);
+	}
+	TEST_F(TasksQueueTest, DebouncesDuplicates) {
+		const TaskDedupKey key{ 42, DEDUP_DEBOUNCE };
+		std::atomic<int> runs{ 0 };
+		const auto added = std::chrono::steady_clock::now();
+		std::atomic<std::chrono::steady_clock::time_point::rep> executedAt{ 0 };
+
+		EXPECT_EQ(queue.TryAddTask(std::make_shared<Task>(
+			(TaskExecutable)[&runs, &executedAt](TasksQueue* queue, const TaskPtr& task) -> void {
+				executedAt = std::chrono::steady_clock::now().time_since_epoch().count();
+				++runs;
+			},
+			TaskDelay{ 100 },
+			key
+		)), ADD_OK);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		// Pushes the pending task back to 100 ms from now, instead of running twice
+		ASSERT_EQ(queue.TryAddTask(std::make_shared<Task>(
+			(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void { runs += 10; },
+			TaskDelay{ 100 },
+			key
+		)), ADD_MERGED);
+
+		auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+		while ((runs == 0) && (std::chrono::steady_clock::now() < until)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_EQ(runs, 1);
+		EXPECT_GE(std::chrono::steady_clock::duration(executedAt.load()), added.time_since_epoch() + std::chrono::milliseconds(120));
+		CheckStats(1, 1, 1, 1, 0, -1, "Should have suspended and run only the first task");
+	}
+	TEST_F(TasksQueueTest, ParksUntilUnparked) {
+		std::vector<uint32_t> results;
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&results](TasksQueue* queue, const TaskPtr& task) -> void {
+				results.push_back(task->GetParkResult());
+				if (results.size() == 1) {
+					task->Park();
+				}
+			},
+			TaskThreadTarget{ MAIN_THREAD }
+		);
+		EXPECT_FALSE(queue.Unpark(task));
+
+		queue.AddTask(task);
+		queue.Update();
+		EXPECT_EQ(task->GetStatus(), TaskStatus::TASK_SUSPENDED);
+		CheckStats(1, 0, 1, 0, 1, 1, "Should have parked the task");
+
+		queue.Update();
+		EXPECT_EQ(results.size(), 1u);
+		EXPECT_TRUE(queue.Unpark(task, 7));
+		EXPECT_FALSE(queue.Unpark(task, 8));
+		EXPECT_EQ(task->GetStatus(), TaskStatus::TASK_IN_QUEUE_MAIN_THREAD);
+
+		queue.Update();
+		EXPECT_EQ(results, std::vector<uint32_t>({ 0, 7 }));
+		CheckStats(1, 1, 1, 1, 0, 0, "Should have run the unparked task");
+	}
+	TEST_F(TasksQueueTest, UnparksBeforeCallbackReturns) {
+		std::vector<int> runs;
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+				runs.push_back(1);
+				task->Reschedule((TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+					runs.push_back(2);
+				});
+				task->Park();
+				EXPECT_TRUE(queue->Unpark(task));		// Whatever it waits for has come already
+			},
+			TaskThreadTarget{ MAIN_THREAD }
+		);
+
+		queue.AddTask(task);
+		queue.Update();
+		EXPECT_EQ(task->GetStatus(), TaskStatus::TASK_IN_QUEUE_MAIN_THREAD);
+		queue.Update();
+		EXPECT_EQ(runs, std::vector<int>({ 1, 2 }));
+		CheckStats(1, 1, 1, 1, 0, 0, "Should have run the task with the reschedule options");
+	}
+	TEST_F(TasksQueueTest, CancelsParkedTask) {
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {
+				task->Park();
+			},
+			TaskThreadTarget{ MAIN_THREAD }
+		);
+
+		queue.AddTask(task);
+		queue.Update();
+		ASSERT_EQ(task->GetStatus(), TaskStatus::TASK_SUSPENDED);
+		EXPECT_TRUE(queue.Cancel(task));
+		EXPECT_FALSE(queue.Unpark(task));
+		auto stats = queue.GetPerformanceStats();
+		EXPECT_EQ(stats.cancelled, 1);
+		EXPECT_EQ(stats.waiting, 0);
+		EXPECT_EQ(stats.total, 0);
+	}
+	TEST_F(TasksQueueTest, PostsCallables) {
+		constexpr int NUM_POSTS = 1000;
+		std::atomic<int> executed{ 0 };
+		std::atomic<bool> isQueueSet{ true };
+
+		for (int i = 0; i < NUM_POSTS; i++) {
+			ASSERT_TRUE(queue.Post([this, &executed, &isQueueSet](TasksQueue* queue) -> void {
+				if (queue != &this->queue) {
+					isQueueSet = false;
+				}
+				++executed;
+			}, TaskBlocking{ (i % 2) == 0 }));
+		}
+
+		for (int i = 0; (i < 1000) && (queue.GetPerformanceStats().total > 0); i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_EQ(executed, NUM_POSTS);
+		EXPECT_TRUE(isQueueSet);
+		CheckStats(NUM_POSTS, NUM_POSTS, 0, 0, 0, 0);
+
+		EXPECT_FALSE(queue.Post(nullptr));
+		queue.Cleanup();
+		EXPECT_FALSE(queue.Post([](TasksQueue* queue) -> void {}));
+	}
+	TEST_F(TasksQueueTest, PostsThroughTaskWhenOptionsNeedOne) {
+		std::atomic<bool> isDelayedExecuted{ false };
+		bool isMainThreadExecuted = false;
+
+		ASSERT_TRUE(queue.Post([&isDelayedExecuted](TasksQueue* queue) -> void {
+			isDelayedExecuted = true;
+		}, TaskDelay{ 10 }));
+		ASSERT_TRUE(queue.Post([&isMainThreadExecuted](TasksQueue* queue) -> void {
+			isMainThreadExecuted = true;
+		}, TaskThreadTarget{ MAIN_THREAD }));
+
+		queue.Update();
+		EXPECT_TRUE(isMainThreadExecuted);
+		for (int i = 0; (i < 1000) && !isDelayedExecuted; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_TRUE(isDelayedExecuted);
+		CheckStats(2, -1, 1, -1, -1, -1);
+	}
+	TEST_F(TasksQueueTest, PostedCallablesKeepPriorityOrder) {
+		// A single worker, held busy until everything is posted
+		queue.Cleanup();
+		queue.Initialize({ 1,0,1 });
+		std::atomic<bool> release{ false };
+		std::mutex orderMutex;
+		std::vector<int> order;
+
+		ASSERT_TRUE(queue.Post([&release](TasksQueue* queue) -> void {
+			while (!release) {
+				std::this_thread::yield();
+			}
+		}));
+		for (int i = 0; i < 3; i++) {
+			queue.Post([&orderMutex, &order, i](TasksQueue* queue) -> void {
+				std::lock_guard<std::mutex> lock(orderMutex);
+				order.push_back(i);
+			}, TaskPriority{ static_cast<TaskPriority>(i == 1 ? 5 : 0) });
+		}
+		queue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&orderMutex, &order](TasksQueue* queue, const TaskPtr& task) -> void {
+				std::lock_guard<std::mutex> lock(orderMutex);
+				order.push_back(3);
+			}
+		));
+		release = true;
+
+		for (int i = 0; (i < 1000) && (queue.GetPerformanceStats().total > 0); i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		std::lock_guard<std::mutex> lock(orderMutex);
+		EXPECT_EQ(order, (std::vector<int>{ 1, 0, 2, 3 }));
+	}
+	TEST_F(TasksQueueDeadlineTest, RunsEarliestDeadlineFirst) {
+		InitDeadlineQueue(DEADLINE_MISS_RUN);
+		std::uniform_int_distribution<int> dist(100, 10000);
+		auto now = scheduleClock::now();
+		std::vector<std::pair<TaskDeadline, int>> deadlines;
+
+		AddOrderedTask(-1, TaskDeadline::max());
+		for (int i = 0; i < 20; i++) {
+			deadlines.emplace_back(now + std::chrono::milliseconds(dist(randEng)), i);
+			AddOrderedTask(i, deadlines.back().first);
+		}
+		AddOrderedTask(-2, TaskDeadline::max());
+		release = true;
+
+		ASSERT_TRUE(WaitForCompleted(23));
+		std::stable_sort(deadlines.begin(), deadlines.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+		std::vector<int> expected;
+		for (const auto& deadline : deadlines) {
+			expected.push_back(deadline.second);
+		}
+		expected.push_back(-1);			// No deadline goes last, in order of submission
+		expected.push_back(-2);
+		EXPECT_EQ(order, expected);
+		EXPECT_EQ(deadlineQueue.GetPerformanceStats().deadlineMissed, 0);
+	}
+	TEST_F(TasksQueueDeadlineTest, RunsLateTasks) {
+		InitDeadlineQueue(DEADLINE_MISS_RUN);
+		auto now = scheduleClock::now();
+
+		AddOrderedTask(1, now + std::chrono::seconds(10));
+		AddOrderedTask(2, now - std::chrono::milliseconds(1));
+		release = true;
+
+		ASSERT_TRUE(WaitForCompleted(3));
+		EXPECT_EQ(order, std::vector<int>({ 2, 1 }));
+		EXPECT_EQ(deadlineQueue.GetPerformanceStats().deadlineMissed, 1);
+	}
+	TEST_F(TasksQueueDeadlineTest, DeprioritizesLateTasks) {
+		InitDeadlineQueue(DEADLINE_MISS_DEPRIORITIZE);
+		auto now = scheduleClock::now();
+
+		AddOrderedTask(1, now - std::chrono::milliseconds(2));
+		AddOrderedTask(2, now - std::chrono::milliseconds(1));
+		AddOrderedTask(3, now + std::chrono::seconds(10));
+		AddOrderedTask(4, TaskDeadline::max());
+		release = true;
+
+		ASSERT_TRUE(WaitForCompleted(5));
+		EXPECT_EQ(order, std::vector<int>({ 3, 4, 1, 2 }));
+		EXPECT_EQ(deadlineQueue.GetPerformanceStats().deadlineMissed, 2);
+	}
+	TEST_F(TasksQueueDeadlineTest, DropsLateTasks) {
+		InitDeadlineQueue(DEADLINE_MISS_DROP);
+		auto now = scheduleClock::now();
+		auto captured = std::make_shared<int>(0);
+
+		auto late = std::make_shared<Task>(
+			(TaskExecutable)[captured](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskDeadline{ now - std::chrono::milliseconds(1) }
+		);
+		deadlineQueue.AddTask(late);
+		AddOrderedTask(1, now + std::chrono::seconds(10));
+		release = true;
+
+		ASSERT_TRUE(WaitForCompleted(2));
+		EXPECT_EQ(order, std::vector<int>({ 1 }));
+		EXPECT_EQ(late->GetStatus(), TaskStatus::TASK_CANCELLED);
+		EXPECT_EQ(captured.use_count(), 1);
+
+		auto stats = deadlineQueue.GetPerformanceStats();
+		EXPECT_EQ(stats.deadlineDropped, 1);
+		EXPECT_EQ(stats.deadlineMissed, 0);
+		EXPECT_EQ(stats.total, 0);
+	}
+	TEST_F(TasksQueueDeadlineTest, SharesWorkersByPriorityWeight) {
+		TasksQueue::Configuration config{ 1,0,1 };
+		config.policy = POLICY_WEIGHTED_PRIORITY;
+		config.priorityAgingTime = std::chrono::seconds(10);
+		InitGatedQueue(config);
+
+		for (int i = 0; i < 40; i++) {
+			AddPriorityTask(i, 0);
+			AddPriorityTask(100 + i, 2);
+		}
+		release = true;
+
+		ASSERT_TRUE(WaitForCompleted(81));
+		int first = (int)std::count_if(order.begin(), order.begin() + 20, [](int id) { return id >= 100; });
+		EXPECT_GE(first, 14);			// Weights are 3:1
+		EXPECT_LE(first, 16);
+
+		std::vector<int> low, high;			// Each level keeps the order of submission
+		std::copy_if(order.begin(), order.end(), std::back_inserter(low), [](int id) { return id < 100; });
+		std::copy_if(order.begin(), order.end(), std::back_inserter(high), [](int id) { return id >= 100; });
+		EXPECT_TRUE(std::is_sorted(low.begin(), low.end()));
+		EXPECT_TRUE(std::is_sorted(high.begin(), high.end()));
+	}
+	TEST_F(TasksQueueDeadlineTest, AgesStarvedTasks) {
+		TasksQueue::Configuration config{ 1,0,1 };
+		config.policy = POLICY_WEIGHTED_PRIORITY;
+		config.priorityAgingTime = std::chrono::milliseconds(20);
+		InitGatedQueue(config);
+
+		// The first low task takes the level's turn, the second one would have to wait for a million high ones
+		AddPriorityTask(1, 0);
+		AddPriorityTask(2, 0);
+		for (int i = 0; i < 50; i++) {
+			AddPriorityTask(100 + i, 1000000, std::chrono::milliseconds(2));
+		}
+		release = true;
+
+		ASSERT_TRUE(WaitForCompleted(53));
+		auto starved = std::find(order.begin(), order.end(), 2);
+		ASSERT_NE(starved, order.end());
+		EXPECT_LT(starved - order.begin(), 25);
+	}
+	TEST_F(TasksQueueTest, WeightedPriorityKeepsWorkersBusy) {
+		TasksQueue::Configuration config{ 3,0,1 };
+		config.policy = POLICY_WEIGHTED_PRIORITY;
+		TasksQueue weightedQueue(config);
+		std::atomic<bool> release{ false };
+		std::atomic<bool> lowDone{ false };
+
+		weightedQueue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&release](TasksQueue* queue, const TaskPtr& task) -> void {
+				while (!release) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			},
+			TaskPriority{ 5 }
+		));
+		weightedQueue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&lowDone](TasksQueue* queue, const TaskPtr& task) -> void {
+				lowDone = true;
+			}
+		));
+
+		auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+		while (!lowDone && (std::chrono::steady_clock::now() < until)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_TRUE(lowDone) << "Lower priority task should run while the higher priority one is executing";
+		release = true;
+		weightedQueue.Cleanup();
+	}
+	TEST_F(TasksQueueTest, ResumesWithoutUpdate) {
+		// Nothing calls Update(), the scheduling thread has to wake up for the timer by itself
+		TasksQueue timerQueue{ { 1,0,1 } };
+		std::atomic<bool> executed{ false };
+
+		timerQueue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&executed](TasksQueue* queue, const TaskPtr& task) -> void {
+				executed = true;
+			},
+			TaskDelay{ 5 }
+		));
+
+		auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+		while (!executed && (std::chrono::steady_clock::now() < until)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_TRUE(executed);
+	}
+	TEST_F(TasksQueueTest, WorkersResumeWithoutSchedulingThread) {
+		TasksQueue timerQueue{ { 2,0,0 } };
+		ASSERT_EQ(timerQueue.numSchedulingThreads(), 0);
+		std::atomic<int> executed{ 0 };
+		std::atomic<bool> release{ false };
+
+		auto later = std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskDelay{ 10000 }
+		);
+		timerQueue.AddTask(later);
+
+		// The earlier timer has to wake up the worker that waits for the later one, while the other worker is busy
+		timerQueue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&release](TasksQueue* queue, const TaskPtr& task) -> void {
+				while (!release) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+		));
+		const auto added = std::chrono::steady_clock::now();
+		std::atomic<std::chrono::steady_clock::time_point::rep> executedAt{ 0 };
+		for (int i = 0; i < 3; i++) {
+			timerQueue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&executed, &executedAt](TasksQueue* queue, const TaskPtr& task) -> void {
+					executedAt = std::chrono::steady_clock::now().time_since_epoch().count();
+					++executed;
+				},
+				TaskDelay{ 5 + i * 5 }
+			));
+		}
+
+		auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+		while ((executed < 3) && (std::chrono::steady_clock::now() < until)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_EQ(executed, 3);
+		EXPECT_GE(std::chrono::steady_clock::duration(executedAt.load()), added.time_since_epoch() + std::chrono::milliseconds(15));
+
+		EXPECT_EQ(later->GetStatus(), TASK_SUSPENDED);
+		EXPECT_TRUE(timerQueue.Cancel(later));
+		release = true;
+		timerQueue.Cleanup();
+	}
+	TEST_F(TasksQueueTest, RunsTasksWithSpinningWorkers) {
+		TasksQueue::Configuration config{ 2,1,0 };
+		config.blockingIdle = TasksQueue::IdleStrategy(std::chrono::microseconds(200), std::chrono::microseconds(200));
+		config.nonBlockingIdle = TasksQueue::IdleStrategy(std::chrono::microseconds(200), std::chrono::microseconds(0), false);
+		TasksQueue spinningQueue(config);
+		std::atomic<int> executed{ 0 };
+
+		// Close enough for the workers to catch them spinning, and a few far enough apart to park them
+		for (int i = 0; i < 200; i++) {
+			spinningQueue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&executed](TasksQueue* queue, const TaskPtr& task) -> void {
+					++executed;
+				},
+				TaskBlocking{ (i % 2) == 0 },
+				TaskDelay{ (i % 50) == 49 ? 2 : 0 }
+			));
+			std::this_thread::sleep_for(std::chrono::microseconds(((i % 20) == 19) ? 2000 : 50));
+		}
+
+		auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+		while ((executed < 200) && (std::chrono::steady_clock::now() < until)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_EQ(executed, 200);
+
+		const auto shutdownStart = std::chrono::steady_clock::now();
+		spinningQueue.Cleanup();
+		EXPECT_LT(std::chrono::steady_clock::now() - shutdownStart, std::chrono::milliseconds(100));
+	}
 }
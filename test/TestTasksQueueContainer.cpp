@@ -3,6 +3,8 @@
 
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <vector>
 
 #include "taskslib/Types.h"
 #include "TestTools.h"
@@ -46,18 +48,14 @@ namespace TasksLib {
 		ASSERT_EQ(queuesContainer.GetQueuesCount(), num);
 
 		unsigned count = 0;
-		auto task = std::make_shared<Task>(
-            (TaskExecutable)[&count](TasksQueue* queue, TaskPtr task) -> void {
-				count++;
-			},
-			TaskThreadTarget{ MAIN_THREAD }
-		);
-
-		// Adding the same task to multiple queues is NOT OK in real situations - task status is going to be inconsistent and rescheduling would 
-		// result in unpredictable behavior, but it should work here
 		for (auto& name : queueNames) {
 			TasksQueue* queue = queuesContainer.GetQueue(name);
-			queue->AddTask(task);
+			queue->AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&count](TasksQueue* queue, TaskPtr task) -> void {
+					count++;
+				},
+				TaskThreadTarget{ MAIN_THREAD }
+			));
 		}
 
 		std::this_thread::sleep_for(std::chrono::milliseconds(30));
@@ -65,4 +63,57 @@ namespace TasksLib {
 		queuesContainer.Update();
 		EXPECT_EQ(count, num);
 	}
+	TEST_F(TasksQueuesContainerTest, ReturnsHandles) {
+		std::string queueName = GenerateRandomString(5, 8, randEng);
+		std::string otherName = queueName + "_other";
+
+		EXPECT_EQ(queuesContainer.GetQueueHandle(queueName), INVALID_QUEUE_HANDLE);
+		TasksQueueHandle handle = queuesContainer.CreateQueue(queueName, { 1,0,0 });
+		TasksQueueHandle otherHandle = queuesContainer.CreateQueue(otherName, { 2,0,0 });
+		ASSERT_NE(handle, INVALID_QUEUE_HANDLE);
+		ASSERT_NE(otherHandle, handle);
+
+		EXPECT_EQ(queuesContainer.GetQueueHandle(queueName), handle);
+		EXPECT_EQ(queuesContainer.GetQueue(handle), queuesContainer.GetQueue(queueName));
+		EXPECT_EQ(queuesContainer.GetQueue(otherHandle)->numBlockingThreads(), 2);
+		EXPECT_EQ(queuesContainer.GetQueue(INVALID_QUEUE_HANDLE), nullptr);
+
+		// Creating an existing name returns the same queue and ignores the configuration
+		EXPECT_EQ(queuesContainer.CreateQueue(queueName, { 3,0,0 }), handle);
+		EXPECT_EQ(queuesContainer.GetQueue(handle)->numBlockingThreads(), 1);
+		EXPECT_EQ(queuesContainer.GetQueuesCount(), 2);
+	}
+	TEST_F(TasksQueuesContainerTest, LooksUpWhileCreating) {
+		const unsigned numQueues = 20;
+		TasksQueueHandle first = queuesContainer.CreateQueue("first", { 1,0,0 });
+		TasksQueue* firstQueue = queuesContainer.GetQueue(first);
+		std::atomic<bool> done{ false };
+		std::atomic<unsigned> mismatches{ 0 };
+
+		std::vector<std::thread> readers;
+		for (int i = 0; i < 4; i++) {
+			readers.emplace_back([&]() {
+				while (!done) {
+					if ((queuesContainer.GetQueue(first) != firstQueue) || (queuesContainer.GetQueue("first") != firstQueue)) {
+						++mismatches;
+					}
+					size_t count = queuesContainer.GetQueuesCount();
+					if (queuesContainer.GetQueue(static_cast<TasksQueueHandle>(count - 1)) == nullptr) {
+						++mismatches;
+					}
+				}
+			});
+		}
+
+		for (unsigned i = 0; i < numQueues; i++) {
+			queuesContainer.CreateQueue("queue" + std::to_string(i), { 1,0,0 });
+		}
+		done = true;
+		for (auto& reader : readers) {
+			reader.join();
+		}
+
+		EXPECT_EQ(mismatches, 0);
+		EXPECT_EQ(queuesContainer.GetQueuesCount(), numQueues + 1);
+	}
 }
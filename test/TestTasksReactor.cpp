@@ -0,0 +1,241 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "taskslib/Types.h"
+#include "TestTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TasksReactor.h"
+
+namespace TasksLib {
+
+	using namespace ::testing;
+
+	class TasksReactorTest : public ::testing::Test {
+	public:
+		std::vector<int> fds;
+
+		~TasksReactorTest() override {
+			for (const int fd : fds) {
+				close(fd);
+			}
+		}
+
+		/* A non-blocking pipe, returns { read end, write end } */
+		std::pair<int, int> MakePipe() {
+			int ends[2];
+			EXPECT_EQ(pipe2(ends, O_NONBLOCK), 0);
+			fds.push_back(ends[0]);
+			fds.push_back(ends[1]);
+			return { ends[0], ends[1] };
+		}
+
+		/* Reads a byte from the descriptor, parks on the reactor while there is none */
+		static TaskExecutable Reader(TasksReactor& reactor, const int fd, std::atomic<int>& received, std::atomic<uint32_t>& wokenWith, const TaskDelay timeout = TaskDelay{ 0 }) {
+			return [&reactor, fd, &received, &wokenWith, timeout](TasksQueue* queue, const TaskPtr& task) -> void {
+				if (task->GetParkResult() != 0) {
+					wokenWith = task->GetParkResult();
+				}
+				if (task->GetParkResult() & (IO_TIMEOUT | IO_CLOSED)) {
+					return;
+				}
+
+				char byte;
+				if (read(fd, &byte, 1) == 1) {
+					++received;
+				} else {
+					EXPECT_TRUE(reactor.Watch(task, fd, IO_READ, timeout));
+				}
+			};
+		}
+	};
+
+	TEST_F(TasksReactorTest, ResumesTaskWhenReadable) {
+		TasksQueue queue{ { 1,0,1 } };
+		TasksReactor reactor(&queue);
+		auto [readEnd, writeEnd] = MakePipe();
+		std::atomic<int> received{ 0 };
+		std::atomic<uint32_t> wokenWith{ 0 };
+
+		auto task = std::make_shared<Task>(Reader(reactor, readEnd, received, wokenWith));
+		ASSERT_TRUE(queue.AddTask(task));
+		ASSERT_TRUE(WaitFor([&]() { return task->GetStatus() == TASK_SUSPENDED; }));
+		EXPECT_EQ(reactor.GetWatching(), 1u);
+		EXPECT_EQ(received, 0);
+
+		ASSERT_EQ(write(writeEnd, "x", 1), 1);
+		ASSERT_TRUE(WaitFor([&]() { return received == 1; }));
+		EXPECT_EQ(wokenWith, static_cast<uint32_t>(IO_READ));
+		ASSERT_TRUE(WaitFor([&]() { return task->GetStatus() == TASK_FINISHED; }));
+		EXPECT_EQ(reactor.GetWatching(), 0u);
+	}
+	TEST_F(TasksReactorTest, WaitsWithoutHoldingWorkers) {
+		// A single worker, all the readers wait at the same time and it still runs the other tasks
+		TasksQueue queue{ { 1,0,1 } };
+		TasksReactor reactor(&queue);
+		std::vector<std::pair<int, int>> pipes;
+		std::atomic<int> received{ 0 };
+		std::atomic<uint32_t> wokenWith{ 0 };
+
+		constexpr int NUM_READERS = 50;
+		for (int i = 0; i < NUM_READERS; i++) {
+			pipes.push_back(MakePipe());
+			ASSERT_TRUE(queue.AddTask(std::make_shared<Task>(Reader(reactor, pipes.back().first, received, wokenWith))));
+		}
+		ASSERT_TRUE(WaitFor([&]() { return reactor.GetWatching() == NUM_READERS; }));
+
+		std::atomic<bool> executed{ false };
+		queue.AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&executed](TasksQueue* queue, const TaskPtr& task) -> void {
+				executed = true;
+			}
+		));
+		ASSERT_TRUE(WaitFor([&]() { return executed.load(); }));
+		EXPECT_EQ(queue.GetPerformanceStats().waiting, NUM_READERS);
+
+		for (const auto& [readEnd, writeEnd] : pipes) {
+			ASSERT_EQ(write(writeEnd, "x", 1), 1);
+		}
+		ASSERT_TRUE(WaitFor([&]() { return received == NUM_READERS; }));
+		ASSERT_TRUE(WaitFor([&]() { return queue.GetPerformanceStats().total == 0; }));
+		EXPECT_EQ(queue.GetPerformanceStats().waiting, 0);
+	}
+	TEST_F(TasksReactorTest, TimesOutWatch) {
+		TasksQueue queue{ { 1,0,1 } };
+		TasksReactor reactor(&queue);
+		auto [readEnd, writeEnd] = MakePipe();
+		std::atomic<int> received{ 0 };
+		std::atomic<uint32_t> wokenWith{ 0 };
+
+		const auto added = std::chrono::steady_clock::now();
+		auto task = std::make_shared<Task>(Reader(reactor, readEnd, received, wokenWith, TaskDelay{ 20 }));
+		ASSERT_TRUE(queue.AddTask(task));
+		ASSERT_TRUE(WaitFor([&]() { return task->GetStatus() == TASK_FINISHED; }));
+		EXPECT_GE(std::chrono::steady_clock::now() - added, std::chrono::milliseconds(20));
+		EXPECT_EQ(wokenWith, static_cast<uint32_t>(IO_TIMEOUT));
+		EXPECT_EQ(received, 0);
+
+		// The descriptor can be watched again
+		wokenWith = 0;
+		auto next = std::make_shared<Task>(Reader(reactor, readEnd, received, wokenWith));
+		ASSERT_TRUE(queue.AddTask(next));
+		ASSERT_TRUE(WaitFor([&]() { return reactor.GetWatching() == 1; }));
+		ASSERT_EQ(write(writeEnd, "x", 1), 1);
+		ASSERT_TRUE(WaitFor([&]() { return received == 1; }));
+		EXPECT_EQ(wokenWith, static_cast<uint32_t>(IO_READ));
+	}
+	TEST_F(TasksReactorTest, ReportsWritableAndHangUp) {
+		TasksQueue queue{ { 1,0,1 } };
+		TasksReactor reactor(&queue);
+		int pair[2];
+		ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair), 0);
+		fds.push_back(pair[0]);
+		std::atomic<uint32_t> wokenWith{ 0 };
+
+		auto waitFor = [&reactor, &wokenWith](const int fd, const uint32_t events) -> TaskPtr {
+			return std::make_shared<Task>(
+				(TaskExecutable)[&reactor, &wokenWith, fd, events](TasksQueue* queue, const TaskPtr& task) -> void {
+					if (task->GetParkResult() == 0) {
+						EXPECT_TRUE(reactor.Watch(task, fd, events));
+					} else {
+						wokenWith = task->GetParkResult();
+					}
+				}
+			);
+		};
+
+		ASSERT_TRUE(queue.AddTask(waitFor(pair[0], IO_WRITE)));
+		ASSERT_TRUE(WaitFor([&]() { return wokenWith != 0; }));
+		EXPECT_EQ(wokenWith, static_cast<uint32_t>(IO_WRITE));
+
+		wokenWith = 0;
+		ASSERT_TRUE(queue.AddTask(waitFor(pair[0], IO_READ)));
+		ASSERT_TRUE(WaitFor([&]() { return reactor.GetWatching() == 1; }));
+		close(pair[1]);
+		ASSERT_TRUE(WaitFor([&]() { return wokenWith != 0; }));
+		EXPECT_TRUE(wokenWith & IO_HANGUP);
+	}
+	TEST_F(TasksReactorTest, RefusesSecondWatchOfDescriptor) {
+		TasksQueue queue{ { 1,0,1 } };
+		TasksReactor reactor(&queue);
+		auto [readEnd, writeEnd] = MakePipe();
+
+		auto first = std::make_shared<Task>();
+		auto second = std::make_shared<Task>();
+		EXPECT_TRUE(reactor.Watch(first, readEnd, IO_READ));
+		EXPECT_FALSE(reactor.Watch(second, readEnd, IO_READ));
+		EXPECT_FALSE(reactor.Watch(second, writeEnd, 0));
+		EXPECT_FALSE(reactor.Watch(second, -1, IO_READ));
+		EXPECT_EQ(reactor.GetWatching(), 1u);
+	}
+	TEST_F(TasksReactorTest, TakesOverWatchOfCancelledTask) {
+		TasksQueue queue{ { 1,0,1 } };
+		TasksReactor reactor(&queue);
+		auto [readEnd, writeEnd] = MakePipe();
+		std::atomic<int> received{ 0 };
+		std::atomic<uint32_t> wokenWith{ 0 };
+
+		auto cancelled = std::make_shared<Task>(Reader(reactor, readEnd, received, wokenWith));
+		ASSERT_TRUE(queue.AddTask(cancelled));
+		ASSERT_TRUE(WaitFor([&]() { return cancelled->GetStatus() == TASK_SUSPENDED; }));
+		EXPECT_TRUE(queue.Cancel(cancelled));
+		EXPECT_EQ(reactor.GetWatching(), 1u);			// The reactor doesn't know yet
+
+		// Watching the descriptor again drops the cancelled task's watch
+		auto next = std::make_shared<Task>(Reader(reactor, readEnd, received, wokenWith));
+		ASSERT_TRUE(queue.AddTask(next));
+		ASSERT_TRUE(WaitFor([&]() { return next->GetStatus() == TASK_SUSPENDED; }));
+		EXPECT_EQ(reactor.GetWatching(), 1u);
+		EXPECT_EQ(cancelled.use_count(), 1);
+
+		ASSERT_EQ(write(writeEnd, "x", 1), 1);
+		ASSERT_TRUE(WaitFor([&]() { return next->GetStatus() == TASK_FINISHED; }));
+		EXPECT_EQ(received, 1);
+		EXPECT_EQ(cancelled->GetStatus(), TASK_CANCELLED);
+	}
+	TEST_F(TasksReactorTest, UnwatchesCancelledTask) {
+		TasksQueue queue{ { 1,0,1 } };
+		TasksReactor reactor(&queue);
+		auto [readEnd, writeEnd] = MakePipe();
+		std::atomic<int> received{ 0 };
+		std::atomic<uint32_t> wokenWith{ 0 };
+
+		auto task = std::make_shared<Task>(Reader(reactor, readEnd, received, wokenWith));
+		ASSERT_TRUE(queue.AddTask(task));
+		ASSERT_TRUE(WaitFor([&]() { return task->GetStatus() == TASK_SUSPENDED; }));
+		EXPECT_TRUE(queue.Cancel(task));
+		EXPECT_TRUE(reactor.Unwatch(readEnd));
+		EXPECT_FALSE(reactor.Unwatch(readEnd));
+		EXPECT_EQ(reactor.GetWatching(), 0u);
+		EXPECT_EQ(task.use_count(), 1);
+
+		// Disarmed, the data that comes later doesn't touch the task
+		ASSERT_EQ(write(writeEnd, "x", 1), 1);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		EXPECT_EQ(wokenWith, 0u);
+		EXPECT_EQ(task->GetStatus(), TASK_CANCELLED);
+	}
+	TEST_F(TasksReactorTest, WakesWaitingTasksWhenDestroyed) {
+		TasksQueue queue{ { 1,0,1 } };
+		auto [readEnd, writeEnd] = MakePipe();
+		std::atomic<int> received{ 0 };
+		std::atomic<uint32_t> wokenWith{ 0 };
+		TaskPtr task;
+		{
+			TasksReactor reactor(&queue);
+			task = std::make_shared<Task>(Reader(reactor, readEnd, received, wokenWith));
+			ASSERT_TRUE(queue.AddTask(task));
+			ASSERT_TRUE(WaitFor([&]() { return reactor.GetWatching() == 1; }));
+		}
+		ASSERT_TRUE(WaitFor([&]() { return task->GetStatus() == TASK_FINISHED; }));
+		EXPECT_EQ(wokenWith, static_cast<uint32_t>(IO_CLOSED));
+	}
+
+}
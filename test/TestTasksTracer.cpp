@@ -0,0 +1,159 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <string>
+
+#include "taskslib/Types.h"
+#include "TestTools.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+#include "taskslib/TasksTracer.h"
+
+namespace TasksLib {
+
+	using namespace ::testing;
+
+	class TasksTracerTest : public ::testing::Test {
+	public:
+		~TasksTracerTest() override {
+			TasksTracer::Disable();
+		}
+
+		static std::string WriteTrace() {
+			std::ostringstream out;
+			TasksTracer::WriteChromeTrace(out);
+			return out.str();
+		}
+		static size_t CountEvents(const std::string& trace, const std::string& name, const std::string& phase) {
+			const std::string event = "{\"name\":\"" + name + "\",\"cat\":\"" + ((name == "Update") ? "queue" : "task") + "\",\"ph\":\"" + phase + "\"";
+			size_t count = 0;
+			for (size_t pos = trace.find(event); pos != std::string::npos; pos = trace.find(event, pos + 1)) {
+				++count;
+			}
+			return count;
+		}
+	};
+
+	TEST_F(TasksTracerTest, RecordsTaskLifecycle) {
+		TasksTracer::Enable();
+		{
+			TasksQueue queue{ { 1,0,1 } };
+			std::atomic<int> runs{ 0 };
+
+			queue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+					if (++runs < 3) {
+						task->Reschedule(TaskDelay{ 1 });
+					}
+				},
+				TaskDelay{ 1 }
+			));
+			for (int i = 0; (i < 1000) && (queue.GetPerformanceStats().total > 0); ++i) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				queue.Update();
+			}
+			EXPECT_EQ(runs, 3);
+		}
+
+		const std::string trace = WriteTrace();
+		EXPECT_EQ(CountEvents(trace, "Add", "i"), 1u);
+		EXPECT_EQ(CountEvents(trace, "Suspend", "i"), 3u);
+		EXPECT_EQ(CountEvents(trace, "Resume", "i"), 3u);
+		EXPECT_EQ(CountEvents(trace, "Execute", "X"), 3u);
+		EXPECT_EQ(CountEvents(trace, "Reschedule", "i"), 2u);
+		EXPECT_NE(trace.find("\"overwrittenEvents\":0}"), std::string::npos);
+	}
+	TEST_F(TasksTracerTest, RecordsUpdateSpans) {
+		TasksTracer::Enable();
+		TasksQueue queue{ { 1,0,1 } };
+
+		auto task = std::make_shared<Task>(
+			(TaskExecutable)[](TasksQueue* queue, const TaskPtr& task) -> void {},
+			TaskThreadTarget{ MAIN_THREAD }
+		);
+		queue.AddTask(task);
+		queue.Update();
+		queue.Update();
+
+		const std::string trace = WriteTrace();
+		EXPECT_GE(CountEvents(trace, "Update", "X"), 2u);
+		EXPECT_EQ(CountEvents(trace, "Execute", "X"), 1u);
+
+		std::ostringstream id;
+		id << "\"args\":{\"task\":\"0x" << std::hex << reinterpret_cast<uintptr_t>(task.get()) << "\"}";
+		EXPECT_NE(trace.find(id.str()), std::string::npos);
+	}
+	TEST_F(TasksTracerTest, KeepsLatestEventsPerThread) {
+		TasksTracer::Enable(16);
+		for (uintptr_t i = 1; i <= 20; ++i) {
+			TasksTracer::Record(TRACE_ADD, reinterpret_cast<const void*>(i));
+		}
+		std::thread([]() {
+			TasksTracer::Record(TRACE_CANCEL, reinterpret_cast<const void*>(uintptr_t{ 0x100 }));
+		}).join();
+
+		const std::string trace = WriteTrace();
+		EXPECT_EQ(CountEvents(trace, "Add", "i"), 16u);
+		EXPECT_EQ(trace.find("\"task\":\"0x4\""), std::string::npos);
+		EXPECT_NE(trace.find("\"task\":\"0x5\""), std::string::npos);
+		EXPECT_NE(trace.find("\"task\":\"0x14\""), std::string::npos);
+		EXPECT_EQ(CountEvents(trace, "Cancel", "i"), 1u);		// The thread is gone, its events are not
+		EXPECT_NE(trace.find("\"overwrittenEvents\":4}"), std::string::npos);
+	}
+	TEST_F(TasksTracerTest, ReusesBuffersOfExitedThreads) {
+		TasksTracer::Enable(16);
+		const uintptr_t numThreads = TasksTracer::MAX_BUFFERS + 16;
+		for (uintptr_t i = 1; i <= numThreads; ++i) {
+			std::thread([i]() {
+				TasksTracer::Record(TRACE_CANCEL, reinterpret_cast<const void*>(i));
+			}).join();
+		}
+
+		const std::string trace = WriteTrace();
+		EXPECT_LE(CountEvents(trace, "Cancel", "i"), TasksTracer::MAX_BUFFERS);
+		EXPECT_EQ(trace.find("\"task\":\"0x1\""), std::string::npos);		// The first threads' buffers went to the last ones
+		std::ostringstream last;
+		last << "\"task\":\"0x" << std::hex << numThreads << "\"";
+		EXPECT_NE(trace.find(last.str()), std::string::npos);
+	}
+	TEST_F(TasksTracerTest, StartsNewSessionWhenEnabled) {
+		TasksTracer::Enable();
+		TasksTracer::Record(TRACE_ADD, reinterpret_cast<const void*>(uintptr_t{ 1 }));
+		TasksTracer::Disable();
+		TasksTracer::Record(TRACE_ADD, reinterpret_cast<const void*>(uintptr_t{ 2 }));
+		EXPECT_EQ(CountEvents(WriteTrace(), "Add", "i"), 1u);
+
+		TasksTracer::Enable();
+		EXPECT_EQ(CountEvents(WriteTrace(), "Add", "i"), 0u);
+	}
+	TEST_F(TasksTracerTest, RecordsFromManyThreads) {
+		TasksTracer::Enable(64);
+		TasksQueue queue{ { 4,0,0 } };
+		std::atomic<int> runs{ 0 };
+
+		// Dumping while the workers record
+		for (int i = 0; i < 1000; ++i) {
+			queue.AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&runs](TasksQueue* queue, const TaskPtr& task) -> void {
+					++runs;
+				}
+			));
+			if ((i % 100) == 0) {
+				EXPECT_EQ(WriteTrace().find("Unknown"), std::string::npos);
+			}
+		}
+		for (int i = 0; (i < 1000) && (runs < 1000); ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		EXPECT_EQ(runs, 1000);
+
+		const std::string trace = WriteTrace();
+		EXPECT_EQ(CountEvents(trace, "Add", "i"), 64u);
+		EXPECT_GE(CountEvents(trace, "Execute", "X"), 64u);
+		EXPECT_LE(CountEvents(trace, "Execute", "X"), 4u * 64u);
+	}
+
+}
@@ -0,0 +1,247 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "taskslib/Types.h"
+#include "TestTools.h"
+#include "taskslib/TasksQueuesContainer.h"
+#include "taskslib/TasksWorkerPool.h"
+#include "taskslib/Task.h"
+#include "taskslib/TasksQueue.h"
+
+namespace TasksLib {
+
+	using namespace ::testing;
+
+	class TasksWorkerPoolTest : public TestWithRandom {};
+
+	TEST_F(TasksWorkerPoolTest, CreatesWithConfig) {
+		std::uniform_int_distribution<unsigned> random(1, 15);
+		uint16_t blocking = random(randEng);
+		uint16_t nonBlocking = random(randEng);
+
+		TasksWorkerPool pool({ blocking, nonBlocking, 3 });
+
+		EXPECT_TRUE(pool.isInitialized());
+		EXPECT_EQ(pool.numWorkerThreads(), blocking + nonBlocking);
+		EXPECT_EQ(pool.numBlockingThreads(), blocking);
+		EXPECT_EQ(pool.numNonBlockingThreads(), nonBlocking);
+		EXPECT_EQ(pool.numSchedulingThreads(), 1);
+
+		pool.Cleanup();
+		EXPECT_FALSE(pool.isInitialized());
+		EXPECT_EQ(pool.numWorkerThreads(), 0);
+	}
+	TEST_F(TasksWorkerPoolTest, CreatesLanes) {
+		TasksQueuesContainer plainContainer;
+		EXPECT_EQ(plainContainer.GetSharedPool(), nullptr);
+		EXPECT_EQ(plainContainer.CreateLane("lane", { 1 }), INVALID_QUEUE_HANDLE);
+
+		TasksQueuesContainer container({ 2,0,1 });
+		ASSERT_NE(container.GetSharedPool(), nullptr);
+		TasksQueueHandle lane = container.CreateLane("lane", { 1 });
+		TasksQueueHandle queue = container.CreateQueue("queue", { 1,0,0 });
+		ASSERT_NE(lane, INVALID_QUEUE_HANDLE);
+		EXPECT_EQ(container.CreateLane("lane", { 5 }), lane);
+
+		EXPECT_TRUE(container.GetQueue(lane)->isInitialized());
+		EXPECT_EQ(container.GetQueue(lane)->numWorkerThreads(), 0);
+		EXPECT_EQ(container.GetQueue(queue)->numWorkerThreads(), 1);
+		EXPECT_EQ(container.GetSharedPool()->numLanes(), 1);
+	}
+	TEST_F(TasksWorkerPoolTest, RunsLaneTasks) {
+		TasksQueuesContainer container({ 2,1,1 });
+		TasksQueue* first = container.GetQueue(container.CreateLane("first", { 1 }));
+		TasksQueue* second = container.GetQueue(container.CreateLane("second", { 1 }));
+		std::atomic<int> count{ 0 };
+
+		for (int i = 0; i < 20; i++) {
+			TasksQueue* queue = (i % 2) ? first : second;
+			queue->AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&count](TasksQueue* queue, const TaskPtr& task) -> void {
+					++count;
+				},
+				TaskBlocking{ (i % 3) == 0 }
+			));
+		}
+
+		EXPECT_TRUE(WaitFor([&count] { return count == 20; }));
+		EXPECT_TRUE(WaitFor([first, second] {
+			return (first->GetPerformanceStats().completed == 10) && (second->GetPerformanceStats().completed == 10);
+		}));
+	}
+	TEST_F(TasksWorkerPoolTest, HandsBlockingTasksToBlockingWorkers) {
+		// Idle non-blocking workers are woken first, they have to pass the blocking tasks on
+		TasksQueuesContainer container({ 1,3,0 });
+		TasksQueue* lane = container.GetQueue(container.CreateLane("lane", { 1 }));
+		std::atomic<int> count{ 0 };
+
+		for (int i = 0; i < 20; i++) {
+			lane->AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&count](TasksQueue* queue, const TaskPtr& task) -> void {
+					++count;
+				},
+				TaskBlocking{ true }
+			));
+			EXPECT_TRUE(WaitFor([&count, i] { return count == i + 1; }));
+		}
+	}
+	TEST_F(TasksWorkerPoolTest, ResumesDelayedTasksWithoutUpdate) {
+		TasksQueuesContainer container({ 1,0,1 });
+		TasksQueue* lane = container.GetQueue(container.CreateLane("lane", { 1 }));
+		std::atomic<bool> threadSet{ false };
+
+		lane->AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&threadSet](TasksQueue* queue, const TaskPtr& task) -> void {
+				threadSet = true;
+			},
+			TaskDelay{ 30 }
+		));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		EXPECT_FALSE(threadSet);
+		EXPECT_TRUE(WaitFor([&threadSet] { return threadSet.load(); }));
+		EXPECT_EQ(lane->GetPerformanceStats().resumed, 1);
+	}
+	TEST_F(TasksWorkerPoolTest, SharesIdleCapacity) {
+		TasksQueuesContainer container({ 4,0,0 });
+		TasksQueue* busy = container.GetQueue(container.CreateLane("busy", { 1 }));
+		container.CreateLane("idle", { 10 });
+		std::atomic<int> running{ 0 };
+		std::atomic<int> maxRunning{ 0 };
+
+		for (int i = 0; i < 4; i++) {
+			busy->AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&running, &maxRunning](TasksQueue* queue, const TaskPtr& task) -> void {
+					int now = ++running;
+					int seen = maxRunning;
+					while ((now > seen) && !maxRunning.compare_exchange_weak(seen, now)) {}
+					std::this_thread::sleep_for(std::chrono::milliseconds(50));
+					--running;
+				}
+			));
+		}
+
+		EXPECT_TRUE(WaitFor([busy] { return busy->GetPerformanceStats().completed == 4; }));
+		EXPECT_EQ(maxRunning, 4);
+	}
+	TEST_F(TasksWorkerPoolTest, LimitsMaxConcurrency) {
+		TasksQueuesContainer container({ 4,0,0 });
+		TasksQueue* lane = container.GetQueue(container.CreateLane("lane", { 1, 0, 2 }));
+		std::atomic<int> running{ 0 };
+		std::atomic<int> maxRunning{ 0 };
+
+		for (int i = 0; i < 6; i++) {
+			lane->AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&running, &maxRunning](TasksQueue* queue, const TaskPtr& task) -> void {
+					int now = ++running;
+					int seen = maxRunning;
+					while ((now > seen) && !maxRunning.compare_exchange_weak(seen, now)) {}
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+					--running;
+				}
+			));
+		}
+
+		EXPECT_TRUE(WaitFor([lane] { return lane->GetPerformanceStats().completed == 6; }));
+		EXPECT_EQ(maxRunning, 2);
+	}
+	TEST_F(TasksWorkerPoolTest, ReservesMinConcurrency) {
+		TasksQueuesContainer container({ 1,0,0 });
+		TasksQueue* greedy = container.GetQueue(container.CreateLane("greedy", { 10 }));
+		TasksQueue* reserved = container.GetQueue(container.CreateLane("reserved", { 1, 1 }));
+		std::atomic<bool> release{ false };
+		std::mutex orderMutex;
+		std::vector<char> order;
+
+		// Hold the only worker until both lanes are backlogged
+		greedy->AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&release](TasksQueue* queue, const TaskPtr& task) -> void {
+				while (!release) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+		));
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		for (auto lane : { std::make_pair(greedy, 'g'), std::make_pair(reserved, 'r') }) {
+			char name = lane.second;
+			lane.first->AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&orderMutex, &order, name](TasksQueue* queue, const TaskPtr& task) -> void {
+					std::lock_guard<std::mutex> lock(orderMutex);
+					order.push_back(name);
+				}
+			));
+		}
+		release = true;
+
+		// The reserved lane is below its minimum, the freed worker goes to it despite the greedy lane's weight
+		ASSERT_TRUE(WaitFor([&orderMutex, &order] {
+			std::lock_guard<std::mutex> lock(orderMutex);
+			return order.size() == 2;
+		}));
+		EXPECT_THAT(order, ElementsAre('r', 'g'));
+	}
+	TEST_F(TasksWorkerPoolTest, IdleLaneReservesNothing) {
+		TasksQueuesContainer container({ 2,0,1 });
+		container.CreateLane("idle", { 1, 2 });
+		TasksQueue* busy = container.GetQueue(container.CreateLane("busy", { 1 }));
+		std::atomic<int> count{ 0 };
+
+		// The idle lane's minimum covers the whole pool, but it has no tasks to keep the workers for
+		for (int i = 0; i < 4; i++) {
+			busy->AddTask(std::make_shared<Task>(
+				(TaskExecutable)[&count](TasksQueue* queue, const TaskPtr& task) -> void {
+					++count;
+				}
+			));
+		}
+
+		EXPECT_TRUE(WaitFor([&count] { return count == 4; }));
+	}
+	TEST_F(TasksWorkerPoolTest, SharesByWeight) {
+		TasksQueuesContainer container({ 1,0,0 });
+		TasksQueue* heavy = container.GetQueue(container.CreateLane("heavy", { 3 }));
+		TasksQueue* light = container.GetQueue(container.CreateLane("light", { 1 }));
+		std::atomic<bool> release{ false };
+		std::mutex orderMutex;
+		std::vector<char> order;
+
+		// Hold the only worker until both lanes are backlogged
+		heavy->AddTask(std::make_shared<Task>(
+			(TaskExecutable)[&release](TasksQueue* queue, const TaskPtr& task) -> void {
+				while (!release) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+		));
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		for (int i = 0; i < 40; i++) {
+			for (auto lane : { std::make_pair(heavy, 'h'), std::make_pair(light, 'l') }) {
+				char name = lane.second;
+				lane.first->AddTask(std::make_shared<Task>(
+					(TaskExecutable)[&orderMutex, &order, name](TasksQueue* queue, const TaskPtr& task) -> void {
+						std::lock_guard<std::mutex> lock(orderMutex);
+						order.push_back(name);
+					}
+				));
+			}
+		}
+		release = true;
+
+		ASSERT_TRUE(WaitFor([&orderMutex, &order] {
+			std::lock_guard<std::mutex> lock(orderMutex);
+			return order.size() == 80;
+		}));
+		int heavyCount = 0;
+		for (int i = 0; i < 20; i++) {
+			heavyCount += (order[i] == 'h') ? 1 : 0;
+		}
+		EXPECT_GE(heavyCount, 14);
+		EXPECT_LE(heavyCount, 16);
+	}
+}
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <random>
+#include <climits>
 #include <chrono>
 #include <string>
 #include <sstream>
+#include <thread>
 
 #include "taskslib/Types.h"
 #include "taskslib/TaskOptions.h"
@@ -63,6 +65,14 @@ public:
 		generated = 0;
 	}
 };
+/* Polls the predicate until it is true or the timeout passes, returns the predicate */
+template <typename Predicate> bool WaitFor(Predicate predicate, const std::chrono::milliseconds timeout = std::chrono::milliseconds(2000)) {
+	auto until = std::chrono::steady_clock::now() + timeout;
+	while (!predicate() && (std::chrono::steady_clock::now() < until)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return predicate();
+}
 std::string GenerateRandomString(const size_t minLen, const size_t maxLen, std::default_random_engine& randEng) {
 	std::uniform_int_distribution<unsigned int> distLength(static_cast<unsigned int>(minLen), static_cast<unsigned int>(maxLen));
 	std::uniform_int_distribution<unsigned short> distChar(32, 126);